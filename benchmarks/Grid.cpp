@@ -0,0 +1,120 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include "benchmark/benchmark.h"
+
+#include "samarium/math/Multigrid.hpp"
+#include "samarium/util/Grid.hpp"
+#include "samarium/util/RandomGenerator.hpp"
+
+using namespace sm;
+
+template <typename Layout> static auto make_field(u64 size)
+{
+    auto rand = RandomGenerator{};
+    return Grid<f64, Layout>::generate({size, size}, [&](Indices) { return rand.random(); });
+}
+
+// 5-point laplacian, as in diffusion, pressure solves and blurs
+template <typename Layout> static void Grid_stencil(benchmark::State& state)
+{
+    const auto size  = static_cast<u64>(state.range(0));
+    const auto field = make_field<Layout>(size);
+    auto output      = Grid<f64, Layout>({size, size});
+
+    for (auto _ : state)
+    {
+        for (auto y : loop::start_end(u64{1}, size - 1))
+        {
+            for (auto x : loop::start_end(u64{1}, size - 1))
+            {
+                output[{x, y}] = field[{x - 1, y}] + field[{x + 1, y}] + field[{x, y - 1}] +
+                                 field[{x, y + 1}] - 4.0 * field[{x, y}];
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>((size - 2) * (size - 2)));
+}
+
+// walk down columns, the worst case for row-major storage
+template <typename Layout> static void Grid_column_walk(benchmark::State& state)
+{
+    const auto size  = static_cast<u64>(state.range(0));
+    const auto field = make_field<Layout>(size);
+
+    for (auto _ : state)
+    {
+        auto sum = 0.0;
+        for (auto x : loop::end(size))
+        {
+            for (auto y : loop::end(size)) { sum += field[{x, y}]; }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(size * size));
+}
+
+// 3x3 neighbourhoods around random cells, as in dense spatial hash lookups
+template <typename Layout> static void Grid_random_neighbourhood(benchmark::State& state)
+{
+    const auto size  = static_cast<u64>(state.range(0));
+    const auto field = make_field<Layout>(size);
+    auto rand        = RandomGenerator{};
+
+    auto centers = std::vector<Indices>(4096);
+    for (auto& center : centers)
+    {
+        center = rand.vector({{1.0, 1.0}, {f64(size - 2), f64(size - 2)}}).template cast<u64>();
+    }
+
+    for (auto _ : state)
+    {
+        auto sum = 0.0;
+        for (auto center : centers)
+        {
+            for (auto y : loop::start_end(center.y - 1, center.y + 2))
+            {
+                for (auto x : loop::start_end(center.x - 1, center.x + 2)) { sum += field[{x, y}]; }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(centers.size()));
+}
+
+// a real consumer: the pressure solve of Fluid, red-black sweeps on every level of a V-cycle
+template <typename Layout> static void Grid_multigrid(benchmark::State& state)
+{
+    const auto size = static_cast<u64>(state.range(0));
+    const auto rhs  = make_field<Layout>(size);
+    auto solution   = Grid<f64, Layout>({size, size});
+    auto solver     = Multigrid<f64, Layout>{{size, size}};
+
+    for (auto _ : state)
+    {
+        solver.solve(solution, rhs, 0.0);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(size * size));
+}
+
+BENCHMARK_TEMPLATE(Grid_stencil, layout::RowMajor)->Arg(512)->Arg(4096);
+BENCHMARK_TEMPLATE(Grid_stencil, layout::Tiled<8>)->Arg(512)->Arg(4096);
+BENCHMARK_TEMPLATE(Grid_stencil, layout::Morton)->Arg(512)->Arg(4096);
+
+BENCHMARK_TEMPLATE(Grid_column_walk, layout::RowMajor)->Arg(512)->Arg(4096);
+BENCHMARK_TEMPLATE(Grid_column_walk, layout::Tiled<8>)->Arg(512)->Arg(4096);
+BENCHMARK_TEMPLATE(Grid_column_walk, layout::Morton)->Arg(512)->Arg(4096);
+
+BENCHMARK_TEMPLATE(Grid_random_neighbourhood, layout::RowMajor)->Arg(512)->Arg(4096);
+BENCHMARK_TEMPLATE(Grid_random_neighbourhood, layout::Tiled<8>)->Arg(512)->Arg(4096);
+BENCHMARK_TEMPLATE(Grid_random_neighbourhood, layout::Morton)->Arg(512)->Arg(4096);
+
+BENCHMARK_TEMPLATE(Grid_multigrid, layout::RowMajor)->Arg(512)->Arg(2048);
+BENCHMARK_TEMPLATE(Grid_multigrid, layout::Tiled<8>)->Arg(512)->Arg(2048);
+BENCHMARK_TEMPLATE(Grid_multigrid, layout::Morton)->Arg(512)->Arg(2048);
@@ -0,0 +1,197 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <filesystem> // for path
+
+#include "benchmark/benchmark.h"
+
+#include "samarium/gl/draw.hpp"
+#include "samarium/gui/Window.hpp"
+#include "samarium/util/RandomGenerator.hpp"
+
+using namespace sm;
+using namespace sm::literals;
+
+// headless, so these run without a display, eg in CI on Mesa's llvmpipe
+
+static void bm_draw_circles(benchmark::State& state)
+{
+    auto window  = Window{{.dims = {1280, 720}, .headless = true}};
+    auto rand    = RandomGenerator{};
+    auto circles = std::vector<Circle>(static_cast<u64>(state.range(0)));
+    for (auto& circle : circles) { circle = {rand.vector(window.viewport()), 0.4}; }
+
+    for (auto _ : state)
+    {
+        draw::background("#101018"_c);
+        for (const auto& circle : circles)
+        {
+            draw::circle(window, circle, {.fill_color = "#ff8800"_c});
+        }
+        window.display();
+    }
+    glFinish();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void bm_draw_grid_dots(benchmark::State& state)
+{
+    auto window = Window{{.dims = {1280, 720}, .headless = true}};
+    window.view.scale /= static_cast<f64>(state.range(0)); // zoomed out shows more dots
+
+    for (auto _ : state)
+    {
+        draw::background("#101018"_c);
+        draw::grid_dots(window, {.spacing = 0.5});
+        window.display();
+    }
+    glFinish();
+}
+
+static void bm_Trail_push_back(benchmark::State& state)
+{
+    auto trail = Trail{static_cast<u64>(state.range(0))};
+    auto pos   = Vector2{};
+
+    for (auto _ : state)
+    {
+        trail.push_back(pos);
+        pos.x += 1.0;
+    }
+    benchmark::DoNotOptimize(trail.span());
+}
+
+// trails of length 500, drawn straight from the Trail or from a TrailBuffer
+static void bm_draw_trails(benchmark::State& state)
+{
+    auto window  = Window{{.dims = {1280, 720}, .headless = true}};
+    auto trails  = std::vector<Trail>(100, Trail{500});
+    auto buffers = std::vector<draw::TrailBuffer>(trails.size());
+    auto rand    = RandomGenerator{};
+    for (auto& trail : trails)
+    {
+        for (auto _ : loop::end(500)) { trail.push_back(rand.vector(window.viewport())); }
+    }
+
+    for (auto _ : state)
+    {
+        draw::background("#101018"_c);
+        for (auto i : loop::end(trails.size()))
+        {
+            trails[i].push_back(rand.vector(window.viewport()));
+            if (state.range(0) == 0) { draw::trail(window, trails[i], "#ff8800"_c, 0.05F); }
+            else { draw::trail(window, trails[i], buffers[i], "#ff8800"_c, 0.05F); }
+        }
+        window.display();
+    }
+    glFinish();
+}
+
+// 10'000 lines of up to 10 points, one draw::polyline() each or all in one draw::polylines()
+static void bm_draw_polylines(benchmark::State& state)
+{
+    auto window  = Window{{.dims = {1280, 720}, .headless = true}};
+    auto rand    = RandomGenerator{};
+    auto points  = std::vector<Vector2f>{};
+    auto offsets = std::vector<u32>{0};
+    for (auto i : loop::end(10'000))
+    {
+        for (auto _ : loop::end(2 + i % 9))
+        {
+            points.push_back(rand.vector(window.viewport()).cast<f32>());
+        }
+        offsets.push_back(static_cast<u32>(points.size()));
+    }
+
+    for (auto _ : state)
+    {
+        draw::background("#101018"_c);
+        if (state.range(0) == 0)
+        {
+            for (auto i : loop::end(offsets.size() - 1))
+            {
+                const auto line =
+                    std::span{points}.subspan(offsets[i], offsets[i + 1] - offsets[i]);
+                draw::polyline(window, line, "#ff8800"_c, 1.0F);
+            }
+        }
+        else { draw::polylines(window, points, offsets, "#ff8800"_c, 1.0F); }
+        window.display();
+    }
+    glFinish();
+}
+
+// 10'000 particles colored by speed, one draw::circle() each or all at once with draw::particles()
+static void bm_draw_particles(benchmark::State& state)
+{
+    auto window    = Window{{.dims = {1280, 720}, .headless = true}};
+    auto rand      = RandomGenerator{};
+    auto particles = ParticleSystem{10'000, Particle{.radius = 0.2}};
+    for (auto& particle : particles)
+    {
+        particle.pos = rand.vector(window.viewport());
+        particle.vel = rand.polar_vector({0.0, 4.0});
+    }
+    const auto style =
+        draw::ParticleStyle{.speed_gradient = &gradients::lut::magma, .speed_range = {0.0, 4.0}};
+
+    for (auto _ : state)
+    {
+        draw::background("#101018"_c);
+        if (state.range(0) == 0)
+        {
+            for (const auto& particle : particles)
+            {
+                const auto color = gradients::lut::magma(particle.vel.length() / 4.0);
+                draw::circle(window, particle.as_circle(), {.fill_color = color});
+            }
+        }
+        else { draw::particles(window, particles, style); }
+        window.display();
+    }
+    glFinish();
+    state.SetItemsProcessed(state.iterations() * 10'000);
+}
+
+static void bm_Window_get_image(benchmark::State& state)
+{
+    auto window = Window{{.dims = {1280, 720}, .headless = true}};
+    draw::background("#101018"_c);
+
+    for (auto _ : state) { benchmark::DoNotOptimize(window.get_image()); }
+}
+
+// making a window and drawing its first frame, including compiling or loading the programs used
+static void bm_Window_startup(benchmark::State& state)
+{
+    const auto shader_cache =
+        state.range(0) != 0 ? gl::ProgramCache::default_directory() : std::filesystem::path{};
+    auto program_seconds = 0.0;
+
+    for (auto _ : state)
+    {
+        auto window = Window{{.dims = {1280, 720}, .headless = true, .shader_cache = shader_cache}};
+        draw::background("#101018"_c);
+        draw::circle(window, {{}, 0.4}, {.fill_color = "#ff8800"_c});
+        window.display();
+        glFinish();
+        program_seconds += window.context.program_cache.stats.seconds;
+    }
+
+    state.counters["program_seconds"] =
+        benchmark::Counter{program_seconds, benchmark::Counter::kAvgIterations};
+}
+
+BENCHMARK(bm_draw_circles)->Name("draw::circle()")->Arg(100)->Arg(10'000);
+BENCHMARK(bm_draw_grid_dots)->Name("draw::grid_dots()")->ArgName("zoom_out")->Arg(1)->Arg(10);
+BENCHMARK(bm_Trail_push_back)->Name("Trail::push_back()")->Arg(500)->Arg(20'000);
+BENCHMARK(bm_draw_trails)->Name("draw::trail()")->ArgName("buffered")->Arg(0)->Arg(1);
+BENCHMARK(bm_draw_polylines)->Name("draw::polylines()")->ArgName("batched")->Arg(0)->Arg(1);
+BENCHMARK(bm_draw_particles)->Name("draw::particles()")->ArgName("instanced")->Arg(0)->Arg(1);
+BENCHMARK(bm_Window_get_image)->Name("Window::get_image()");
+// the first iteration fills the cache, so with it the rest measure a warm start
+BENCHMARK(bm_Window_startup)->Name("Window startup")->ArgName("cached")->Arg(0)->Arg(1);
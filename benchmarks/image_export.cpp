@@ -7,70 +7,88 @@
 
 #include "benchmark/benchmark.h"
 
+#include "samarium/util/RandomGenerator.hpp"
 #include "samarium/util/file.hpp"
 
 using namespace sm;
 
-static void bm_file_export_Targa(benchmark::State& state)
+// smooth gradients with a little noise, closer to a rendered frame than a blank image
+static auto make_image(u64 size)
 {
-    const auto image = Image{{static_cast<u64>(state.range(0)), static_cast<u64>(state.range(0))}};
-    for (auto _ : state) { file::write(file::Targa{}, image, "benchmark.tga"); }
-    std::filesystem::remove("benchmark.tga");
-    state.SetItemsProcessed(state.iterations());
+    auto rand = RandomGenerator{};
+    return Image::generate({size, size},
+                           [&](Indices indices)
+                           {
+                               const auto noise = static_cast<u8>(rand.range<u64>({0, 8}));
+                               return Color{static_cast<u8>(indices.x * 255 / size + noise),
+                                            static_cast<u8>(indices.y * 255 / size),
+                                            static_cast<u8>((indices.x + indices.y) % 256), 255};
+                           });
 }
 
-static void bm_file_export_Pam(benchmark::State& state)
+template <typename Format> static void bm_file_export(benchmark::State& state)
 {
-    const auto image = Image{{static_cast<u64>(state.range(0)), static_cast<u64>(state.range(0))}};
-    for (auto _ : state) { file::write(file::Pam{}, image, "benchmark.pam"); }
-    std::filesystem::remove("benchmark.pam");
+    const auto image     = make_image(static_cast<u64>(state.range(0)));
+    const auto file_path = std::string{"benchmark"} + Format::extension;
+
+    for (auto _ : state) { file::write(Format{}, image, file_path); }
+
+    state.counters["bytes"] = static_cast<f64>(std::filesystem::file_size(file_path));
+    std::filesystem::remove(file_path);
     state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<i64>(image.byte_size()));
 }
 
-static void bm_file_export_Bmp(benchmark::State& state)
+template <typename Format> static void bm_file_import(benchmark::State& state)
 {
-    const auto image = Image{{static_cast<u64>(state.range(0)), static_cast<u64>(state.range(0))}};
-    for (auto _ : state) { file::write(file::Bmp{}, image, "benchmark.bmp"); }
-    std::filesystem::remove("benchmark.bmp");
+    const auto image     = make_image(static_cast<u64>(state.range(0)));
+    const auto file_path = std::string{"benchmark"} + Format::extension;
+    file::write(Format{}, image, file_path);
+
+    for (auto _ : state) { benchmark::DoNotOptimize(file::read_image(file_path)); }
+
+    std::filesystem::remove(file_path);
     state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<i64>(image.byte_size()));
 }
 
-static void bm_file_export_Png(benchmark::State& state)
+static void bm_png_parallel_export(benchmark::State& state)
 {
-    const auto image = Image{{static_cast<u64>(state.range(0)), static_cast<u64>(state.range(0))}};
-    for (auto _ : state) { file::write(file::Bmp{}, image, "benchmark.png"); }
-    std::filesystem::remove("benchmark.png");
+    const auto image     = make_image(static_cast<u64>(state.range(0)));
+    const auto file_path = std::string{"benchmark_parallel.png"};
+    auto thread_pool     = ThreadPool{};
+
+    for (auto _ : state) { file::write(file::png, image, file_path, thread_pool); }
+
+    state.counters["bytes"] = static_cast<f64>(std::filesystem::file_size(file_path));
+    std::filesystem::remove(file_path);
     state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<i64>(image.byte_size()));
 }
 
-BENCHMARK(bm_file_export_Pam)
-    ->Name("Pam")
-    ->Unit(benchmark::kMillisecond)
-    ->Arg(200)
-    ->Arg(800)
-    ->Arg(1600)
-    ->Arg(3200);
+#define SM_IMAGE_BENCHMARK(function, Format, name)                                                 \
+    BENCHMARK_TEMPLATE(function, Format)                                                           \
+        ->Name(name)                                                                               \
+        ->Unit(benchmark::kMillisecond)                                                            \
+        ->Arg(200)                                                                                 \
+        ->Arg(800)                                                                                 \
+        ->Arg(1600)                                                                                \
+        ->Arg(3200)
 
-BENCHMARK(bm_file_export_Targa)
-    ->Name("Targa")
-    ->Unit(benchmark::kMillisecond)
-    ->Arg(200)
-    ->Arg(800)
-    ->Arg(1600)
-    ->Arg(3200);
+SM_IMAGE_BENCHMARK(bm_file_export, file::Pam, "Pam");
+SM_IMAGE_BENCHMARK(bm_file_export, file::Targa, "Targa");
+SM_IMAGE_BENCHMARK(bm_file_export, file::Bmp, "Bmp");
+SM_IMAGE_BENCHMARK(bm_file_export, file::Png, "Png");
+SM_IMAGE_BENCHMARK(bm_file_export, file::Qoi, "Qoi");
 
-BENCHMARK(bm_file_export_Bmp)
-    ->Name("Bmp")
+BENCHMARK(bm_png_parallel_export)
+    ->Name("Png/parallel")
     ->Unit(benchmark::kMillisecond)
-    ->Arg(200)
     ->Arg(800)
     ->Arg(1600)
     ->Arg(3200);
 
-BENCHMARK(bm_file_export_Png)
-    ->Name("Png")
-    ->Unit(benchmark::kMillisecond)
-    ->Arg(200)
-    ->Arg(800)
-    ->Arg(1600)
-    ->Arg(3200);
+SM_IMAGE_BENCHMARK(bm_file_import, file::Targa, "Targa/read");
+SM_IMAGE_BENCHMARK(bm_file_import, file::Bmp, "Bmp/read");
+SM_IMAGE_BENCHMARK(bm_file_import, file::Png, "Png/read");
+SM_IMAGE_BENCHMARK(bm_file_import, file::Qoi, "Qoi/read");
@@ -41,6 +41,7 @@ auto main() -> i32
     auto fn     = ParametricFunction{};
     auto time   = 0.0;
     auto trail  = Trail{20000};
+    auto buffer = draw::TrailBuffer{}; // only new points are uploaded each frame
 
     const auto update = [&]
     {
@@ -50,7 +51,7 @@ auto main() -> i32
             {.spacing = 1, .color = "#0a126a"_c.with_multiplied_alpha(0.15), .thickness = 0.03F});
         const auto pos = fn(time);
         trail.push_back(pos);
-        draw::trail(window, trail, "#0a126a"_c.with_multiplied_alpha(0.8), 2);
+        draw::trail(window, trail, buffer, "#0a126a"_c.with_multiplied_alpha(0.8), 2);
         time += fn.speed;
     };
 
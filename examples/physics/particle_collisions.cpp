@@ -88,16 +88,7 @@ auto main() -> i32
         // draw_bonds();
 
         watch.reset();
-        for (const auto& i : ps)
-        {
-            // TODO gl error for polygon
-            // draw::circle(window, i.as_circle(),
-            //              {.fill_color   = "#5640ff"_c.with_multiplied_alpha(0.2),
-            //               .border_color = {255, 30, 30, 255},
-            //               .border_width = 1});
-            draw::circle(window, i.as_circle(),
-                         {.fill_color = "#ff0842"_c.with_multiplied_alpha(0.8)});
-        }
+        draw::particles(window, ps, {.color = "#ff0842"_c.with_multiplied_alpha(0.8)});
 
         const auto time = watch.seconds();
         fmt::print("Draw: {:3.2}ms, {:8}/s\n", time * 1000.0,
@@ -7,9 +7,13 @@
 
 #pragma once
 
+#include "samarium/gl/AsyncReadback.hpp"
 #include "samarium/gl/Context.hpp"
 #include "samarium/gl/Framebuffer.hpp"
+#include "samarium/gl/HeadlessContext.hpp"
+#include "samarium/gl/ProgramCache.hpp"
 #include "samarium/gl/Shader.hpp"
+#include "samarium/gl/ShapeBatch.hpp"
 #include "samarium/gl/Sync.hpp"
 #include "samarium/gl/Text.hpp"
 #include "samarium/gl/Texture.hpp"
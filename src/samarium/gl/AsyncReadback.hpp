@@ -0,0 +1,243 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <deque>      // for deque
+#include <functional> // for function
+#include <mutex>      // for mutex
+#include <optional>   // for optional
+#include <vector>     // for vector
+
+#include "samarium/core/types.hpp"   // for u32, u64
+#include "samarium/math/Vector2.hpp" // for Dimensions
+#include "samarium/util/Grid.hpp"    // for Image
+
+#include "Context.hpp" // for Context
+#include "Sync.hpp"    // for Sync
+
+namespace sm::gl
+{
+/**
+ * @brief Read frames back from the GPU without stalling, through a ring of pixel pack buffers
+ *
+ * @code
+ * auto recorder = FrameRecorder{file::png, {.directory = "frames"}};
+ * auto readback = gl::AsyncReadback{3, [&](u64, Image&& frame) { recorder.submit(frame); }};
+ * while (window.is_open())
+ * {
+ *     // draw...
+ *     readback.capture(window.context, window.dims);
+ *     readback.poll();
+ *     window.display();
+ * }
+ * readback.finish();
+ * @endcode
+ *
+ * capture() only queues a copy into one of depth buffers, so a frame is usually ready depth - 1
+ * frames later, when poll() hands it on. Only if every buffer is still in flight does capture()
+ * wait, for the oldest. Frames are delivered in capture order to the callback, or to a queue
+ * read with pop() if there is none. Frames still in flight when it is destroyed are dropped
+ */
+class AsyncReadback
+{
+  public:
+    /// frame counts captures from 0. Images left in place are reused, moved ones can be recycled
+    using Callback = std::function<void(u64 frame, Image&& image)>;
+
+    explicit AsyncReadback(u64 depth = 3, Callback callback_ = {});
+
+    AsyncReadback(const AsyncReadback&)                    = delete;
+    auto operator=(const AsyncReadback&) -> AsyncReadback& = delete;
+
+    ~AsyncReadback();
+
+    /**
+     * @brief               Queue a readback of the framebuffer bound in context
+     *
+     * @param  dims         Size of the framebuffer, as in Window::dims
+     */
+    void capture(Context& context, Dimensions dims);
+
+    /**
+     * @brief               Deliver every frame the GPU has finished with, without blocking
+     *
+     * @return              The number delivered
+     */
+    auto poll() -> u64;
+
+    /**
+     * @brief               Wait for and deliver every frame in flight
+     */
+    void finish();
+
+    /**
+     * @brief               The oldest delivered frame, if there is no callback
+     */
+    [[nodiscard]] auto pop() -> std::optional<Image>;
+
+    /**
+     * @brief               Give an Image back for reuse, from any thread
+     */
+    void recycle(Image&& image);
+
+    [[nodiscard]] auto in_flight() const -> u64 { return pending; }
+
+  private:
+    struct Slot
+    {
+        u32 handle{};
+        const Color* data{}; // persistently mapped
+        Dimensions dims{};
+        u64 frame{};
+        std::optional<Sync> fence{};
+    };
+
+    std::vector<Slot> slots;
+    u64 next{};    // slot the next capture goes into
+    u64 pending{}; // slots in flight, the oldest is next - pending
+    u64 frame_count{};
+    Callback callback;
+    std::deque<Image> ready{};
+
+    std::mutex pool_mutex{};
+    std::vector<Image> pool{};
+
+    [[nodiscard]] auto acquire(Dimensions dims) -> Image;
+
+    [[nodiscard]] auto oldest() -> Slot&;
+
+    void deliver_oldest();
+};
+} // namespace sm::gl
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_ASYNC_READBACK_IMPL)
+
+#include <algorithm> // for copy_n, max
+
+#include "glad/glad.h" // for glReadPixels, glNamedBufferStorage, glMapNamedBufferRange
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+namespace sm::gl
+{
+SM_INLINE AsyncReadback::AsyncReadback(u64 depth, Callback callback_)
+    : slots(std::max(depth, u64{1})), callback{std::move(callback_)}
+{
+}
+
+SM_INLINE AsyncReadback::~AsyncReadback()
+{
+    for (const auto& slot : slots) { glDeleteBuffers(1, &slot.handle); }
+}
+
+SM_INLINE void AsyncReadback::capture(Context& context, Dimensions dims)
+{
+    context.flush();
+
+    if (pending == slots.size()) { deliver_oldest(); }
+
+    auto& slot = slots[next];
+    if (slot.dims != dims)
+    {
+        // the first capture, or the window was resized
+        glDeleteBuffers(1, &slot.handle);
+        const auto size = static_cast<i64>(dims.x * dims.y * sizeof(Color));
+        constexpr auto flags =
+            static_cast<u32>(GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        glCreateBuffers(1, &slot.handle);
+        glNamedBufferStorage(slot.handle, size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        slot.data =
+            static_cast<const Color*>(glMapNamedBufferRange(slot.handle, 0, size, flags));
+        slot.dims = dims;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.handle);
+    glReadPixels(0, 0, static_cast<i32>(dims.x), static_cast<i32>(dims.y), GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence.emplace();
+    slot.frame = frame_count++;
+    next       = (next + 1) % slots.size();
+    pending++;
+}
+
+SM_INLINE auto AsyncReadback::poll() -> u64
+{
+    auto count = u64{};
+    while (pending != 0 && oldest().fence->is_signaled())
+    {
+        deliver_oldest();
+        count++;
+    }
+    return count;
+}
+
+SM_INLINE void AsyncReadback::finish()
+{
+    while (pending != 0) { deliver_oldest(); }
+}
+
+SM_INLINE auto AsyncReadback::pop() -> std::optional<Image>
+{
+    if (ready.empty()) { return std::nullopt; }
+    auto image = std::move(ready.front());
+    ready.pop_front();
+    return {std::move(image)};
+}
+
+SM_INLINE void AsyncReadback::recycle(Image&& image)
+{
+    const auto lock = std::scoped_lock{pool_mutex};
+    // enough for every slot plus what consumers are holding on to
+    if (pool.size() < 2 * slots.size()) { pool.push_back(std::move(image)); }
+}
+
+SM_INLINE auto AsyncReadback::acquire(Dimensions dims) -> Image
+{
+    {
+        const auto lock = std::scoped_lock{pool_mutex};
+        while (!pool.empty())
+        {
+            auto image = std::move(pool.back());
+            pool.pop_back();
+            if (image.dims == dims) { return image; }
+        }
+    }
+    return Image{dims};
+}
+
+SM_INLINE auto AsyncReadback::oldest() -> Slot&
+{
+    return slots[(next + slots.size() - pending) % slots.size()];
+}
+
+SM_INLINE void AsyncReadback::deliver_oldest()
+{
+    auto& slot = oldest();
+    slot.fence->wait();
+    slot.fence.reset();
+    pending--;
+
+    auto image = acquire(slot.dims);
+    std::copy_n(slot.data, image.size(), image.begin());
+
+    if (!callback)
+    {
+        ready.push_back(std::move(image));
+        return;
+    }
+
+    callback(slot.frame, std::move(image));
+    // an rvalue reference only moves if the callback moved it
+    if (!image.elements.empty()) { recycle(std::move(image)); }
+}
+} // namespace sm::gl
+
+#endif
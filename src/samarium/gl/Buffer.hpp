@@ -7,7 +7,11 @@
 
 #pragma once
 
-#include <span> // for span
+#include <algorithm> // for max
+#include <array>     // for array
+#include <bit>       // for bit_ceil
+#include <cstring>   // for memcpy
+#include <span>      // for span
 #include <tl/expected.hpp>
 #include <vector> // for vector
 
@@ -183,4 +187,137 @@ template <typename T> struct MappedBuffer
         glDeleteBuffers(1, &handle);
     }
 };
+
+/**
+ * @brief A persistent-mapped ring of per-frame segments for streaming vertex and storage data
+ *
+ * @details Each frame writes into its own segment, and Context::draw_frame() fences it before
+ * moving on. A segment is only reused once its fence from segment_count frames ago has signalled,
+ * so uploads never orphan storage or wait on draws still in flight. If a frame outgrows its
+ * segment the ring is replaced by a larger one, keeping the old buffer alive until the frame ends
+ */
+struct StreamBuffer
+{
+    static constexpr u64 segment_count = 3;
+
+    /// A sub-allocation, valid until the end of the frame
+    struct Range
+    {
+        u32 handle{};
+        i64 offset{};
+        i64 size{};
+
+        void bind(u32 index = 0) const
+        {
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, handle, offset, size);
+        }
+    };
+
+    explicit StreamBuffer(u64 initial_segment_size = u64{1} << 22)
+    {
+        auto storage_alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+        alignment = std::max(u64{16}, static_cast<u64>(storage_alignment));
+        create(initial_segment_size);
+    }
+
+    StreamBuffer(const StreamBuffer&)                    = delete;
+    auto operator=(const StreamBuffer&) -> StreamBuffer& = delete;
+
+    /**
+     * @brief               Copy array into the current segment, aligned for use as a vertex or
+     * shader storage buffer
+     */
+    auto upload(const ranges::range auto& array) -> Range
+    {
+        const auto size  = util::range_byte_size(array);
+        const auto range = allocate(size);
+        if (size != 0) { std::memcpy(mapping + range.offset, std::data(array), size); }
+        return range;
+    }
+
+    /**
+     * @brief               Fence the current segment and wait until the next one is free
+     */
+    void next_frame()
+    {
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segment         = (segment + 1) % segment_count;
+        offset          = 0;
+
+        if (fences[segment] != nullptr)
+        {
+            while (true)
+            {
+                const auto status =
+                    glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED ||
+                    status == GL_WAIT_FAILED)
+                {
+                    break;
+                }
+            }
+            glDeleteSync(fences[segment]);
+            fences[segment] = nullptr;
+        }
+
+        // draws using these were issued last frame, GL keeps them alive until they finish
+        glDeleteBuffers(static_cast<i32>(retired.size()), retired.data());
+        retired.clear();
+    }
+
+    ~StreamBuffer()
+    {
+        for (auto* fence : fences) { glDeleteSync(fence); }
+        glDeleteBuffers(static_cast<i32>(retired.size()), retired.data());
+        glDeleteBuffers(1, &handle);
+    }
+
+  private:
+    static constexpr GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    u32 handle{};
+    u8* mapping{};
+    u64 segment_size{};
+    u64 alignment{};
+    u64 segment{};
+    u64 offset{};
+    std::array<GLsync, segment_count> fences{};
+    std::vector<u32> retired{};
+
+    void create(u64 new_segment_size)
+    {
+        segment_size = new_segment_size;
+        glCreateBuffers(1, &handle);
+        const auto total = static_cast<i64>(segment_size * segment_count);
+        glNamedBufferStorage(handle, total, nullptr, flags);
+        mapping = static_cast<u8*>(glMapNamedBufferRange(handle, 0, total, flags));
+        if (mapping == nullptr)
+        {
+            throw Error{fmt::format("StreamBuffer: could not map a buffer of size {}", total)};
+        }
+    }
+
+    auto allocate(u64 size) -> Range
+    {
+        auto start = (offset + alignment - 1) / alignment * alignment;
+        if (start + size > segment_size)
+        {
+            // the fences guard the old buffer, which is only deleted after this frame
+            retired.push_back(handle);
+            for (auto*& fence : fences)
+            {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            create(std::max(2 * segment_size, std::bit_ceil(size)));
+            segment = 0;
+            start   = 0;
+        }
+
+        offset = start + size;
+        return {handle, static_cast<i64>(segment * segment_size + start), static_cast<i64>(size)};
+    }
+};
 } // namespace sm::gl
@@ -7,7 +7,8 @@
 
 #pragma once
 
-#include <string> // for string
+#include <string>  // for string
+#include <utility> // for move
 
 #include "glad/glad.h" // for GL_FLOAT, GL_TRUE, GL_UNSIGNED_BYTE
 
@@ -15,16 +16,25 @@
 #include "samarium/math/BoundingBox.hpp" // for BoundingBox
 #include "samarium/util/unordered.hpp"   // for Map
 
-#include "Framebuffer.hpp" // for Framebuffer
-#include "Shader.hpp"      // for Shader, FragmentShader, VertexShader
-#include "Texture.hpp"     // for Texture
-#include "Vertex.hpp"      // for Vertex
-#include "gl.hpp"          // for VertexArray, VertexAttribute, Buf...
+#include "Framebuffer.hpp"  // for Framebuffer
+#include "ProgramCache.hpp" // for ProgramCache
+#include "Shader.hpp"       // for Shader, FragmentShader, VertexShader
+#include "ShapeBatch.hpp"   // for ShapeBatch
+#include "Texture.hpp"      // for Texture
+#include "Vertex.hpp"       // for Vertex
+#include "gl.hpp"           // for VertexArray, VertexAttribute, Buf...
 
 namespace sm::gl
 {
 struct Context
 {
+    /// Names in vert_sources and frag_sources of the stages of a program
+    struct ProgramSources
+    {
+        std::string vertex;
+        std::string fragment;
+    };
+
     Map<std::string, VertexAttribute> attributes{
         {"position", {.size = 2, .type = GL_FLOAT, .offset = 0}},
         {"color",
@@ -36,7 +46,10 @@ struct Context
 
     Map<std::string, std::string> vert_sources{};
     Map<std::string, std::string> frag_sources{};
-    Map<std::string, Shader> shaders{};
+    Map<std::string, ProgramSources> program_sources{};
+    Map<std::string, Shader> shaders{}; ///< Programs made so far, see shader()
+
+    ProgramCache program_cache;
 
     Map<std::string, VertexBuffer> vertex_buffers{};
     Map<std::string, ElementBuffer> element_buffers{};
@@ -46,14 +59,35 @@ struct Context
     Texture frame_texture;
     Framebuffer framebuffer;
 
-    explicit Context(Dimensions dims);
+    StreamBuffer stream_buffer{};
+    ShapeBatch shape_batch{};
+
+    explicit Context(Dimensions dims, ProgramCache program_cache_ = {});
+
+    /**
+     * @brief               The program called name, compiled or loaded from program_cache the
+     * first time it is used, so programs a scene never draws with cost nothing
+     *
+     * @param  name         A key of program_sources, or of shaders for programs added directly
+     */
+    [[nodiscard]] auto shader(const std::string& name) -> const Shader&;
 
     void set_active(const Shader& shader);
 
     void set_active(const VertexArray& vertex_array);
 
+    /**
+     * @brief               Draw the shapes queued in shape_batch. Anything drawing directly to the
+     * framebuffer has to call this first, to keep the order shapes were drawn in
+     */
+    void flush();
+
+    /// Flush, then show the framebuffer on the default framebuffer
     void draw_frame();
 
+    /// Flush and finish the frame without showing it, for headless rendering
+    void end_frame();
+
   private:
     u32 active_shader_handle{};
     u32 active_vertex_array_handle{};
@@ -68,8 +102,9 @@ struct Context
 
 namespace sm::gl
 {
-SM_INLINE Context::Context(Dimensions dims)
-    : frame_texture{ImageFormat::RGBA8, dims, Texture::Wrap::ClampEdge, Texture::Filter::Nearest,
+SM_INLINE Context::Context(Dimensions dims, ProgramCache program_cache_)
+    : program_cache{std::move(program_cache_)},
+      frame_texture{ImageFormat::RGBA8, dims, Texture::Wrap::ClampEdge, Texture::Filter::Nearest,
                     Texture::Filter::Nearest},
       framebuffer(frame_texture)
 {
@@ -113,28 +148,17 @@ SM_INLINE Context::Context(Dimensions dims)
 #include "shaders/text.frag.glsl"
     );
 
-    shaders.emplace("Pos", Shader{expect(VertexShader::make(vert_sources.at("Pos"))),
-                                  expect(FragmentShader::make(frag_sources.at("Pos")))});
-
-    shaders.emplace("PosColor", Shader{expect(VertexShader::make(vert_sources.at("PosColor"))),
-                                       expect(FragmentShader::make(frag_sources.at("PosColor")))});
-
-    shaders.emplace("PosTex", Shader{expect(VertexShader::make(vert_sources.at("PosTex"))),
-                                     expect(FragmentShader::make(frag_sources.at("PosTex")))});
-
-    shaders.emplace("PosColorTex",
-                    Shader{expect(VertexShader::make(vert_sources.at("PosColorTex"))),
-                           expect(FragmentShader::make(frag_sources.at("PosColorTex")))});
-
-    shaders.emplace("text", Shader{expect(VertexShader::make(vert_sources.at("PosTex"))),
-                                   expect(FragmentShader::make(frag_sources.at("text")))});
+    program_sources.emplace("Pos", ProgramSources{"Pos", "Pos"});
+    program_sources.emplace("PosColor", ProgramSources{"PosColor", "PosColor"});
+    program_sources.emplace("PosTex", ProgramSources{"PosTex", "PosTex"});
+    program_sources.emplace("PosColorTex", ProgramSources{"PosColorTex", "PosColorTex"});
+    program_sources.emplace("text", ProgramSources{"PosColorTex", "text"});
 
     vert_sources.emplace("polyline",
 #include "shaders/polyline.vert.glsl"
     );
 
-    shaders.emplace("polyline", Shader{expect(VertexShader::make(vert_sources.at("polyline"))),
-                                       expect(FragmentShader::make(frag_sources.at("Pos")))});
+    program_sources.emplace("polyline", ProgramSources{"polyline", "Pos"});
 
     vert_sources.emplace("particles",
 #include "samarium/physics/gpu/Particle.comp.glsl"
@@ -142,8 +166,25 @@ SM_INLINE Context::Context(Dimensions dims)
 #include "shaders/particles.vert.glsl"
     );
 
-    shaders.emplace("particles", Shader{expect(VertexShader::make(vert_sources.at("particles"))),
-                                        expect(FragmentShader::make(frag_sources.at("Pos")))});
+    program_sources.emplace("particles", ProgramSources{"particles", "Pos"});
+
+    vert_sources.emplace("circles",
+#include "shaders/circles.vert.glsl"
+    );
+
+    program_sources.emplace("circles", ProgramSources{"circles", "PosColor"});
+
+    vert_sources.emplace("grid",
+#include "shaders/grid.vert.glsl"
+    );
+    frag_sources.emplace("grid",
+#include "shaders/grid.frag.glsl"
+    );
+
+    program_sources.emplace("grid", ProgramSources{"grid", "grid"});
+
+    // shader() hands out references, which must survive later programs being made
+    shaders.reserve(program_sources.size());
 
     shader_storage_buffers.emplace("default", ShaderStorageBuffer{});
 
@@ -152,11 +193,21 @@ SM_INLINE Context::Context(Dimensions dims)
 
     //    textures.emplace("default", Texture{});
 
-    shaders.at("Pos").bind();
     vertex_arrays.at("Pos").bind();
     framebuffer.bind();
 }
 
+SM_INLINE auto Context::shader(const std::string& name) -> const Shader&
+{
+    if (const auto iter = shaders.find(name); iter != shaders.end()) { return iter->second; }
+
+    const auto& sources = program_sources.at(name);
+    return shaders
+        .emplace(name, expect(Shader::make(vert_sources.at(sources.vertex),
+                                           frag_sources.at(sources.fragment), &program_cache)))
+        .first->second;
+}
+
 SM_INLINE void Context::set_active(const Shader& shader)
 {
     if (shader.handle != active_shader_handle)
@@ -175,8 +226,65 @@ SM_INLINE void Context::set_active(const VertexArray& vertex_array)
     }
 }
 
+SM_INLINE void Context::flush()
+{
+    if (shape_batch.empty()) { return; }
+
+    // one upload for the whole frame, then a draw call per run
+    const auto vertices       = stream_buffer.upload(shape_batch.vertices);
+    const auto instances      = stream_buffer.upload(shape_batch.instances);
+    const auto glyph_vertices = stream_buffer.upload(shape_batch.glyph_vertices);
+
+    for (const auto& run : shape_batch.runs)
+    {
+        if (run.kind == ShapeBatch::Kind::Triangles)
+        {
+            const auto& program = shader("PosColor");
+            set_active(program);
+            program.set("view", run.transform);
+
+            auto& vao = vertex_arrays.at("PosColor");
+            set_active(vao);
+            vao.bind(vertices, sizeof(Vertex<Layout::PosColor>));
+
+            glDrawArrays(GL_TRIANGLES, static_cast<i32>(run.offset), static_cast<i32>(run.count));
+        }
+        else if (run.kind == ShapeBatch::Kind::Glyphs)
+        {
+            const auto& program = shader("text");
+            set_active(program);
+            program.set("view", run.transform);
+            glBindTextureUnit(0, run.texture);
+
+            auto& vao = vertex_arrays.at("PosColorTex");
+            set_active(vao);
+            vao.bind(glyph_vertices, sizeof(Vertex<Layout::PosColorTex>));
+
+            glDrawArrays(GL_TRIANGLES, static_cast<i32>(run.offset), static_cast<i32>(run.count));
+        }
+        else
+        {
+            const auto& program = shader("circles");
+            set_active(program);
+            program.set("view", run.transform);
+            program.set("point_count", static_cast<i32>(run.point_count));
+            program.set("first", static_cast<i32>(run.offset));
+
+            instances.bind(3);
+            set_active(vertex_arrays.at("empty"));
+
+            glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, static_cast<i32>(run.point_count),
+                                  static_cast<i32>(run.count));
+        }
+    }
+
+    shape_batch.clear();
+}
+
 SM_INLINE void Context::draw_frame()
 {
+    flush();
+
     using Vert                        = Vertex<Layout::PosTex>;
     static constexpr auto buffer_data = std::to_array<Vert>({{{-1, -1}, {0, 0}},
                                                              {{1, 1}, {1, 1}},
@@ -187,22 +295,27 @@ SM_INLINE void Context::draw_frame()
                                                              {{1, 1}, {1, 1}}});
 
     framebuffer.unbind();
-    const auto& shader = shaders.at("PosTex");
-    set_active(shader);
-    shader.set("view", glm::mat4{1.0F});
+    const auto& program = shader("PosTex");
+    set_active(program);
+    program.set("view", glm::mat4{1.0F});
 
     frame_texture.bind();
 
     auto& vao = vertex_arrays.at("PosTex");
     set_active(vao);
 
-    const auto& buffer = vertex_buffers.at("default");
-    buffer.set_data(buffer_data);
-    vao.bind(buffer, sizeof(Vert));
+    vao.bind(stream_buffer.upload(buffer_data), sizeof(Vert));
 
     glDrawArrays(GL_TRIANGLES, 0, static_cast<i32>(buffer_data.size()));
 
     framebuffer.bind();
+    stream_buffer.next_frame();
+}
+
+SM_INLINE void Context::end_frame()
+{
+    flush();
+    stream_buffer.next_frame();
 }
 } // namespace sm::gl
 
@@ -0,0 +1,181 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include "samarium/util/Result.hpp" // for Result
+
+namespace sm::gl
+{
+/**
+ * @brief An OpenGL context with no window, created with EGL and made current on construction
+ *
+ * @details Uses Mesa's surfaceless platform where available, so it runs without a display server
+ * or a GPU (on llvmpipe). Everything renders into gl::Context's framebuffer as usual. Only
+ * available when samarium is built with EGL (SAMARIUM_EGL), otherwise make() always fails
+ */
+class HeadlessContext
+{
+  public:
+    [[nodiscard]] static auto make() -> Result<HeadlessContext>;
+
+    HeadlessContext(HeadlessContext&& other) noexcept;
+    HeadlessContext(const HeadlessContext&)                    = delete;
+    auto operator=(const HeadlessContext&) -> HeadlessContext& = delete;
+    auto operator=(HeadlessContext&&) -> HeadlessContext&      = delete;
+
+    ~HeadlessContext();
+
+  private:
+    // EGLDisplay, EGLSurface and EGLContext, kept opaque so EGL headers stay out of this one
+    void* display{};
+    void* surface{};
+    void* context{};
+
+    HeadlessContext() = default;
+};
+} // namespace sm::gl
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_HEADLESS_CONTEXT_IMPL)
+
+#include <array>       // for to_array
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <utility>     // for exchange
+
+#if defined(SAMARIUM_EGL)
+#include <EGL/egl.h>    // for eglInitialize, eglCreateContext, eglMakeCurrent
+#include <EGL/eglext.h> // for EGL_PLATFORM_SURFACELESS_MESA
+#endif
+
+#include "fmt/format.h" // for format
+#include "glad/glad.h"  // for gladLoadGLLoader
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+#include "gl.hpp" // for version_major, version_minor, min_version_minor
+
+namespace sm::gl
+{
+#if defined(SAMARIUM_EGL)
+namespace detail
+{
+[[nodiscard]] SM_INLINE auto has_extension(EGLDisplay display, std::string_view name) -> bool
+{
+    const auto* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    return extensions != nullptr &&
+           std::string_view{extensions}.find(name) != std::string_view::npos;
+}
+} // namespace detail
+#endif
+
+SM_INLINE auto HeadlessContext::make() -> Result<HeadlessContext>
+{
+#if defined(SAMARIUM_EGL)
+    auto headless = HeadlessContext{};
+
+    // Mesa's surfaceless platform needs neither X11 nor Wayland, other drivers get the default
+    if (detail::has_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless"))
+    {
+        const auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display != nullptr)
+        {
+            headless.display =
+                get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+    }
+    if (headless.display == EGL_NO_DISPLAY)
+    {
+        headless.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if (headless.display == EGL_NO_DISPLAY ||
+        eglInitialize(headless.display, nullptr, nullptr) == 0)
+    {
+        headless.display = EGL_NO_DISPLAY; // nothing to terminate
+        return make_unexpected(std::string{"failed to initialize EGL"});
+    }
+
+    if (eglBindAPI(EGL_OPENGL_API) == 0)
+    {
+        return make_unexpected(std::string{"EGL display does not support OpenGL"});
+    }
+
+    const auto config_attributes = std::to_array<EGLint>(
+        {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE});
+    auto config       = EGLConfig{};
+    auto config_count = EGLint{};
+    eglChooseConfig(headless.display, config_attributes.data(), &config, 1, &config_count);
+
+    // prefer the version a window would get, there is no GLFW fallback here
+    for (auto minor_version = version_minor; minor_version >= min_version_minor; minor_version--)
+    {
+        const auto context_attributes = std::to_array<EGLint>(
+            {EGL_CONTEXT_MAJOR_VERSION, version_major, EGL_CONTEXT_MINOR_VERSION, minor_version,
+             EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE});
+        headless.context =
+            eglCreateContext(headless.display, config_count != 0 ? config : EGL_NO_CONFIG_KHR,
+                             EGL_NO_CONTEXT, context_attributes.data());
+        if (headless.context != EGL_NO_CONTEXT) { break; }
+    }
+
+    if (headless.context == EGL_NO_CONTEXT)
+    {
+        return make_unexpected(fmt::format("failed to create an OpenGL {}.{} context with EGL",
+                                           version_major, min_version_minor));
+    }
+
+    // all rendering goes to framebuffer objects, a surface is only made if EGL insists on one
+    if (!detail::has_extension(headless.display, "EGL_KHR_surfaceless_context"))
+    {
+        const auto surface_attributes =
+            std::to_array<EGLint>({EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE});
+        headless.surface =
+            eglCreatePbufferSurface(headless.display, config, surface_attributes.data());
+    }
+
+    const auto made_current =
+        eglMakeCurrent(headless.display, headless.surface, headless.surface, headless.context);
+    if (made_current == 0)
+    {
+        return make_unexpected(std::string{"failed to make the EGL context current"});
+    }
+
+    if (gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)) == 0)
+    {
+        return make_unexpected(std::string{"failed to initialize GLAD"});
+    }
+
+    return {std::move(headless)};
+#else
+    return make_unexpected(
+        std::string{"samarium was built without EGL, so it cannot render headless"});
+#endif
+}
+
+SM_INLINE HeadlessContext::HeadlessContext(HeadlessContext&& other) noexcept
+    : display{std::exchange(other.display, nullptr)},
+      surface{std::exchange(other.surface, nullptr)},
+      context{std::exchange(other.context, nullptr)}
+{
+}
+
+SM_INLINE HeadlessContext::~HeadlessContext()
+{
+#if defined(SAMARIUM_EGL)
+    if (display == EGL_NO_DISPLAY) { return; }
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) { eglDestroyContext(display, context); }
+    if (surface != EGL_NO_SURFACE) { eglDestroySurface(display, surface); }
+    eglTerminate(display);
+#endif
+}
+} // namespace sm::gl
+
+#endif
@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#ifndef SAMARIUM_HEADER_ONLY
+#define SAMARIUM_PROGRAM_CACHE_IMPL
+#include "ProgramCache.hpp"
+#endif // !SAMARIUM_HEADER_ONLY
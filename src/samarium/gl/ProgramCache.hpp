@@ -0,0 +1,295 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <filesystem>  // for path
+#include <span>        // for span
+#include <string>      // for string
+#include <string_view> // for string_view
+
+#include "glad/glad.h" // for glProgramParameteri, glGetProgramiv
+
+#include "samarium/core/types.hpp"     // for u32, u64, f64
+#include "samarium/util/Result.hpp"    // for Result
+#include "samarium/util/Stopwatch.hpp" // for Stopwatch
+
+namespace sm::gl
+{
+/**
+ * @brief Linked shader programs saved to disk with glGetProgramBinary, so that later runs skip
+ * compiling and linking
+ *
+ * @details Binaries are keyed by a hash of the shader sources and the driver's vendor, renderer and
+ * version strings, so a driver update never loads a stale binary. A binary the driver rejects
+ * anyway is recompiled from source and replaced. A default constructed cache is disabled and
+ * always compiles
+ */
+class ProgramCache
+{
+  public:
+    struct Stats
+    {
+        u64 hits{};
+        u64 misses{};   ///< Compiled from source, including rejected binaries
+        u64 rejected{}; ///< Binaries the driver refused to load
+        f64 seconds{};  ///< Total time spent making programs, whether cached or not
+    };
+
+    Stats stats{};
+
+    ProgramCache() = default;
+
+    /**
+     * @param  directory_   Where binaries are kept, created (only accessible by this user) if
+     * needed. Empty disables the cache, as does a directory that other users could write to
+     */
+    explicit ProgramCache(const std::filesystem::path& directory_);
+
+    /**
+     * @brief               samarium/programs in the user's cache directory: $XDG_CACHE_HOME or
+     * ~/.cache, or %LOCALAPPDATA% on Windows. Empty (disabled) if there is none
+     */
+    [[nodiscard]] static auto default_directory() -> std::filesystem::path;
+
+    [[nodiscard]] auto is_enabled() const -> bool { return !directory.empty(); }
+
+    /**
+     * @brief               Make program ready to use, from a cached binary if there is one for
+     * sources, otherwise with link(program) -> Result<void>, whose result is then cached
+     *
+     * @param  program      A program created with glCreateProgram
+     * @param  sources      Everything link compiles, as passed to glShaderSource
+     */
+    template <typename Fn>
+    auto load_or_link(u32 program, std::span<const std::string_view> sources, Fn&& link)
+        -> Result<void>
+    {
+        const auto watch = Stopwatch{};
+
+        const auto key = is_enabled() ? hash(sources) : 0;
+        if (is_enabled() && load(program, key))
+        {
+            stats.hits++;
+            stats.seconds += watch.seconds();
+            return {};
+        }
+
+        stats.misses++;
+        if (is_enabled()) { glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 1); }
+        auto result = link(program);
+        if (result && is_enabled()) { store(program, key); }
+
+        stats.seconds += watch.seconds();
+        return result;
+    }
+
+  private:
+    std::filesystem::path directory{};
+    std::string driver{}; // vendor, renderer and version
+
+    [[nodiscard]] auto hash(std::span<const std::string_view> sources) const -> u64;
+
+    [[nodiscard]] auto path(u64 key) const -> std::filesystem::path;
+
+    [[nodiscard]] auto load(u32 program, u64 key) -> bool;
+
+    void store(u32 program, u64 key) const;
+};
+} // namespace sm::gl
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_PROGRAM_CACHE_IMPL)
+
+#include <array>        // for to_array
+#include <cstdlib>      // for getenv
+#include <cstring>      // for memcpy
+#include <fstream>      // for ifstream, ofstream
+#include <iterator>     // for istreambuf_iterator
+#include <system_error> // for error_code
+#include <vector>       // for vector
+
+#if !defined(_WIN32)
+#include <fcntl.h>    // for open
+#include <sys/stat.h> // for lstat
+#include <unistd.h>   // for write, close, geteuid
+#endif
+
+#include "ankerl/unordered_dense.h" // for wyhash
+#include "fmt/format.h"             // for format
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+namespace sm::gl
+{
+namespace detail
+{
+// precedes the binary format and the binary itself in every file
+inline constexpr auto program_cache_magic = std::string_view{"samarium program 1\n"};
+
+// the driver runs whatever binary it finds, so nobody else may be able to put one there
+inline auto is_private_directory([[maybe_unused]] const std::filesystem::path& directory) -> bool
+{
+#if defined(_WIN32)
+    return true; // default_directory() is per user, and permissions are ACLs
+#else
+    struct stat status = {};
+    return ::lstat(directory.c_str(), &status) == 0 && S_ISDIR(status.st_mode) &&
+           status.st_uid == ::geteuid() && (status.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#endif
+}
+
+// create file_path, or fail if something (eg a symlink) is already there
+inline auto write_new_file(const std::filesystem::path& file_path, std::span<const char> bytes)
+    -> bool
+{
+#if defined(_WIN32)
+    if (std::filesystem::exists(std::filesystem::symlink_status(file_path))) { return false; }
+    auto stream = std::ofstream{file_path, std::ios::binary};
+    stream.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    stream.close();
+    return static_cast<bool>(stream);
+#else
+    const auto fd =
+        ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) { return false; }
+
+    auto written = u64{};
+    while (written < bytes.size())
+    {
+        const auto size = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (size <= 0) { break; }
+        written += static_cast<u64>(size);
+    }
+    return ::close(fd) == 0 && written == bytes.size();
+#endif
+}
+} // namespace detail
+
+SM_INLINE ProgramCache::ProgramCache(const std::filesystem::path& directory_)
+    : directory{directory_}
+{
+    if (directory.empty()) { return; }
+
+    auto format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+    auto error         = std::error_code{};
+    const auto created = std::filesystem::create_directories(directory, error);
+    if (created)
+    {
+        std::filesystem::permissions(directory, std::filesystem::perms::owner_all,
+                                     std::filesystem::perm_options::replace, error);
+    }
+    if (format_count == 0 || error || !detail::is_private_directory(directory))
+    {
+        directory.clear(); // nothing could be cached
+        return;
+    }
+
+    for (const auto name : std::to_array<GLenum>({GL_VENDOR, GL_RENDERER, GL_VERSION}))
+    {
+        driver += reinterpret_cast<const char*>(glGetString(name));
+        driver += '\n';
+    }
+}
+
+SM_INLINE auto ProgramCache::default_directory() -> std::filesystem::path
+{
+    // per user rather than in the temporary directory, where others could plant binaries
+    const auto from_environment = [](const char* name) -> std::filesystem::path
+    {
+        const auto* value = std::getenv(name);
+        if (value == nullptr) { return {}; }
+        auto path = std::filesystem::path{value};
+        return path.is_absolute() ? path : std::filesystem::path{};
+    };
+
+#if defined(_WIN32)
+    const auto cache = from_environment("LOCALAPPDATA");
+#else
+    auto cache = from_environment("XDG_CACHE_HOME");
+    if (const auto home = from_environment("HOME"); cache.empty() && !home.empty())
+    {
+        cache = home / ".cache";
+    }
+#endif
+
+    if (cache.empty()) { return {}; }
+    return cache / "samarium" / "programs";
+}
+
+SM_INLINE auto ProgramCache::hash(std::span<const std::string_view> sources) const -> u64
+{
+    auto key = std::string{driver};
+    for (const auto& source : sources)
+    {
+        key += source;
+        key += '\0'; // so that moving text between stages changes the key
+    }
+    return ankerl::unordered_dense::detail::wyhash::hash(key.data(), key.size());
+}
+
+SM_INLINE auto ProgramCache::path(u64 key) const -> std::filesystem::path
+{
+    return directory / fmt::format("{:016x}.bin", key);
+}
+
+SM_INLINE auto ProgramCache::load(u32 program, u64 key) -> bool
+{
+    auto stream = std::ifstream{path(key), std::ios::binary};
+    if (!stream) { return false; }
+
+    const auto contents = std::string{std::istreambuf_iterator<char>{stream}, {}};
+    const auto header   = detail::program_cache_magic.size() + sizeof(GLenum);
+    if (contents.size() <= header || !contents.starts_with(detail::program_cache_magic))
+    {
+        return false;
+    }
+
+    auto format = GLenum{};
+    std::memcpy(&format, contents.data() + detail::program_cache_magic.size(), sizeof(format));
+    glProgramBinary(program, format, contents.data() + header,
+                    static_cast<i32>(contents.size() - header));
+
+    auto linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == 0) { stats.rejected++; }
+    return linked != 0;
+}
+
+SM_INLINE void ProgramCache::store(u32 program, u64 key) const
+{
+    auto size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size == 0) { return; }
+
+    // the magic, the binary format and then the binary
+    const auto header = detail::program_cache_magic.size() + sizeof(GLenum);
+    auto contents     = std::vector<char>(header + static_cast<u64>(size));
+    auto format       = GLenum{};
+    glGetProgramBinary(program, size, nullptr, &format, contents.data() + header);
+    std::memcpy(contents.data(), detail::program_cache_magic.data(),
+                detail::program_cache_magic.size());
+    std::memcpy(contents.data() + detail::program_cache_magic.size(), &format, sizeof(format));
+
+    // write next to it and rename, so a concurrent load never sees half a file. A leftover from a
+    // crash is removed (not followed, if it's a symlink) first
+    const auto cache_path = path(key);
+    auto temporary_path   = cache_path;
+    temporary_path += fmt::format(".{}.part", program);
+    auto error = std::error_code{};
+    std::filesystem::remove(temporary_path, error);
+
+    // a failed write only costs a recompile next time
+    const auto written = detail::write_new_file(temporary_path, contents);
+    if (written) { std::filesystem::rename(temporary_path, cache_path, error); }
+    if (!written || error) { std::filesystem::remove(temporary_path, error); }
+}
+} // namespace sm::gl
+
+#endif
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <array>       // for to_array
 #include <filesystem>  // for path
 #include <string>      // for string
 #include <string_view> // for string_view
@@ -24,10 +25,18 @@
 #include "samarium/util/Result.hpp"    // for Result
 #include "samarium/util/file.hpp"      // for read
 
+#include "ProgramCache.hpp" // for ProgramCache
 #include "Texture.hpp"
+#include "gl.hpp" // for glsl_version
 
 namespace sm::gl
 {
+namespace detail
+{
+/// The error log if program failed to link
+[[nodiscard]] auto link_status(u32 program) -> Result<void>;
+} // namespace detail
+
 struct VertexShader
 {
     u32 handle{};
@@ -44,7 +53,7 @@ struct VertexShader
     [[nodiscard]] static auto make(std::string source) -> Result<VertexShader>
     {
         auto program_handle = glCreateShader(GL_VERTEX_SHADER);
-        source              = "#version 460 core\n" + source;
+        source              = glsl_version + source;
         const auto src      = source.c_str();
         glShaderSource(program_handle, 1, &src, nullptr);
         glCompileShader(program_handle);
@@ -104,7 +113,7 @@ struct FragmentShader
     static inline auto make(std::string source) -> Result<FragmentShader>
     {
         auto program_handle = glCreateShader(GL_FRAGMENT_SHADER);
-        source              = "#version 460 core\n" + source;
+        source              = glsl_version + source;
         const auto src      = source.c_str();
         glShaderSource(program_handle, 1, &src, nullptr);
         glCompileShader(program_handle);
@@ -157,6 +166,13 @@ struct Shader
         glLinkProgram(handle);
     }
 
+    /**
+     * @brief               Compile and link a program, or load it from cache if given one
+     */
+    [[nodiscard]] static auto make(const std::string& vertex_source,
+                                   const std::string& fragment_source,
+                                   ProgramCache* cache = nullptr) -> Result<Shader>;
+
     Shader(const Shader&) = delete;
 
     auto operator=(const Shader&) -> Shader& = delete;
@@ -193,7 +209,7 @@ struct Shader
 
 struct ComputeShader
 {
-    u32 handle;
+    u32 handle{};
 
     ComputeShader(const ComputeShader&)                    = delete;
     auto operator=(const ComputeShader&) -> ComputeShader& = delete;
@@ -209,46 +225,64 @@ struct ComputeShader
         return *this;
     }
 
-    static inline auto
-    make(std::string source, i32 local_size_x = 1, i32 local_size_y = 1, i32 local_size_z = 1)
-        -> Result<ComputeShader>
+    static inline auto make(std::string source,
+                            i32 local_size_x    = 1,
+                            i32 local_size_y    = 1,
+                            i32 local_size_z    = 1,
+                            ProgramCache* cache = nullptr) -> Result<ComputeShader>
     {
-        auto program_handle = glCreateShader(GL_COMPUTE_SHADER);
-        source = fmt::format("#version 460 core\nlayout(local_size_x = {}, local_size_y = {}, "
+        source = fmt::format("{}layout(local_size_x = {}, local_size_y = {}, "
                              "local_size_z = {}) in;\n",
-                             local_size_x, local_size_y, local_size_z) +
+                             glsl_version, local_size_x, local_size_y, local_size_z) +
                  source;
-        const auto src_pointer = source.c_str();
-        glShaderSource(program_handle, 1, &src_pointer, nullptr);
-        glCompileShader(program_handle);
 
-        auto success = 0;
-        glGetShaderiv(program_handle, GL_COMPILE_STATUS, &success);
+        auto shader   = ComputeShader{};
+        shader.handle = glCreateProgram();
 
-        if (success != 0)
+        const auto link = [&source](u32 program) -> Result<void>
         {
-            auto shader   = ComputeShader{};
-            shader.handle = glCreateProgram();
-            glAttachShader(shader.handle, program_handle);
-            glLinkProgram(shader.handle);
-            return {std::move(shader)};
-        }
-
-        auto log_size = 0;
-        auto log_str  = std::string(1024, ' ');
-        glGetShaderInfoLog(program_handle, 1024, &log_size, log_str.data());
-
-        return make_unexpected(
-            fmt::format("ComputeShader compilation error:\n{}",
-                        std::string_view{log_str.data(), static_cast<u64>(log_size)}));
+            auto program_handle    = glCreateShader(GL_COMPUTE_SHADER);
+            const auto src_pointer = source.c_str();
+            glShaderSource(program_handle, 1, &src_pointer, nullptr);
+            glCompileShader(program_handle);
+
+            auto success = 0;
+            glGetShaderiv(program_handle, GL_COMPILE_STATUS, &success);
+
+            if (success != 0)
+            {
+                glAttachShader(program, program_handle);
+                glLinkProgram(program);
+                glDetachShader(program, program_handle);
+                glDeleteShader(program_handle);
+                return detail::link_status(program);
+            }
+
+            auto log_size = 0;
+            auto log_str  = std::string(1024, ' ');
+            glGetShaderInfoLog(program_handle, 1024, &log_size, log_str.data());
+            glDeleteShader(program_handle);
+
+            return make_unexpected(
+                fmt::format("ComputeShader compilation error:\n{}",
+                            std::string_view{log_str.data(), static_cast<u64>(log_size)}));
+        };
+
+        auto uncached      = ProgramCache{};
+        const auto sources = std::to_array<std::string_view>({source});
+        const auto result =
+            (cache != nullptr ? *cache : uncached).load_or_link(shader.handle, sources, link);
+        if (!result) { return make_unexpected(result.error()); }
+        return {std::move(shader)};
     }
 
     explicit ComputeShader(const std::string& source,
-                           i32 local_size_x = 1,
-                           i32 local_size_y = 1,
-                           i32 local_size_z = 1)
+                           i32 local_size_x    = 1,
+                           i32 local_size_y    = 1,
+                           i32 local_size_z    = 1,
+                           ProgramCache* cache = nullptr)
     {
-        auto result = make(source);
+        auto result = make(source, local_size_x, local_size_y, local_size_z, cache);
         if (result) { *this = std::move(*result); }
         else { throw Error{result.error()}; }
     }
@@ -279,10 +313,58 @@ struct ComputeShader
 #include "glad/glad.h"          // for GL_COMPILE_STATUS, glCompileS...
 #include "glm/gtc/type_ptr.hpp" // forvalue_ptr
 
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
 #include "Shader.hpp"
 
 namespace sm::gl
 {
+SM_INLINE auto detail::link_status(u32 program) -> Result<void>
+{
+    auto success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success != 0) { return {}; }
+
+    auto log_size = 0;
+    auto log_str  = std::string(1024, ' ');
+    glGetProgramInfoLog(program, 1024, &log_size, log_str.data());
+    return make_unexpected(fmt::format("Shader program link error:\n{}",
+                                       std::string_view{log_str.data(),
+                                                        static_cast<u64>(log_size)}));
+}
+
+SM_INLINE auto Shader::make(const std::string& vertex_source,
+                            const std::string& fragment_source,
+                            ProgramCache* cache) -> Result<Shader>
+{
+    auto shader = Shader{};
+
+    const auto link = [&](u32 program) -> Result<void>
+    {
+        const auto vertex = VertexShader::make(vertex_source);
+        if (!vertex) { return make_unexpected(vertex.error()); }
+        const auto fragment = FragmentShader::make(fragment_source);
+        if (!fragment) { return make_unexpected(fragment.error()); }
+
+        glAttachShader(program, vertex->handle);
+        glAttachShader(program, fragment->handle);
+        glLinkProgram(program);
+        // so that the shaders are deleted with their wrappers
+        glDetachShader(program, vertex->handle);
+        glDetachShader(program, fragment->handle);
+        return detail::link_status(program);
+    };
+
+    // the version is prepended when compiling, so it is part of the source
+    auto uncached = ProgramCache{};
+    const auto sources =
+        std::to_array<std::string_view>({glsl_version, vertex_source, fragment_source});
+    const auto result =
+        (cache != nullptr ? *cache : uncached).load_or_link(shader.handle, sources, link);
+    if (!result) { return make_unexpected(result.error()); }
+    return {std::move(shader)};
+}
+
 auto Shader::get_uniform_location(const std::string& name) const -> i32
 {
     return glGetUniformLocation(handle, name.c_str());
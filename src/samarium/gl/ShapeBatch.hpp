@@ -0,0 +1,168 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <span>   // for span
+#include <vector> // for vector
+
+#include "glm/ext/matrix_float4x4.hpp" // for mat4
+
+#include "samarium/core/types.hpp"     // for u32, u64, f32
+#include "samarium/graphics/Color.hpp" // for Color
+#include "samarium/math/Vector2.hpp"   // for Vector2f
+
+#include "Vertex.hpp" // for Vertex, Layout
+
+namespace sm::gl
+{
+/**
+ * @brief Shapes queued by draw:: for the current frame, drawn by Context::flush()
+ *
+ * @details Shapes are kept in submission order, so overlapping shapes blend as if drawn one by
+ * one. Consecutive shapes of the same kind and transform are merged into a run, which is a single
+ * draw call: filled regular polygons (including circles) without borders are instances of the
+ * "circles" shader, glyphs are textured triangles for the "text" shader and everything else is
+ * triangles for the "PosColor" shader
+ */
+struct ShapeBatch
+{
+    enum class Kind
+    {
+        Triangles,
+        RegularPolygons,
+        Glyphs
+    };
+
+    /// Matches struct RegularPolygon in shaders/circles.vert.glsl
+    struct Instance
+    {
+        Vector2f centre{};
+        f32 radius{};
+        Color color{};
+    };
+
+    struct Run
+    {
+        Kind kind{};
+        glm::mat4 transform{1.0F};
+        u32 point_count{}; // of each regular polygon
+        u32 texture{};     // handle of the glyph atlas
+        u64 offset{};      // into vertices, instances or glyph_vertices
+        u64 count{};
+    };
+
+    std::vector<Vertex<Layout::PosColor>> vertices{};
+    std::vector<Instance> instances{};
+    std::vector<Vertex<Layout::PosColorTex>> glyph_vertices{};
+    std::vector<Run> runs{};
+
+    /**
+     * @brief               Append vertex_count vertices for GL_TRIANGLES and return them to fill
+     */
+    [[nodiscard]] auto triangles(const glm::mat4& transform, u64 vertex_count)
+        -> std::span<Vertex<Layout::PosColor>>;
+
+    void regular_polygon(const glm::mat4& transform, u32 point_count, const Instance& instance);
+
+    /**
+     * @brief               Append count regular polygons with point_count points each and return
+     * them to fill
+     */
+    [[nodiscard]] auto regular_polygons(const glm::mat4& transform, u32 point_count, u64 count)
+        -> std::span<Instance>;
+
+    /**
+     * @brief               Append vertex_count vertices for GL_TRIANGLES textured with texture, with
+     * texture coordinates in pixels, and return them to fill
+     */
+    [[nodiscard]] auto glyphs(const glm::mat4& transform, u32 texture, u64 vertex_count)
+        -> std::span<Vertex<Layout::PosColorTex>>;
+
+    [[nodiscard]] auto empty() const -> bool;
+
+    void clear();
+
+  private:
+    void extend(Kind kind,
+                const glm::mat4& transform,
+                u32 point_count,
+                u32 texture,
+                u64 offset,
+                u64 count);
+};
+} // namespace sm::gl
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_SHAPE_BATCH_IMPL)
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+namespace sm::gl
+{
+SM_INLINE auto ShapeBatch::triangles(const glm::mat4& transform, u64 vertex_count)
+    -> std::span<Vertex<Layout::PosColor>>
+{
+    const auto offset = vertices.size();
+    vertices.resize(offset + vertex_count);
+    extend(Kind::Triangles, transform, 0, 0, offset, vertex_count);
+    return {vertices.data() + offset, vertex_count};
+}
+
+SM_INLINE void
+ShapeBatch::regular_polygon(const glm::mat4& transform, u32 point_count, const Instance& instance)
+{
+    extend(Kind::RegularPolygons, transform, point_count, 0, instances.size(), 1);
+    instances.push_back(instance);
+}
+
+SM_INLINE auto ShapeBatch::regular_polygons(const glm::mat4& transform, u32 point_count, u64 count)
+    -> std::span<Instance>
+{
+    const auto offset = instances.size();
+    instances.resize(offset + count);
+    extend(Kind::RegularPolygons, transform, point_count, 0, offset, count);
+    return {instances.data() + offset, count};
+}
+
+SM_INLINE auto ShapeBatch::glyphs(const glm::mat4& transform, u32 texture, u64 vertex_count)
+    -> std::span<Vertex<Layout::PosColorTex>>
+{
+    const auto offset = glyph_vertices.size();
+    glyph_vertices.resize(offset + vertex_count);
+    extend(Kind::Glyphs, transform, 0, texture, offset, vertex_count);
+    return {glyph_vertices.data() + offset, vertex_count};
+}
+
+SM_INLINE auto ShapeBatch::empty() const -> bool { return runs.empty(); }
+
+SM_INLINE void ShapeBatch::clear()
+{
+    // keep the capacity, the next frame usually draws about as much
+    vertices.clear();
+    instances.clear();
+    glyph_vertices.clear();
+    runs.clear();
+}
+
+SM_INLINE void ShapeBatch::extend(
+    Kind kind, const glm::mat4& transform, u32 point_count, u32 texture, u64 offset, u64 count)
+{
+    if (!runs.empty())
+    {
+        auto& run = runs.back();
+        if (run.kind == kind && run.point_count == point_count && run.texture == texture &&
+            run.transform == transform)
+        {
+            run.count += count;
+            return;
+        }
+    }
+    runs.push_back({kind, transform, point_count, texture, offset, count});
+}
+} // namespace sm::gl
+
+#endif
@@ -35,9 +35,30 @@ struct Sync
         }
     }
 
+    /// Without blocking, so a frame can check on earlier ones
+    [[nodiscard]] auto is_signaled() const -> bool
+    {
+        if (handle == nullptr) { return true; }
+        const auto status = glClientWaitSync(handle, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+
     Sync(const Sync&)                    = delete;
     auto operator=(const Sync&) -> Sync& = delete;
 
+    Sync(Sync&& other) noexcept : handle{other.handle} { other.handle = nullptr; }
+
+    auto operator=(Sync&& other) noexcept -> Sync&
+    {
+        if (this != &other)
+        {
+            glDeleteSync(handle);
+            handle       = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+
     ~Sync() { glDeleteSync(handle); }
 };
 
@@ -7,15 +7,18 @@
 
 #pragma once
 
-#include <filesystem> // for path
-#include <string>     // for string
-
-#include "glad/glad.h"
+#include <bit>         // for bit_cast
+#include <filesystem>  // for path
+#include <memory>      // for unique_ptr
+#include <optional>    // for optional
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
 
 #include "ft2build.h"
 #include FT_FREETYPE_H
 
-#include "samarium/core/types.hpp"     // for i32
+#include "samarium/core/types.hpp"     // for i32, u32, u64, f32
 #include "samarium/gl/Context.hpp"     // for Context
 #include "samarium/gl/Texture.hpp"     // for Texture
 #include "samarium/gl/Vertex.hpp"      // for Vertex
@@ -29,90 +32,129 @@ namespace sm::draw
 /// Holds all state information relevant to a character as loaded using FreeType
 struct Character
 {
-    gl::Texture texture;    // glyph texture
-    Vector2_t<u32> size;    // Size of glyph
-    Vector2_t<i32> bearing; // Offset from baseline to left/top of glyph
-    u32 advance;            // Horizontal offset to advance to next glyph
+    Vector2_t<u32> position; // Top left of the glyph in the atlas, in pixels
+    Vector2_t<u32> size;     // Size of glyph
+    Vector2_t<i32> bearing;  // Offset from baseline to left/top of glyph
+    u32 advance;             // Horizontal offset to advance to next glyph
 };
 
-struct Text
+/**
+ * @brief Single channel texture holding every glyph loaded so far, packed with the skyline
+ * bottom-left heuristic
+ */
+struct GlyphAtlas
 {
-    Map<char, Character> characters{};
-
-    [[nodiscard]] static auto make(const std::filesystem::path& font_path, u32 height = 48)
-        -> Result<Text>
+    struct Segment
     {
-        if (!std::filesystem::exists(font_path))
-        {
-            return make_unexpected(fmt::format("{} does not exist", font_path));
-        }
+        u32 x{};
+        u32 y{}; // height of the skyline over [x, x + width)
+        u32 width{};
+    };
+
+    gl::Texture texture;
+    Dimensions dims{};
+    std::vector<Segment> skyline{};
+
+    explicit GlyphAtlas(Dimensions dims_);
+
+    /**
+     * @brief               Reserve space for a size-sized glyph, growing the texture if needed
+     *
+     * @param  size         Size of the glyph, without padding
+     * @param  context      Flushed before growing, as queued text refers to the old texture. May
+     * be null if nothing has been queued yet
+     * @return              Top left of the space, or nullopt if the texture cannot grow any more
+     */
+    [[nodiscard]] auto pack(Vector2_t<u32> size, gl::Context* context)
+        -> std::optional<Vector2_t<u32>>;
+
+  private:
+    [[nodiscard]] auto try_pack(Vector2_t<u32> size) -> std::optional<Vector2_t<u32>>;
+
+    [[nodiscard]] auto grow(Dimensions new_dims, gl::Context* context) -> bool;
+};
 
-        if (!std::filesystem::is_regular_file(font_path))
-        {
-            return make_unexpected(fmt::format("{} is not a file", font_path));
-        }
+namespace detail
+{
+struct FreeTypeDeleter
+{
+    void operator()(FT_Library library) const { FT_Done_FreeType(library); }
+    void operator()(FT_Face face) const { FT_Done_Face(face); }
+};
 
-        auto* ft = FT_Library{};
+struct TextLayoutView
+{
+    std::string_view text;
+    f32 scale;
+};
 
-        // All functions return a value different than 0 whenever an error occurred
-        if (FT_Init_FreeType(&ft) != 0)
-        {
-            return make_unexpected(std::string{"Could not initialize FreeType"});
-        }
+struct TextLayoutKey
+{
+    std::string text;
+    f32 scale;
 
-        // load font as face
-        auto* face = FT_Face{};
+    operator TextLayoutView() const noexcept { return {text, scale}; }
+};
 
-        if (FT_New_Face(ft, font_path.string().c_str(), 0, &face) != 0)
-        {
-            return make_unexpected(fmt::format("Could not create font: {}", font_path));
-        }
+struct TextLayoutHash
+{
+    using is_transparent = void;
+    using is_avalanching = void;
 
-        // set size to load glyphs as
-        FT_Set_Pixel_Sizes(face, 0, height);
+    [[nodiscard]] auto operator()(TextLayoutView key) const noexcept -> u64
+    {
+        return ankerl::unordered_dense::detail::wyhash::mix(
+            ankerl::unordered_dense::hash<std::string_view>{}(key.text),
+            std::bit_cast<u32>(key.scale));
+    }
+};
 
-        // disable byte-alignment restriction
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+struct TextLayoutEqual
+{
+    using is_transparent = void;
 
-        auto text = Text{};
+    [[nodiscard]] auto operator()(TextLayoutView a, TextLayoutView b) const noexcept
+    {
+        return a.scale == b.scale && a.text == b.text;
+    }
+};
 
-        // load first 128 characters of ASCII set
-        for (/* unsigned */ char c = ' '; c <= '~'; c++)
-        {
-            // Load character glyph
-            if (FT_Load_Char(face, static_cast<u64>(c), FT_LOAD_RENDER) != 0)
-            {
-                return make_unexpected(
-                    fmt::format("Could not create glyph for {} for font: {}", c, font_path));
-            }
-
-            const auto& bitmap = face->glyph->bitmap;
-            // fmt::print("\nglyph for ({}) width: {} rows: {}. ", c, bitmap.width, bitmap.rows);
-            auto texture = gl::Texture{gl::ImageFormat::RGBA8, gl::Texture::Wrap::ClampEdge,
-                                       gl::Texture::Filter::Linear, gl::Texture::Filter::Linear};
-
-            // some characters eg space don't have data but take up space
-            if (bitmap.width * bitmap.rows != 0)
-            {
-                texture.set_data(
-                    std::span{bitmap.buffer, static_cast<u64>(bitmap.width * bitmap.rows)},
-                    {static_cast<u64>(bitmap.width), static_cast<u64>(bitmap.rows)});
-            }
-
-            text.characters.insert(
-                {c, Character{std::move(texture),
-                              {bitmap.width, bitmap.rows},
-                              {face->glyph->bitmap_left, face->glyph->bitmap_top},
-                              static_cast<u32>(face->glyph->advance.x)}});
-        }
+/// Decode the UTF-8 code point starting at text[index] and move index past it, invalid bytes
+/// decode to U+FFFD
+[[nodiscard]] auto next_code_point(std::string_view text, u64& index) -> char32_t;
+} // namespace detail
 
-        // destroy FreeType once we're finished
-        FT_Done_Face(face);
-        FT_Done_FreeType(ft);
+struct Text
+{
+    /// Quads of a string relative to its position, with texture coordinates in atlas pixels
+    using Layout = std::vector<gl::Vertex<gl::Layout::PosTex>>;
+
+    /// Layouts are dropped all at once past this many, to bound the memory of dynamic strings
+    static constexpr u64 max_cached_layouts = 1024;
+
+    std::unique_ptr<FT_LibraryRec_, detail::FreeTypeDeleter> library;
+    std::unique_ptr<FT_FaceRec_, detail::FreeTypeDeleter> face; // destroyed before library
+    GlyphAtlas atlas;
+    Map<char32_t, Character> characters{};
+    Map<detail::TextLayoutKey, Layout, detail::TextLayoutHash, detail::TextLayoutEqual> layouts{};
+
+    /**
+     * @brief               Load a font, and the printable ASCII characters into the atlas. Other
+     * characters are loaded the first time they are drawn
+     *
+     * @param  font_path    Path to any font FreeType can read
+     * @param  height       Size to rasterize glyphs at, in pixels
+     */
+    [[nodiscard]] static auto make(const std::filesystem::path& font_path, u32 height = 48)
+        -> Result<Text>;
 
-        return text;
-    }
+    /**
+     * @brief               Get the cached layout of text at scale, laying it out if needed
+     */
+    [[nodiscard]] auto layout(gl::Context& context, std::string_view text, f32 scale)
+        -> const Layout&;
 
+    /// Queue text on context's ShapeBatch, so all text in a frame is drawn in one draw call
     void operator()(gl::Context& context,
                     const std::string& text,
                     Vector2f pos,
@@ -121,64 +163,352 @@ struct Text
                     glm::mat4 transform);
 
     void operator()(Window& window, const std::string& text, Vector2f pos, f32 scale, Color color);
+
+  private:
+    [[nodiscard]] auto load(char32_t code_point, gl::Context* context) -> Result<Character>;
+
+    [[nodiscard]] auto character(char32_t code_point, gl::Context& context) -> Character;
 };
 } // namespace sm::draw
 
-#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_DRAW_IMPL)
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_TEXT_IMPL)
+
+#include <algorithm> // for max, min
+
+#include "fmt/format.h" // for format
+#include "fmt/std.h"    // for formatter<std::filesystem::path>
+#include "glad/glad.h"  // for glClearTexImage, glCopyImageSubData, glTextureSubImage2D
 
-#include "samarium/core/inline.hpp"
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/math/loop.hpp"   // for start_end
 
 namespace sm::draw
 {
-SM_INLINE void Text::operator()(gl::Context& context,
-                                const std::string& text,
-                                Vector2f pos,
-                                f32 scale,
-                                Color color,
-                                glm::mat4 transform)
+SM_INLINE GlyphAtlas::GlyphAtlas(Dimensions dims_)
+    : texture{gl::ImageFormat::R8, dims_, gl::Texture::Wrap::ClampEdge,
+              gl::Texture::Filter::Linear, gl::Texture::Filter::Linear},
+      dims{dims_}, skyline{{0, 0, static_cast<u32>(dims_.x)}}
 {
-    scale /= 1000.0F; // FIXME pixel to screen size
+    // the gaps between glyphs must be empty for linear filtering
+    glClearTexImage(texture.handle, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+}
 
-    const auto& shader = context.shaders.at("text");
-    context.set_active(shader);
-    shader.set("view", transform);
-    shader.set("color", color);
+SM_INLINE auto GlyphAtlas::pack(Vector2_t<u32> size, gl::Context* context)
+    -> std::optional<Vector2_t<u32>>
+{
+    // a pixel of padding to the right and below, the left and top edges are clamped
+    size += Vector2_t<u32>{1, 1};
 
-    // iterate through all characters
-    for (auto c : text)
+    while (true)
     {
-        auto& ch = characters.at(c);
-        if (ch.size.x * ch.size.y == 0)
+        if (const auto position = try_pack(size)) { return position; }
+
+        // glyphs only ever move with the texture, so existing layouts stay valid
+        const auto new_dims = Dimensions{std::max(dims.x, static_cast<u64>(size.x)), dims.y * 2};
+        if (!grow(new_dims, context)) { return std::nullopt; }
+    }
+}
+
+SM_INLINE auto GlyphAtlas::try_pack(Vector2_t<u32> size) -> std::optional<Vector2_t<u32>>
+{
+    auto best_index = skyline.size();
+    auto best_y     = static_cast<u32>(dims.y);
+    for (auto i : loop::end(skyline.size()))
+    {
+        const auto x = skyline[i].x;
+        if (x + size.x > dims.x) { break; }
+
+        // the lowest height the glyph can rest at without overlapping segments to the right
+        auto y = 0U;
+        for (auto j = i; j < skyline.size() && skyline[j].x < x + size.x; j++)
+        {
+            y = std::max(y, skyline[j].y);
+        }
+
+        if (y + size.y <= dims.y && y < best_y)
         {
-            pos.x += static_cast<f32>(ch.advance >> 6) * scale;
+            best_index = i;
+            best_y     = y;
+        }
+    }
+
+    if (best_index == skyline.size()) { return std::nullopt; }
+
+    const auto x = skyline[best_index].x;
+    skyline.insert(skyline.begin() + static_cast<i64>(best_index), {x, best_y + size.y, size.x});
+
+    // trim the segments now under the glyph
+    const auto end = x + size.x;
+    auto i         = best_index + 1;
+    while (i < skyline.size() && skyline[i].x < end)
+    {
+        auto& segment = skyline[i];
+        if (segment.x + segment.width <= end)
+        {
+            skyline.erase(skyline.begin() + static_cast<i64>(i));
             continue;
         }
+        segment.width -= end - segment.x;
+        segment.x = end;
+        break;
+    }
+
+    // merge neighbours of the same height
+    for (auto j = u64{1}; j < skyline.size();)
+    {
+        if (skyline[j - 1].y == skyline[j].y)
+        {
+            skyline[j - 1].width += skyline[j].width;
+            skyline.erase(skyline.begin() + static_cast<i64>(j));
+        }
+        else { j++; }
+    }
+
+    return Vector2_t<u32>{x, best_y};
+}
+
+SM_INLINE auto GlyphAtlas::grow(Dimensions new_dims, gl::Context* context) -> bool
+{
+    auto max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    new_dims.y = std::min(new_dims.y, static_cast<u64>(max_size));
+    if (new_dims.x > static_cast<u64>(max_size) || new_dims == dims) { return false; }
+
+    // draw queued text while the old texture still exists
+    if (context != nullptr) { context->flush(); }
+
+    auto new_atlas = GlyphAtlas{new_dims};
+    glCopyImageSubData(texture.handle, GL_TEXTURE_2D, 0, 0, 0, 0, new_atlas.texture.handle,
+                       GL_TEXTURE_2D, 0, 0, 0, 0, static_cast<i32>(dims.x),
+                       static_cast<i32>(dims.y), 1);
+
+    if (new_dims.x > dims.x)
+    {
+        skyline.push_back({static_cast<u32>(dims.x), 0, static_cast<u32>(new_dims.x - dims.x)});
+    }
+    texture = std::move(new_atlas.texture);
+    dims    = new_dims;
+    return true;
+}
+
+namespace detail
+{
+SM_INLINE auto next_code_point(std::string_view text, u64& index) -> char32_t
+{
+    constexpr auto replacement = char32_t{0xFFFD};
+
+    const auto lead = static_cast<u8>(text[index++]);
+    if (lead < 0x80) { return lead; }
+
+    auto length     = u64{};
+    auto code_point = char32_t{};
+    auto min        = char32_t{};
+    if ((lead & 0xE0U) == 0xC0U)
+    {
+        length     = 1;
+        code_point = lead & 0x1FU;
+        min        = 0x80;
+    }
+    else if ((lead & 0xF0U) == 0xE0U)
+    {
+        length     = 2;
+        code_point = lead & 0x0FU;
+        min        = 0x800;
+    }
+    else if ((lead & 0xF8U) == 0xF0U)
+    {
+        length     = 3;
+        code_point = lead & 0x07U;
+        min        = 0x10000;
+    }
+    else { return replacement; }
+
+    for (auto i = u64{}; i < length; i++)
+    {
+        if (index == text.size()) { return replacement; }
+        const auto byte = static_cast<u8>(text[index]);
+        if ((byte & 0xC0U) != 0x80U) { return replacement; } // resynchronize on this byte
+        code_point = (code_point << 6U) | (byte & 0x3FU);
+        index++;
+    }
+
+    // overlong encodings, surrogates and values past Unicode
+    if (code_point < min || (code_point >= 0xD800 && code_point <= 0xDFFF) ||
+        code_point > 0x10FFFF)
+    {
+        return replacement;
+    }
+    return code_point;
+}
+} // namespace detail
+
+SM_INLINE auto Text::make(const std::filesystem::path& font_path, u32 height) -> Result<Text>
+{
+    if (!std::filesystem::exists(font_path))
+    {
+        return make_unexpected(fmt::format("{} does not exist", font_path));
+    }
+
+    if (!std::filesystem::is_regular_file(font_path))
+    {
+        return make_unexpected(fmt::format("{} is not a file", font_path));
+    }
+
+    auto* ft = FT_Library{};
+
+    // All functions return a value different than 0 whenever an error occurred
+    if (FT_Init_FreeType(&ft) != 0)
+    {
+        return make_unexpected(std::string{"Could not initialize FreeType"});
+    }
+    auto library = decltype(Text::library){ft};
+
+    // load font as face
+    auto* ft_face = FT_Face{};
+
+    if (FT_New_Face(ft, font_path.string().c_str(), 0, &ft_face) != 0)
+    {
+        return make_unexpected(fmt::format("Could not create font: {}", font_path));
+    }
+    auto face = decltype(Text::face){ft_face};
+
+    // set size to load glyphs as
+    FT_Set_Pixel_Sizes(ft_face, 0, height);
+
+    // printable ASCII takes about a 512x256 corner at the default height
+    auto text = Text{std::move(library), std::move(face), GlyphAtlas{{1024, 1024}}};
+
+    // Load the printable ASCII characters up front, the rest on demand
+    for (auto c : loop::start_end(static_cast<u32>(' '), static_cast<u32>('~') + 1))
+    {
+        const auto character = text.load(c, nullptr);
+        if (!character)
+        {
+            return make_unexpected(fmt::format("Could not create glyph for {} for font: {}",
+                                               static_cast<char>(c), font_path));
+        }
+        text.characters.insert({static_cast<char32_t>(c), *character});
+    }
+
+    return text;
+}
 
-        const auto xpos = pos.x + static_cast<f32>(ch.bearing.x) * scale;
-        const auto ypos = pos.y - static_cast<f32>(ch.size.y - ch.bearing.y) * scale;
+SM_INLINE auto Text::load(char32_t code_point, gl::Context* context) -> Result<Character>
+{
+    if (FT_Load_Char(face.get(), code_point, FT_LOAD_RENDER) != 0)
+    {
+        return make_unexpected(fmt::format("Could not create glyph for U+{:04X}",
+                                           static_cast<u32>(code_point)));
+    }
 
-        const auto w = static_cast<f32>(ch.size.x) * scale;
-        const auto h = static_cast<f32>(ch.size.y) * scale;
-        // update VBO for each character
-        const f32 vertices[6][4] = {{xpos, ypos + h, 0.0F, 0.0F},    {xpos, ypos, 0.0F, 1.0F},
-                                    {xpos + w, ypos, 1.0F, 1.0F},
+    const auto* glyph  = face->glyph;
+    const auto& bitmap = glyph->bitmap;
+    auto character     = Character{{},
+                               {bitmap.width, bitmap.rows},
+                               {glyph->bitmap_left, glyph->bitmap_top},
+                               static_cast<u32>(glyph->advance.x)};
 
-                                    {xpos, ypos + h, 0.0F, 0.0F},    {xpos + w, ypos, 1.0F, 1.0F},
-                                    {xpos + w, ypos + h, 1.0F, 0.0F}};
-        ch.texture.bind();
+    // some characters eg space don't have data but take up space
+    if (bitmap.width * bitmap.rows == 0) { return character; }
+
+    const auto position = atlas.pack(character.size, context);
+    if (!position)
+    {
+        return make_unexpected(fmt::format("Glyph atlas is full, could not add U+{:04X}",
+                                           static_cast<u32>(code_point)));
+    }
+    character.position = *position;
+
+    // disable byte-alignment restriction
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, bitmap.pitch);
+    glTextureSubImage2D(atlas.texture.handle, 0, static_cast<i32>(position->x),
+                        static_cast<i32>(position->y), static_cast<i32>(bitmap.width),
+                        static_cast<i32>(bitmap.rows), GL_RED, GL_UNSIGNED_BYTE, bitmap.buffer);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return character;
+}
+
+SM_INLINE auto Text::character(char32_t code_point, gl::Context& context) -> Character
+{
+    // by value: inserting may move the other characters
+    if (const auto iter = characters.find(code_point); iter != characters.end())
+    {
+        return iter->second;
+    }
 
-        auto& vao = context.vertex_arrays.at("PosTex");
-        context.set_active(vao);
-        const auto& buffer = context.vertex_buffers.at("default");
-        buffer.set_data(vertices);
-        vao.bind(buffer, sizeof(gl::Vertex<gl::Layout::PosTex>));
+    // a glyph that failed to load draws nothing, and isn't retried
+    const auto character = load(code_point, &context).value_or(Character{});
+    characters.insert({code_point, character});
+    return character;
+}
+
+SM_INLINE auto Text::layout(gl::Context& context, std::string_view text, f32 scale)
+    -> const Layout&
+{
+    if (const auto iter = layouts.find(detail::TextLayoutView{text, scale}); iter != layouts.end())
+    {
+        return iter->second;
+    }
+
+    if (layouts.size() >= max_cached_layouts) { layouts.clear(); }
+
+    auto vertices = Layout{};
+    vertices.reserve(text.size() * 6);
+    auto pen = 0.0F;
+    for (auto index = u64{}; index < text.size();)
+    {
+        const auto ch = character(detail::next_code_point(text, index), context);
+
+        if (ch.size.x * ch.size.y != 0)
+        {
+            const auto xpos = pen + static_cast<f32>(ch.bearing.x) * scale;
+            const auto ypos = -static_cast<f32>(static_cast<i32>(ch.size.y) - ch.bearing.y) * scale;
+
+            const auto w = static_cast<f32>(ch.size.x) * scale;
+            const auto h = static_cast<f32>(ch.size.y) * scale;
+
+            const auto left   = static_cast<f32>(ch.position.x);
+            const auto top    = static_cast<f32>(ch.position.y);
+            const auto right  = left + static_cast<f32>(ch.size.x);
+            const auto bottom = top + static_cast<f32>(ch.size.y);
+
+            vertices.insert(vertices.end(), {{{xpos, ypos + h}, {left, top}},
+                                             {{xpos, ypos}, {left, bottom}},
+                                             {{xpos + w, ypos}, {right, bottom}},
+
+                                             {{xpos, ypos + h}, {left, top}},
+                                             {{xpos + w, ypos}, {right, bottom}},
+                                             {{xpos + w, ypos + h}, {right, top}}});
+        }
 
-        // render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-        pos.x += static_cast<f32>(ch.advance) / 64.0F * scale;
-        // bitshift by 6 to get value in pixels (2^6 = 64 (divide
-        // amount of 1/64th pixels by 64 to get amount of pixels))
+        pen += static_cast<f32>(ch.advance) / 64.0F * scale;
+    }
+
+    return layouts.emplace(detail::TextLayoutKey{std::string{text}, scale}, std::move(vertices))
+        .first->second;
+}
+
+SM_INLINE void Text::operator()(gl::Context& context,
+                                const std::string& text,
+                                Vector2f pos,
+                                f32 scale,
+                                Color color,
+                                glm::mat4 transform)
+{
+    scale /= 1000.0F; // FIXME pixel to screen size
+
+    // before queueing, as loading new glyphs may grow the atlas
+    const auto& quads = layout(context, text, scale);
+    if (quads.empty()) { return; }
+
+    const auto vertices = context.shape_batch.glyphs(transform, atlas.texture.handle, quads.size());
+    for (auto i : loop::end(quads.size()))
+    {
+        vertices[i] = {quads[i].pos + pos, color, quads[i].tex_coord};
     }
 }
 
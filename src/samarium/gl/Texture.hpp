@@ -91,7 +91,10 @@ struct Texture
 
     Texture(const Texture&) = delete;
 
-    Texture(Texture&& other) noexcept : handle{other.handle} { other.handle = 0; }
+    Texture(Texture&& other) noexcept : handle{other.handle}, format{other.format}
+    {
+        other.handle = 0;
+    }
 
     Texture& operator=(Texture&& other) noexcept
     {
@@ -55,6 +55,8 @@ struct VertexArray
 
     void bind(const VertexBuffer& buffer, i32 stride);
 
+    void bind(const StreamBuffer::Range& range, i32 stride);
+
     void bind(const ElementBuffer& buffer);
 
     void make_attribute(u32 index, const VertexAttribute& attribute);
@@ -134,6 +136,11 @@ SM_INLINE void VertexArray::bind(const VertexBuffer& buffer, i32 stride)
     glVertexArrayVertexBuffer(handle, 0, buffer.handle, 0, stride);
 }
 
+SM_INLINE void VertexArray::bind(const StreamBuffer::Range& range, i32 stride)
+{
+    glVertexArrayVertexBuffer(handle, 0, range.handle, range.offset, stride);
+}
+
 SM_INLINE void VertexArray::bind(const ElementBuffer& buffer)
 {
     glVertexArrayElementBuffer(handle, buffer.handle);
@@ -13,3 +13,4 @@
 #include "draw/shapes.hpp"
 #include "draw/trail.hpp"
 #include "draw/vertices.hpp"
+#include "draw/particles.hpp"
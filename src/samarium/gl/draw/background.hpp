@@ -17,6 +17,12 @@ namespace sm::draw
 {
 void background(Color color);
 
+/**
+ * @brief               Fill the background with a color, dropping any shapes queued before it as
+ * they would be covered anyway
+ */
+void background(Window& window, Color color);
+
 /**
  * @brief               Fill the background with a gradient
  *
@@ -81,5 +87,11 @@ SM_INLINE void background(Color color)
                  static_cast<f32>(color.b) / 255.0F, static_cast<f32>(color.a) / 255.0F);
     glClear(GL_COLOR_BUFFER_BIT);
 }
+
+SM_INLINE void background(Window& window, Color color)
+{
+    window.context.shape_batch.clear(); // clearing replaces every pixel, even with alpha < 255
+    background(color);
+}
 } // namespace sm::draw
 #endif
@@ -7,8 +7,6 @@
 
 #pragma once
 
-#include "range/v3/view/linear_distribute.hpp"
-
 #include "samarium/graphics/Color.hpp" // for Color
 #include "samarium/gui/Window.hpp"     // for Window
 #include "samarium/math/Vector2.hpp"   // for Vector2f
@@ -21,68 +19,69 @@ struct GridLines
     Color color   = Color{200, 200, 200, 50};
     f32 thickness = 0.1F;
 };
+
+/**
+ * @brief               Draw lines spacing apart over the whole window, in one fullscreen pass
+ * whatever the zoom
+ */
 void grid_lines(Window& window, const GridLines& config = {});
 
 struct GridDots
 {
     f64 spacing     = 1.0;
     Color color     = Color{200, 200, 200, 50};
-    f32 thickness   = 0.03F;
-    u32 point_count = 4;
+    f32 thickness   = 0.03F; ///< Radius of the dots
+    u32 point_count = 4;     ///< Sides of the dots, as in regular_polygon
 };
+
+/**
+ * @brief               Draw a dot at every grid point over the whole window, in one fullscreen
+ * pass whatever the zoom
+ */
 void grid_dots(Window& window, const GridDots& config = {});
 } // namespace sm::draw
 
 #if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_DRAW_IMPL)
 
+#include "glm/matrix.hpp" // for inverse
+
 #include "samarium/core/inline.hpp"
 #include "samarium/gl/draw/grid.hpp"
-#include "samarium/gl/draw/poly.hpp"
-#include "samarium/gl/draw/shapes.hpp"
+#include "samarium/math/math.hpp" // for max
 
 namespace sm::draw
 {
-SM_INLINE void grid_lines(Window& window, const GridLines& config)
+namespace detail
 {
-    auto [x_max, y_max] = window.view.apply_inverse(Vector2{1.0, 1.0});
-    auto [x_min, y_min] = window.view.apply_inverse(Vector2{-1.0, -1.0});
-    x_min               = math::floor_to_nearest(x_min, config.spacing);
-    y_min               = math::floor_to_nearest(y_min, config.spacing);
-    x_max               = math::ceil_to_nearest(x_max, config.spacing);
-    y_max               = math::ceil_to_nearest(y_max, config.spacing);
+// the grid is worked out per pixel in grid.frag.glsl from the inverse of the view
+SM_INLINE void grid(Window& window, f64 spacing, Color color, f32 thickness, u32 point_count)
+{
+    auto& context = window.context;
+    context.flush();
 
-    for (auto i : ranges::views::linear_distribute(
-             x_min, x_max, static_cast<i64>((x_max - x_min) / config.spacing) + 1))
-    {
-        draw::line(window, {{i, 0.0}, {i, 1.0}}, config.color, config.thickness);
-    }
+    const auto& shader = context.shader("grid");
+    context.set_active(shader);
+    shader.set("inverse_view", glm::inverse(glm::mat4{window.view}));
+    shader.set("spacing", static_cast<f32>(spacing));
+    shader.set("color", color);
+    shader.set("thickness", thickness);
+    shader.set("point_count", static_cast<i32>(point_count));
 
-    for (auto i : ranges::views::linear_distribute(
-             y_min, y_max, static_cast<i64>((y_max - y_min) / config.spacing) + 1))
-    {
-        draw::line(window, {{0.0, i}, {1.0, i}}, config.color, config.thickness);
-    }
-};
+    context.set_active(context.vertex_arrays.at("empty"));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+} // namespace detail
 
-SM_INLINE void grid_dots(Window& window, const GridDots& config)
+SM_INLINE void grid_lines(Window& window, const GridLines& config)
 {
-    auto [x_max, y_max] = window.view.apply_inverse(Vector2{1.0, 1.0});
-    auto [x_min, y_min] = window.view.apply_inverse(Vector2{-1.0, -1.0});
-    x_min               = math::floor_to_nearest(x_min, config.spacing);
-    y_min               = math::floor_to_nearest(y_min, config.spacing);
-    x_max               = math::ceil_to_nearest(x_max, config.spacing);
-    y_max               = math::ceil_to_nearest(y_max, config.spacing);
+    detail::grid(window, config.spacing, config.color, config.thickness, 0);
+}
 
-    for (auto i : ranges::views::linear_distribute(
-             x_min, x_max, static_cast<i64>((x_max - x_min) / config.spacing) + 1))
-    {
-        for (auto j : ranges::views::linear_distribute(
-                 y_min, y_max, static_cast<i64>((y_max - y_min) / config.spacing) + 1))
-        {
-            draw::regular_polygon(window, {{i, j}, config.thickness}, config.point_count,
-                                  {.fill_color = config.color});
-        }
-    }
-};
+SM_INLINE void grid_dots(Window& window, const GridDots& config)
+{
+    // at least 3 sides, 0 would draw lines
+    detail::grid(window, config.spacing, config.color, config.thickness,
+                 math::max(config.point_count, 3U));
+}
 } // namespace sm::draw
 #endif
@@ -0,0 +1,159 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <bit>         // for bit_cast
+#include <span>        // for span
+#include <type_traits> // for is_same_v
+#include <utility>     // for pair
+
+#if defined(__AVX2__)
+#include <immintrin.h> // for _mm256_cvtpd_ps, _mm_i32gather_epi32, _MM_TRANSPOSE4_PS
+#endif
+
+#include "samarium/core/types.hpp"             // for u32, u64, f32, f64
+#include "samarium/gl/ShapeBatch.hpp"          // for ShapeBatch
+#include "samarium/graphics/Color.hpp"         // for Color
+#include "samarium/graphics/GradientLUT.hpp"   // for GradientLUT
+#include "samarium/gui/Window.hpp"             // for Window
+#include "samarium/math/Extents.hpp"           // for Extents
+#include "samarium/math/loop.hpp"              // for end
+#include "samarium/physics/ParticleSystem.hpp" // for ParticleSystem
+
+namespace sm::draw
+{
+struct ParticleStyle
+{
+    Color color = Color{255, 8, 66}; ///< Of every particle, unless colored by speed
+
+    /// Color each particle by its speed instead, looked up in this (eg &gradients::lut::magma)
+    const GradientLUT<>* speed_gradient = nullptr;
+    Extents<f64> speed_range            = {0.0, 1.0}; ///< Speeds of the first and last colors
+
+    u32 point_count = 16; ///< Sides of each particle, as in regular_polygon
+};
+
+namespace detail
+{
+// one Instance per particle, converted to f32 four at a time where AVX2 is available
+template <typename Particle_t>
+void particle_instances(std::span<const Particle_t> particles,
+                        std::span<gl::ShapeBatch::Instance> instances,
+                        const ParticleStyle& style)
+{
+    const auto* lut   = style.speed_gradient;
+    const auto scale  = static_cast<f64>(GradientLUT<>::size - 1) /
+                       (style.speed_range.max - style.speed_range.min);
+    const auto offset = -style.speed_range.min * scale;
+    auto i            = u64{};
+
+#if defined(__AVX2__)
+    // an Instance is one 128-bit row of {x, y, radius, color}, so 4 particles are a transpose
+    static_assert(sizeof(gl::ShapeBatch::Instance) == 4 * sizeof(f32));
+
+    if constexpr (std::is_same_v<Particle_t, Particle<f64>>)
+    {
+        const auto color_4  = _mm_set1_epi32(std::bit_cast<i32>(style.color));
+        const auto scale_4  = _mm256_set1_pd(scale);
+        const auto offset_4 = _mm256_set1_pd(offset + 0.5);
+        const auto upper_4  = _mm256_set1_pd(static_cast<f64>(GradientLUT<>::size - 1));
+        auto* out           = reinterpret_cast<f32*>(instances.data());
+
+        // {x0, y0, x2, y2} and {x1, y1, x3, y3} unpack to {x0, x1, x2, x3} and {y0, y1, y2, y3}
+        const auto split = [](const Vector2& v0, const Vector2& v1, const Vector2& v2,
+                              const Vector2& v3)
+        {
+            const auto even = _mm256_set_m128d(_mm_loadu_pd(&v2.x), _mm_loadu_pd(&v0.x));
+            const auto odd  = _mm256_set_m128d(_mm_loadu_pd(&v3.x), _mm_loadu_pd(&v1.x));
+            return std::pair{_mm256_unpacklo_pd(even, odd), _mm256_unpackhi_pd(even, odd)};
+        };
+
+        for (; i + 4 <= particles.size(); i += 4)
+        {
+            const auto* p = particles.data() + i;
+
+            auto colors = color_4;
+            if (lut != nullptr)
+            {
+                // as in colormap: scale, clamp (max first so NaN becomes 0), truncate, gather
+                const auto [vx, vy] = split(p[0].vel, p[1].vel, p[2].vel, p[3].vel);
+                const auto speeds =
+                    _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(vx, vx), _mm256_mul_pd(vy, vy)));
+                const auto scaled  = _mm256_add_pd(_mm256_mul_pd(speeds, scale_4), offset_4);
+                const auto clamped =
+                    _mm256_min_pd(_mm256_max_pd(scaled, _mm256_setzero_pd()), upper_4);
+                colors = _mm_i32gather_epi32(reinterpret_cast<const int*>(lut->colors.data()),
+                                             _mm256_cvttpd_epi32(clamped), 4);
+            }
+
+            const auto [x, y] = split(p[0].pos, p[1].pos, p[2].pos, p[3].pos);
+            auto xs           = _mm256_cvtpd_ps(x);
+            auto ys           = _mm256_cvtpd_ps(y);
+            auto radii =
+                _mm256_cvtpd_ps(_mm256_set_pd(p[3].radius, p[2].radius, p[1].radius, p[0].radius));
+            auto cs = _mm_castsi128_ps(colors);
+
+            _MM_TRANSPOSE4_PS(xs, ys, radii, cs);
+            _mm_storeu_ps(out + 4 * i, xs);
+            _mm_storeu_ps(out + 4 * i + 4, ys);
+            _mm_storeu_ps(out + 4 * i + 8, radii);
+            _mm_storeu_ps(out + 4 * i + 12, cs);
+        }
+    }
+#endif
+
+    for (; i < particles.size(); i++)
+    {
+        const auto& particle = particles[i];
+        auto color           = style.color;
+        if (lut != nullptr)
+        {
+            const auto speed = static_cast<f64>(particle.vel.length());
+            color            = lut->colors[GradientLUT<>::index(speed * scale + offset)];
+        }
+        instances[i] = {particle.pos.template cast<f32>(), static_cast<f32>(particle.radius),
+                        color};
+    }
+}
+} // namespace detail
+
+/**
+ * @brief               Draw every particle as a filled circle, all in one instanced draw call
+ *
+ * @details Positions and radii go straight into the frame's instance buffer as f32, which
+ * Context::flush() uploads with everything else queued this frame. Equivalent to calling
+ * draw::circle for each particle, only much faster for large systems:
+ * @code
+ * draw::particles(window, system, {.speed_gradient = &gradients::lut::magma,
+ *                                  .speed_range    = {0.0, 4.0}});
+ * @endcode
+ */
+template <typename Particle_t, u64 CellCapacity>
+void particles(Window& window,
+               const ParticleSystem<Particle_t, CellCapacity>& system,
+               const ParticleStyle& style,
+               const glm::mat4& transform)
+{
+    if (system.particles.empty() || (style.speed_gradient == nullptr && style.color.a == 0))
+    {
+        return;
+    }
+
+    auto instances = window.context.shape_batch.regular_polygons(transform, style.point_count,
+                                                                 system.particles.size());
+    detail::particle_instances(std::span{system.particles}, instances, style);
+}
+
+template <typename Particle_t, u64 CellCapacity>
+void particles(Window& window,
+               const ParticleSystem<Particle_t, CellCapacity>& system,
+               const ParticleStyle& style = {})
+{
+    particles(window, system, style, window.view);
+}
+} // namespace sm::draw
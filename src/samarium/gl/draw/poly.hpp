@@ -24,6 +24,25 @@ void polyline(Window& window,
               const glm::mat4& transform);
 void polyline(Window& window, std::span<const Vector2f> points, Color color, f32 thickness);
 
+/**
+ * @brief               Draw many polylines with one upload and one draw call
+ *
+ * @param  points       The points of every line, one line after another
+ * @param  offsets      Line i is points[offsets[i]] up to points[offsets[i + 1]], so there is one
+ * more offset than there are lines
+ */
+void polylines(Window& window,
+               std::span<const Vector2f> points,
+               std::span<const u32> offsets,
+               Color color,
+               f32 thickness,
+               const glm::mat4& transform);
+void polylines(Window& window,
+               std::span<const Vector2f> points,
+               std::span<const u32> offsets,
+               Color color,
+               f32 thickness);
+
 void polygon(Window& window,
              std::span<const Vector2f> points,
              ShapeColor color,
@@ -40,31 +59,116 @@ void regular_polygon(Window& window, Circle border_circle, u32 point_count, Shap
 
 #if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_DRAW_IMPL)
 
+#include <array>  // for to_array
+#include <vector> // for vector
+
+#include "fmt/format.h"      // for format
+#include "glm/geometric.hpp" // for normalize, dot
+#include "glm/matrix.hpp"    // for inverse
+
 #include "samarium/core/inline.hpp"
 #include "samarium/gl/draw/poly.hpp"
 #include "samarium/math/vector_math.hpp"
+#include "samarium/util/Error.hpp" // for Error
 
 namespace sm::draw
 {
+namespace detail
+{
+// queue the outline of a closed polygon as the triangles polyline.vert.glsl would make for it,
+// mapped back to world space so it can share a run with the fills
+SM_INLINE void batch_border(Window& window,
+                            std::span<const Vector2f> points,
+                            Color color,
+                            f32 thickness,
+                            const glm::mat4& transform)
+{
+    const auto count       = points.size();
+    const auto screen_dims = glm::vec2{static_cast<f32>(window.dims.x),
+                                       static_cast<f32>(window.dims.y)};
+    const auto inverse     = glm::inverse(transform);
+
+    auto screen = std::vector<glm::vec2>(count);
+    for (auto i : loop::end(count))
+    {
+        const auto pos = transform * glm::vec4{points[i].x, points[i].y, 0.0F, 1.0F};
+        screen[i]      = (glm::vec2{pos} + 1.0F) * 0.5F * screen_dims;
+    }
+
+    const auto to_world = [&](glm::vec2 pos)
+    {
+        const auto world = inverse * glm::vec4{pos / screen_dims * 2.0F - 1.0F, 0.0F, 1.0F};
+        return Vector2f{world.x, world.y};
+    };
+
+    const auto miter = [](glm::vec2 normal, glm::vec2 direction)
+    {
+        const auto vector = glm::normalize(normal + glm::vec2{-direction.y, direction.x});
+        return vector / glm::dot(vector, normal);
+    };
+
+    auto verts = window.context.shape_batch.triangles(transform, 6 * count);
+    for (auto i : loop::end(count))
+    {
+        const auto previous = screen[(i + count - 1) % count];
+        const auto first    = screen[i];
+        const auto last     = screen[(i + 1) % count];
+        const auto next     = screen[(i + 2) % count];
+
+        const auto direction = glm::normalize(last - first);
+        const auto normal    = glm::vec2{-direction.y, direction.x};
+        const auto offset_first =
+            miter(normal, glm::normalize(first - previous)) * thickness * 0.5F;
+        const auto offset_last = miter(normal, glm::normalize(next - last)) * thickness * 0.5F;
+
+        const auto corners = std::to_array<glm::vec2>(
+            {first + offset_first, first - offset_first, last - offset_last, first + offset_first,
+             last - offset_last, last + offset_last});
+        for (auto j : loop::end(corners.size()))
+        {
+            verts[6 * i + j] = {to_world(corners[j]), color};
+        }
+    }
+}
+} // namespace detail
+
+// draw the lines in the storage buffer bound to 0, a ring of capacity points, as split by offsets.
+// The caller flushes the batch before binding it
 SM_INLINE void polyline_impl(Window& window,
-                             std::span<const Vector2f> points,
+                             std::span<const u32> offsets,
+                             u32 capacity,
                              Color color,
                              f32 thickness,
                              const glm::mat4& transform)
 {
-    const auto& shader = window.context.shaders.at("polyline");
-    shader.bind();
+    // lines without a segment are left out, as Mesa drops a multi-draw whose first draw is empty,
+    // so the shader is given the ends of each line drawn rather than offsets
+    auto lines  = std::vector<Vector2_t<u32>>{};
+    auto firsts = std::vector<i32>{};
+    auto counts = std::vector<i32>{};
+    for (auto i : loop::end(offsets.size() - 1))
+    {
+        if (offsets[i + 1] < offsets[i] + 2) { continue; }
+        lines.push_back({offsets[i], offsets[i + 1] - 1});
+        // 6 vertices for each segment, numbered so the shader can tell which points they join
+        firsts.push_back(6 * static_cast<i32>(offsets[i]));
+        counts.push_back(6 * static_cast<i32>(offsets[i + 1] - offsets[i] - 1));
+    }
+    if (lines.empty()) { return; }
+
+    const auto& shader = window.context.shader("polyline");
+    window.context.set_active(shader);
     shader.set("thickness", thickness);
     shader.set("screen_dims", window.dims.cast<f64>());
+    shader.set("capacity", static_cast<i32>(capacity));
 
     shader.set("view", transform);
     shader.set("color", color);
 
-    const auto& buffer = window.context.shader_storage_buffers.at("default");
-    buffer.set_data(points);
-    buffer.bind();
-    window.context.vertex_arrays.at("empty").bind();
-    glDrawArrays(GL_TRIANGLES, 0, 6 * (static_cast<i32>(points.size()) - 3));
+    window.context.stream_buffer.upload(lines).bind(1);
+    window.context.set_active(window.context.vertex_arrays.at("empty"));
+    glMultiDrawArrays(GL_TRIANGLES, firsts.data(), counts.data(),
+                      static_cast<i32>(lines.size()));
 }
 
 SM_INLINE void polyline(Window& window,
@@ -73,11 +177,8 @@ SM_INLINE void polyline(Window& window,
                         f32 thickness,
                         const glm::mat4& transform)
 {
-    auto new_points = std::vector<Vector2f>{points.begin(), points.end()};
-    new_points.insert(new_points.begin(), 2.0F * new_points[0] - new_points[1]);
-    const auto last = points.back();
-    new_points.push_back(2.0F * last - new_points[new_points.size() - 2]);
-    polyline_impl(window, {new_points}, color, thickness, transform);
+    const auto offsets = std::to_array<u32>({0, static_cast<u32>(points.size())});
+    polylines(window, points, offsets, color, thickness, transform);
 }
 
 SM_INLINE void
@@ -86,36 +187,58 @@ polyline(Window& window, std::span<const Vector2f> points, Color color, f32 thic
     polyline(window, points, color, thickness, window.view);
 }
 
+SM_INLINE void polylines(Window& window,
+                         std::span<const Vector2f> points,
+                         std::span<const u32> offsets,
+                         Color color,
+                         f32 thickness,
+                         const glm::mat4& transform)
+{
+    if (offsets.size() < 2 || points.size() < 2) { return; }
+    if (offsets.back() > points.size())
+    {
+        throw Error{fmt::format("draw::polylines: offsets go up to {}, but there are {} points",
+                                offsets.back(), points.size())};
+    }
+
+    window.context.flush();
+    // polyline.vert.glsl extends the ends itself, so the points go up as they are
+    window.context.stream_buffer.upload(points).bind();
+    polyline_impl(window, offsets, static_cast<u32>(points.size()), color, thickness, transform);
+}
+
+SM_INLINE void polylines(Window& window,
+                         std::span<const Vector2f> points,
+                         std::span<const u32> offsets,
+                         Color color,
+                         f32 thickness)
+{
+    polylines(window, points, offsets, color, thickness, window.view);
+}
+
 SM_INLINE void polygon(Window& window,
                        std::span<const Vector2f> points,
                        ShapeColor color,
                        const glm::mat4& transform)
 {
+    if (points.size() < 3) { return; }
+
+    // as a triangle fan
     if (color.fill_color.a != 0)
     {
-        const auto& shader = window.context.shaders.at("Pos");
-        window.context.set_active(shader);
-        shader.set("view", transform);
-        shader.set("color", color.fill_color);
-
-        const auto& buffer = window.context.vertex_buffers.at("default");
-
-        auto& vao = window.context.vertex_arrays.at("Pos");
-        window.context.set_active(vao);
-        buffer.set_data(points);
-        vao.bind(buffer, sizeof(Vector2_t<f32>));
-
-        glDrawArrays(GL_TRIANGLE_FAN, 0, static_cast<i32>(points.size()));
+        auto verts = window.context.shape_batch.triangles(transform, 3 * (points.size() - 2));
+        for (auto i : loop::end(points.size() - 2))
+        {
+            verts[3 * i]     = {points[0], color.fill_color};
+            verts[3 * i + 1] = {points[i + 1], color.fill_color};
+            verts[3 * i + 2] = {points[i + 2], color.fill_color};
+        }
     }
 
     if (color.border_color.a != 0 && color.border_width != 0.0)
     {
-        auto new_points = std::vector<Vector2f>{points.begin(), points.end()};
-        new_points.insert(new_points.begin(), new_points.back());
-        new_points.push_back(new_points[1]);
-        new_points.push_back(new_points[2]);
-        polyline_impl(window, {new_points}, color.border_color,
-                      static_cast<f32>(color.border_width), transform);
+        detail::batch_border(window, points, color.border_color,
+                             static_cast<f32>(color.border_width), transform);
     }
 }
 
@@ -130,6 +253,18 @@ SM_INLINE void regular_polygon(Window& window,
                                ShapeColor color,
                                const glm::mat4& transform)
 {
+    if (color.border_color.a == 0 || color.border_width == 0.0)
+    {
+        if (color.fill_color.a != 0)
+        {
+            window.context.shape_batch.regular_polygon(
+                transform, point_count,
+                {border_circle.centre.cast<f32>(), static_cast<f32>(border_circle.radius),
+                 color.fill_color});
+        }
+        return;
+    }
+
     const auto points = math::regular_polygon_points<f32>(point_count, border_circle);
     polygon(window, {points.begin(), point_count}, color, transform);
 }
@@ -7,13 +7,39 @@
 
 #pragma once
 
+#include "samarium/gl/Buffer.hpp"        // for ShaderStorageBuffer
 #include "samarium/graphics/Trail.hpp"   // for Trail
 #include "samarium/gui/Window.hpp"       // for Window
 #include "samarium/util/FunctionRef.hpp" // for FunctionRef
 
 namespace sm::draw
 {
+/**
+ * @brief A Trail kept on the GPU between frames, so drawing it only uploads the points pushed
+ * since it was last drawn
+ *
+ * @details The buffer is a ring of the same length as the Trail, which polyline.vert.glsl reads
+ * around the wrap, so old points never move. Use one per Trail:
+ * @code
+ * auto trail  = Trail{500};
+ * auto buffer = draw::TrailBuffer{};
+ * // every frame:
+ * trail.push_back(pos);
+ * draw::trail(window, trail, buffer, "#ff8800"_c, 0.1F);
+ * @endcode
+ */
+struct TrailBuffer
+{
+    gl::ShaderStorageBuffer buffer{};
+    u64 capacity{}; ///< The max_length of the Trail it holds
+    u64 uploaded{}; ///< The Trail's push_count() when it was last updated
+
+    /// Copy in the points of trail pushed since the last update, through context's stream buffer
+    void update(gl::Context& context, const Trail& trail);
+};
+
 void trail(Window& window, const Trail& trail, Color color, f32 thickness);
+void trail(Window& window, const Trail& trail, TrailBuffer& buffer, Color color, f32 thickness);
 void trail(Window& window,
            const Trail& trail,
            FunctionRef<Color(f64)> dynamic_color,
@@ -23,21 +49,82 @@ void trail(Window& window,
 
 #if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_DRAW_IMPL)
 
+#include <algorithm> // for min
+#include <array>     // for to_array
+#include <vector>    // for vector
+
 #include "samarium/gl/draw/poly.hpp"
 #include "samarium/gl/draw/trail.hpp"
+#include "samarium/math/loop.hpp" // for end
 
 namespace sm::draw
 {
+SM_INLINE void TrailBuffer::update(gl::Context& context, const Trail& trail)
+{
+    if (trail.max_length == 0) { return; } // never holds a point, and has no slot to wrap to
+
+    if (capacity != trail.max_length || uploaded > trail.push_count())
+    {
+        // a different trail, start over
+        buffer   = gl::ShaderStorageBuffer{};
+        capacity = trail.max_length;
+        uploaded = trail.push_count() - trail.size();
+        glNamedBufferStorage(buffer.handle, static_cast<i64>(capacity * sizeof(Vector2f)),
+                             nullptr, 0);
+    }
+
+    const auto new_count = std::min(trail.push_count() - uploaded, trail.size());
+    if (new_count == 0) { return; }
+
+    const auto points = trail.span().last(new_count);
+    auto converted    = std::vector<Vector2f>(new_count);
+    for (auto i : loop::end(new_count)) { converted[i] = points[i].cast<f32>(); }
+
+    // copied on the GPU, as writing to a buffer earlier draws still read from would wait for them
+    const auto source = context.stream_buffer.upload(converted);
+
+    // the point pushed n-th lives at n % capacity, as in the Trail, so at most two copies
+    const auto slot       = (trail.push_count() - new_count) % capacity;
+    const auto first_part =
+        static_cast<i64>(std::min(new_count, capacity - slot) * sizeof(Vector2f));
+    glCopyNamedBufferSubData(source.handle, buffer.handle, source.offset,
+                             static_cast<i64>(slot * sizeof(Vector2f)), first_part);
+    if (first_part != source.size)
+    {
+        glCopyNamedBufferSubData(source.handle, buffer.handle, source.offset + first_part, 0,
+                                 source.size - first_part);
+    }
+
+    uploaded = trail.push_count();
+}
+
 SM_INLINE void trail(Window& window, const Trail& trail, Color color, f32 thickness)
 {
     if (trail.size() < 2) { return; }
-    const auto points = trail.trail |
-                        ranges::views::transform([](Vector2 vec) { return vec.cast<f32>(); }) |
-                        ranges::to<std::vector>;
 
+    auto points = std::vector<Vector2f>(trail.size());
+    for (auto i : loop::end(trail.size())) { points[i] = trail[i].cast<f32>(); }
     polyline(window, points, color, thickness);
 }
 
+SM_INLINE void
+trail(Window& window, const Trail& trail, TrailBuffer& buffer, Color color, f32 thickness)
+{
+    if (trail.size() < 2) { return; }
+
+    window.context.flush();
+    buffer.update(window.context, trail);
+    buffer.buffer.bind();
+
+    // the oldest point is in the slot the next one will go in, once the trail is full
+    const auto first =
+        trail.size() < trail.max_length ? u64{} : trail.push_count() % buffer.capacity;
+    const auto offsets = std::to_array<u32>(
+        {static_cast<u32>(first), static_cast<u32>(first + trail.size())});
+    polyline_impl(window, offsets, static_cast<u32>(buffer.capacity), color, thickness,
+                  window.view);
+}
+
 // SM_INLINE void
 // trail(Window& window, const Trail& trail, FunctionRef<Color(f64)> dynamic_color, f32 thickness)
 // {
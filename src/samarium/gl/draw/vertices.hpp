@@ -60,7 +60,9 @@ SM_INLINE void vertices(gl::Context& context,
                         gl::Primitive primitive,
                         const glm::mat4& transform)
 {
-    const auto& shader = context.shaders.at("Pos");
+    context.flush();
+
+    const auto& shader = context.shader("Pos");
     context.set_active(shader);
     shader.set("view", transform);
     shader.set("color", color);
@@ -68,9 +70,7 @@ SM_INLINE void vertices(gl::Context& context,
     auto& vao = context.vertex_arrays.at("Pos");
     context.set_active(vao);
 
-    const auto& buffer = context.vertex_buffers.at("default");
-    buffer.set_data(verts);
-    vao.bind(buffer, sizeof(verts[0]));
+    vao.bind(context.stream_buffer.upload(verts), sizeof(verts[0]));
 
     glDrawArrays(static_cast<i32>(primitive), 0, static_cast<i32>(verts.size()));
 }
@@ -89,7 +89,9 @@ SM_INLINE void vertices(gl::Context& context,
                         gl::Primitive primitive,
                         const glm::mat4& transform)
 {
-    const auto& shader = context.shaders.at("Pos");
+    context.flush();
+
+    const auto& shader = context.shader("Pos");
     context.set_active(shader);
     shader.set("view", transform);
     shader.set("color", color);
@@ -97,9 +99,7 @@ SM_INLINE void vertices(gl::Context& context,
     auto& vao = context.vertex_arrays.at("Pos");
     context.set_active(vao);
 
-    const auto& buffer = context.vertex_buffers.at("default");
-    buffer.set_data(verts);
-    vao.bind(buffer, sizeof(verts[0]));
+    vao.bind(context.stream_buffer.upload(verts), sizeof(verts[0]));
 
     glDrawArrays(static_cast<i32>(primitive), 0, static_cast<i32>(verts.size()));
 }
@@ -115,16 +115,16 @@ SM_INLINE void vertices(gl::Context& context,
                         gl::Primitive primitive,
                         const glm::mat4& transform)
 {
-    const auto& shader = context.shaders.at("PosColor");
+    context.flush();
+
+    const auto& shader = context.shader("PosColor");
     context.set_active(shader);
     shader.set("view", transform);
 
     auto& vao = context.vertex_arrays.at("PosColor");
     context.set_active(vao);
 
-    const auto& buffer = context.vertex_buffers.at("default");
-    buffer.set_data(verts);
-    vao.bind(buffer, sizeof(verts[0]));
+    vao.bind(context.stream_buffer.upload(verts), sizeof(verts[0]));
 
     glDrawArrays(static_cast<i32>(primitive), 0, static_cast<i32>(verts.size()));
 }
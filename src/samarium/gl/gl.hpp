@@ -24,6 +24,13 @@ namespace sm::gl
 inline constexpr auto version_major = 4;
 inline constexpr auto version_minor = 6;
 
+/// Everything used is core in 4.5, which is as far as Mesa's llvmpipe goes, so headless contexts
+/// fall back to it
+inline constexpr auto min_version_minor = 5;
+
+/// Prepended to every shader
+inline constexpr auto glsl_version = "#version 450 core\n";
+
 static constexpr auto unit_square =
     std::to_array<Vector2f>({{-1.0F, -1.0F}, {-1.0F, 1.0F}, {1.0F, 1.0F}, {1.0F, -1.0F}});
 
@@ -71,6 +78,7 @@ enum class Primitive
 enum class ImageFormat
 {
     RGBA8   = GL_RGBA8,
+    R8      = GL_R8,
     R32F    = GL_R32F,
     RG32F   = GL_RG32F,
     RGB32F  = GL_RGB32F,
@@ -92,6 +100,10 @@ struct FormatAndType
             format = GL_RGBA;
             type   = GL_UNSIGNED_BYTE;
             break;
+        case R8:
+            format = GL_RED;
+            type   = GL_UNSIGNED_BYTE;
+            break;
         case R32F:
             format = GL_RED;
             type   = GL_FLOAT;
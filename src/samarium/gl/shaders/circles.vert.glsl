@@ -0,0 +1,25 @@
+R"glsl(
+struct RegularPolygon
+{
+    vec2 centre;
+    float radius;
+    uint color;
+};
+
+layout(std430, binding = 3) buffer ssbo { RegularPolygon polygons[]; };
+
+uniform mat4 view;
+uniform int point_count;
+uniform int first;
+
+out vec4 vertex_color;
+
+void main()
+{
+    RegularPolygon polygon = polygons[first + gl_InstanceID];
+    float angle            = 6.28318530718 * float(gl_VertexID) / float(point_count);
+    vec2 pos               = polygon.centre + polygon.radius * vec2(cos(angle), sin(angle));
+    gl_Position            = view * vec4(pos, 0.0, 1.0);
+    vertex_color           = unpackUnorm4x8(polygon.color);
+}
+)glsl"
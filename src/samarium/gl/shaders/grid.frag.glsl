@@ -0,0 +1,43 @@
+R"glsl(
+in vec2 world_position;
+
+uniform float spacing;
+uniform vec4 color;
+uniform float thickness; // width of lines, or radius of dots
+uniform int point_count; // sides of the dots, 0 for lines
+
+out vec4 frag_color;
+
+const float tau = 6.28318530718;
+
+float lines_coverage(vec2 offset, vec2 pixel)
+{
+    // lines thinner than a pixel are drawn a pixel wide and fainter, so they don't flicker
+    vec2 width    = max(vec2(thickness), pixel);
+    vec2 coverage = clamp((width / 2.0 - abs(offset)) / pixel + 0.5, 0.0, 1.0);
+    coverage *= thickness / width;
+    return max(coverage.x, coverage.y);
+}
+
+float dots_coverage(vec2 offset, vec2 pixel)
+{
+    // signed distance to the edge of a regular polygon with a corner on the x axis, as
+    // draw::regular_polygon makes them
+    float sector   = tau / float(point_count);
+    float angle    = mod(atan(offset.y, offset.x), sector) - sector / 2.0;
+    float distance = length(offset) * cos(angle) - thickness * cos(sector / 2.0);
+    float size     = length(pixel) / sqrt(2.0);
+    return clamp(0.5 - distance / size, 0.0, 1.0);
+}
+
+void main()
+{
+    // offset from the nearest grid point, and the size of this pixel in world space
+    vec2 offset = (fract(world_position / spacing + 0.5) - 0.5) * spacing;
+    vec2 pixel  = fwidth(world_position);
+
+    float coverage =
+        point_count == 0 ? lines_coverage(offset, pixel) : dots_coverage(offset, pixel);
+    frag_color = vec4(color.rgb, color.a * coverage);
+}
+)glsl"
@@ -0,0 +1,13 @@
+R"glsl(
+uniform mat4 inverse_view;
+
+out vec2 world_position;
+
+void main()
+{
+    // one triangle covering the screen, its corners made from the vertex index
+    vec2 position  = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position    = vec4(position, 0.0, 1.0);
+    world_position = (inverse_view * vec4(position, 0.0, 1.0)).xy;
+}
+)glsl"
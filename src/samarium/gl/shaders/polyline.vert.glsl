@@ -1,19 +1,55 @@
 R"glsl(
+#extension GL_ARB_shader_draw_parameters : enable
+
 layout(std430, binding = 0) buffer ssbo { vec2 vertices[]; };
+// the first and last point of each line drawn, whose vertices start at 6 * first
+layout(std430, binding = 1) buffer lines_ssbo { uvec2 lines[]; };
 
 uniform mat4 view;
 uniform vec2 screen_dims;
 uniform float thickness;
+uniform int capacity; // vertices is a ring of this many points
+
+uvec2 line_of(int point_index)
+{
+#ifdef GL_ARB_shader_draw_parameters
+    return lines[gl_DrawIDARB];
+#else
+    // the last line starting at or before point_index
+    int low  = 0;
+    int high = lines.length();
+    while (high - low > 1)
+    {
+        int middle = (low + high) / 2;
+        if (int(lines[middle].x) <= point_index) { low = middle; }
+        else { high = middle; }
+    }
+    return lines[low];
+#endif
+}
+
+vec2 stored_point(int index) { return vertices[index % capacity]; }
+
+vec2 point(int index, int first, int last)
+{
+    // past either end, carry on straight so the end is cut square
+    if (index < first) { return 2.0 * stored_point(first) - stored_point(first + 1); }
+    if (index > last) { return 2.0 * stored_point(last) - stored_point(last - 1); }
+    return stored_point(index);
+}
 
 void main()
 {
-    int line_index = gl_VertexID / 6;
-    int tri_index  = gl_VertexID % 6;
+    int segment   = gl_VertexID / 6;
+    int tri_index = gl_VertexID % 6;
+    uvec2 line    = line_of(segment);
+    int first     = int(line.x);
+    int last      = int(line.y);
 
     vec4 va[4];
     for (int i = 0; i < 4; ++i)
     {
-        vec4 pos = view * vec4(vertices[line_index + i], 0.0, 1.0);
+        vec4 pos = view * vec4(point(segment + i - 1, first, last), 0.0, 1.0);
         pos.xy   = (pos.xy + 1.0) * 0.5 * screen_dims;
         va[i]    = pos;
     }
@@ -1,14 +1,13 @@
 R"glsl(
-in vec2 tex_coord;
-
-uniform sampler2D input_texture;
-uniform vec4 color;
+in vec4 vertex_color;
+in vec2 tex_coord; // in pixels, so glyphs keep their place when the atlas grows
+layout(binding = 0) uniform sampler2D input_texture;
 
 out vec4 frag_color;
 
 void main()
 {
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(input_texture, tex_coord).r);
-    frag_color        = color * sampled;
+    float coverage = texture(input_texture, tex_coord / vec2(textureSize(input_texture, 0))).r;
+    frag_color     = vec4(vertex_color.rgb, vertex_color.a * coverage);
 }
 )glsl"
@@ -9,7 +9,11 @@
 
 #include "samarium/graphics/Color.hpp"
 #include "samarium/graphics/Gradient.hpp"
+#include "samarium/graphics/GradientLUT.hpp"
+#include "samarium/graphics/blend.hpp"
 #include "samarium/graphics/Trail.hpp"
+#include "samarium/graphics/filter.hpp"
+#include "samarium/graphics/swizzle.hpp"
 #include "samarium/util/Grid.hpp"
 // #include "samarium/graphics/colors.hpp"
 // #include "samarium/graphics/gradients.hpp"
@@ -0,0 +1,169 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <algorithm> // for min, max
+#include <array>     // for array
+
+#if defined(__AVX2__)
+#include <immintrin.h> // for _mm256_i32gather_epi32, _mm256_cvttpd_epi32
+#endif
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/types.hpp"      // for u64, f64
+#include "samarium/math/Extents.hpp"    // for Extents
+#include "samarium/math/loop.hpp"       // for start_end
+#include "samarium/util/Error.hpp"      // for Error
+#include "samarium/util/Grid.hpp"       // for ScalarField, Image
+#include "samarium/util/ThreadPool.hpp" // for ThreadPool, parallelize_loop
+
+#include "Color.hpp"     // for Color
+#include "Gradient.hpp"  // for Gradient
+#include "gradients.hpp" // for magma, viridis...
+
+namespace sm
+{
+/**
+ * @brief               A Gradient baked into Size evenly spaced colors, so that looking up a color
+ * is a multiply, a clamp and a load
+ *
+ * @tparam Size         Number of entries, eg 256, 1024 or 4096
+ */
+template <u64 Size = 256> struct GradientLUT
+{
+    static_assert(Size >= 2, "sm::GradientLUT: needs at least 2 entries");
+
+    static constexpr auto size = Size;
+
+    std::array<Color, Size> colors{};
+
+    template <u64 GradientSize>
+    constexpr explicit GradientLUT(const Gradient<GradientSize>& gradient)
+    {
+        for (auto i : loop::end(Size))
+        {
+            colors[i] = sample(gradient, static_cast<f64>(i) / static_cast<f64>(Size - 1));
+        }
+    }
+
+    /**
+     * @brief               Nearest entry to factor, which is clamped to [0, 1]
+     */
+    [[nodiscard]] constexpr auto operator()(f64 factor) const noexcept -> Color
+    {
+        return colors[index(factor * static_cast<f64>(Size - 1))];
+    }
+
+    /**
+     * @brief               Entry for a factor already scaled to [0, Size - 1], clamped
+     */
+    [[nodiscard]] static constexpr auto index(f64 scaled) noexcept -> u64
+    {
+        // written so that NaN maps to 0
+        const auto clamped = std::min(std::max(0.0, scaled), static_cast<f64>(Size - 1));
+        return static_cast<u64>(clamped + 0.5);
+    }
+
+  private:
+    template <u64 GradientSize>
+    [[nodiscard]] static constexpr auto sample(const Gradient<GradientSize>& gradient, f64 factor)
+    {
+        if constexpr (GradientSize == 1) { return gradient.colors[0]; }
+        else
+        {
+            const auto mapped = factor * static_cast<f64>(GradientSize - 1);
+            const auto lower  = std::min(static_cast<u64>(mapped), GradientSize - 2);
+            const auto t      = mapped - static_cast<f64>(lower);
+            const auto from   = gradient.colors[lower];
+            const auto to     = gradient.colors[lower + 1];
+
+            const auto channel = [t](u8 a, u8 b)
+            {
+                return static_cast<u8>(static_cast<f64>(a) +
+                                       (static_cast<f64>(b) - static_cast<f64>(a)) * t + 0.5);
+            };
+            return Color{channel(from.r, to.r), channel(from.g, to.g), channel(from.b, to.b),
+                         channel(from.a, to.a)};
+        }
+    }
+};
+
+template <u64 GradientSize> GradientLUT(const Gradient<GradientSize>&) -> GradientLUT<256>;
+
+namespace gradients::lut
+{
+constexpr inline auto blue       = GradientLUT{gradients::blue};
+constexpr inline auto purple     = GradientLUT{gradients::purple};
+constexpr inline auto blue_green = GradientLUT{gradients::blue_green};
+constexpr inline auto horizon    = GradientLUT{gradients::horizon};
+constexpr inline auto heat       = GradientLUT{gradients::heat};
+constexpr inline auto rainbow    = GradientLUT{gradients::rainbow};
+constexpr inline auto magma      = GradientLUT{gradients::magma};
+constexpr inline auto viridis    = GradientLUT{gradients::viridis};
+} // namespace gradients::lut
+
+/**
+ * @brief               Color every value of a ScalarField with a GradientLUT
+ *
+ * @param  field
+ * @param  lut
+ * @param  image        Same dimensions as field
+ * @param  thread_pool  Pool to split the work over, or nullptr to run serially
+ * @param  range        Values mapped to the first and last colors, values outside are clamped
+ */
+template <u64 Size>
+void colormap(const ScalarField& field,
+              const GradientLUT<Size>& lut,
+              Image& image,
+              ThreadPool* thread_pool = nullptr,
+              Extents<f64> range      = {0.0, 1.0})
+{
+    if (field.dims != image.dims)
+    {
+        throw Error{fmt::format("colormap: field is {}x{} but image is {}x{}", field.dims.x,
+                                field.dims.y, image.dims.x, image.dims.y)};
+    }
+
+    const auto scale  = static_cast<f64>(Size - 1) / (range.max - range.min);
+    const auto offset = -range.min * scale;
+
+    parallelize_loop(
+        thread_pool, field.size(),
+        [&](u64 min, u64 max)
+        {
+            const auto* in = field.data();
+            auto* out      = image.data();
+            auto i         = min;
+
+#if defined(__AVX2__)
+            // 4 values at a time: scale, clamp (max first so NaN becomes 0), truncate, gather
+            const auto scale_4  = _mm256_set1_pd(scale);
+            const auto offset_4 = _mm256_set1_pd(offset + 0.5);
+            const auto upper_4  = _mm256_set1_pd(static_cast<f64>(Size - 1));
+            const auto* table   = reinterpret_cast<const int*>(lut.colors.data());
+
+            for (; i + 4 <= max; i += 4)
+            {
+                const auto scaled =
+                    _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(in + i), scale_4), offset_4);
+                const auto clamped =
+                    _mm256_min_pd(_mm256_max_pd(scaled, _mm256_setzero_pd()), upper_4);
+                const auto indices = _mm256_cvttpd_epi32(clamped);
+                const auto colors  = _mm_i32gather_epi32(table, indices, 4);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), colors);
+            }
+#endif
+
+            for (; i < max; i++)
+            {
+                out[i] = lut.colors[GradientLUT<Size>::index(in[i] * scale + offset)];
+            }
+        });
+}
+} // namespace sm
@@ -10,59 +10,89 @@
 #include <span>   // for span
 #include <vector> // for vector
 
-#include "range/v3/algorithm/rotate.hpp" // for rotate, rotate_fn
-
-#include "samarium/core/types.hpp"   // for u64
+#include "samarium/core/types.hpp"   // for u64, i64
 #include "samarium/math/Vector2.hpp" // for Vector2
 
 namespace sm
 {
+/**
+ * @brief The last max_length positions of something, oldest first
+ *
+ * @details A ring buffer, so push_back() is O(1) however long the trail. Once the trail is full,
+ * every point is stored twice, max_length apart, so the points are still one contiguous span.
+ * Until then they are stored once, so a trail that never fills never takes twice the memory
+ */
 struct Trail
 {
-    std::vector<Vector2> trail;
+    std::vector<Vector2> points{}; ///< The ring twice over once full, read it through span()
     u64 max_length;
 
-    explicit Trail(u64 length = 50) : max_length{length} { trail.reserve(length); }
+    explicit Trail(u64 length = 50) : max_length{length} {}
 
-    [[nodiscard]] auto begin() noexcept { return trail.begin(); }
-    [[nodiscard]] auto end() noexcept { return trail.end(); }
+    [[nodiscard]] auto begin() const noexcept { return span().begin(); }
+    [[nodiscard]] auto end() const noexcept { return span().end(); }
 
-    [[nodiscard]] auto begin() const noexcept { return trail.cbegin(); }
-    [[nodiscard]] auto end() const noexcept { return trail.cend(); }
+    [[nodiscard]] auto cbegin() const noexcept { return span().begin(); }
+    [[nodiscard]] auto cend() const noexcept { return span().end(); }
 
-    [[nodiscard]] auto cbegin() const noexcept { return trail.cbegin(); }
-    [[nodiscard]] auto cend() const noexcept { return trail.cend(); }
+    [[nodiscard]] auto size() const noexcept { return pushed < max_length ? pushed : max_length; }
+    [[nodiscard]] auto empty() const noexcept { return pushed == 0; }
 
-    [[nodiscard]] auto size() const noexcept { return trail.size(); }
-    [[nodiscard]] auto empty() const noexcept { return trail.empty(); }
-
-    auto operator[](u64 index) noexcept { return trail[index]; }
-    auto operator[](u64 index) const noexcept { return trail[index]; }
+    auto operator[](u64 index) const noexcept { return points[first() + index]; }
 
     void push_back(Vector2 pos);
 
     [[nodiscard]] auto span() const -> std::span<const Vector2>;
+
+    /// Every point ever pushed, so renderers can tell which points are new since they last looked
+    [[nodiscard]] auto push_count() const noexcept { return pushed; }
+
+  private:
+    u64 pushed{};
+
+    // index in points of the oldest point
+    [[nodiscard]] auto first() const noexcept -> u64
+    {
+        return pushed <= max_length ? 0 : pushed % max_length; // <= so that Trail{0} is valid
+    }
 };
 } // namespace sm
 
 #if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_TRAIL_IMPL)
 
-#include <utility> // for move
+#include <algorithm> // for copy_n
 
-#include "range/v3/algorithm/rotate.hpp" // for rotate
+#include "samarium/core/inline.hpp" // for SM_INLINE
 
 namespace sm
 {
-void Trail::push_back(Vector2 pos)
+SM_INLINE void Trail::push_back(Vector2 pos)
 {
-    if (this->max_length > this->trail.size()) { this->trail.push_back(pos); }
-    else
+    if (max_length == 0) { return; }
+
+    if (pushed < max_length)
+    {
+        points.push_back(pos);
+        pushed++;
+        return;
+    }
+
+    if (points.size() != 2 * max_length) // full for the first time, so mirror the ring
     {
-        ranges::rotate(this->trail, this->trail.begin() + 1);
-        this->trail.back() = pos;
+        points.resize(2 * max_length);
+        std::copy_n(points.begin(), max_length, points.begin() + static_cast<i64>(max_length));
     }
+
+    // the slot of the oldest point, which this replaces once the trail is full
+    const auto slot           = pushed % max_length;
+    points[slot]              = pos;
+    points[slot + max_length] = pos;
+    pushed++;
 }
 
-auto Trail::span() const -> std::span<const Vector2> { return {this->trail}; }
+SM_INLINE auto Trail::span() const -> std::span<const Vector2>
+{
+    return std::span{points}.subspan(first(), size());
+}
 } // namespace sm
 #endif
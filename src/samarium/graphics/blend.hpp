@@ -0,0 +1,349 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <span> // for span
+
+#include "samarium/core/types.hpp"      // for u8, u32, i16
+#include "samarium/util/Grid.hpp"       // for Image
+#include "samarium/util/ThreadPool.hpp" // for ThreadPool
+
+#include "Color.hpp" // for Color
+
+namespace sm
+{
+/**
+ * @brief Ways of compositing a source layer onto a destination
+ *
+ * Straight alpha modes weight the blended color by the source alpha and composite alpha like
+ * Over. Premultiplied modes expect colors already multiplied by their alpha, see premultiply()
+ */
+enum class BlendMode
+{
+    Over,              ///< Source on top, like Color::add_alpha_over
+    Add,               ///< Destination plus source color times source alpha, saturated
+    Multiply,          ///< Darkens: destination times source
+    Screen,            ///< Lightens: inverse of multiplying the inverses
+    PremultipliedOver, ///< Source plus destination times (1 - source alpha)
+    PremultipliedAdd   ///< Source plus destination, saturated
+};
+
+/**
+ * @brief               Composite source onto destination, element by element. Uses 8 bit fixed
+ * point arithmetic, 8 pixels at a time with AVX2 or 4 with SSE2
+ *
+ * @param  destination
+ * @param  source       At least as long as destination
+ * @param  mode
+ */
+void blend(std::span<Color> destination, std::span<const Color> source, BlendMode mode);
+
+/**
+ * @brief               Composite an Image onto another of the same dimensions
+ *
+ * @param  destination
+ * @param  source
+ * @param  mode
+ * @param  thread_pool  Pool to split rows over, or nullptr to run serially
+ */
+void blend(Image& destination,
+           const Image& source,
+           BlendMode mode          = BlendMode::Over,
+           ThreadPool* thread_pool = nullptr);
+
+/**
+ * @brief               Multiply the color channels by alpha, for the premultiplied modes
+ */
+void premultiply(std::span<Color> colors);
+} // namespace sm
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_BLEND_IMPL)
+
+#include <algorithm> // for min
+
+#if defined(__AVX2__)
+#include <immintrin.h> // for _mm256_mullo_epi16, _mm256_unpacklo_epi8, _mm256_packus_epi16
+#elif defined(__SSE2__)
+#include <emmintrin.h> // for _mm_mullo_epi16, _mm_unpacklo_epi8, _mm_packus_epi16
+#endif
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/util/Error.hpp"  // for Error
+
+namespace sm
+{
+namespace detail
+{
+// x / 255 rounded to nearest, exact for x <= 255 * 255
+[[nodiscard]] constexpr auto div255(u32 x) noexcept -> u32
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+template <BlendMode mode> [[nodiscard]] constexpr auto blend_pixel(Color dst, Color src) noexcept
+{
+    const auto channel = [](u8 value) { return static_cast<u32>(value); };
+    const auto alpha   = channel(src.a);
+    const auto inverse = 255 - alpha;
+    const auto clamp   = [](u32 value) { return static_cast<u8>(std::min(value, 255U)); };
+
+    if constexpr (mode == BlendMode::PremultipliedOver)
+    {
+        const auto over = [&](u8 d, u8 s)
+        { return clamp(channel(s) + div255(channel(d) * inverse)); };
+        return Color{over(dst.r, src.r), over(dst.g, src.g), over(dst.b, src.b),
+                     over(dst.a, src.a)};
+    }
+    else if constexpr (mode == BlendMode::PremultipliedAdd)
+    {
+        const auto add = [&](u8 d, u8 s) { return clamp(channel(d) + channel(s)); };
+        return Color{add(dst.r, src.r), add(dst.g, src.g), add(dst.b, src.b), add(dst.a, src.a)};
+    }
+    else
+    {
+        const auto color = [&](u8 d_, u8 s_)
+        {
+            const auto d = channel(d_);
+            const auto s = channel(s_);
+            if constexpr (mode == BlendMode::Over) { return div255(s * alpha + d * inverse); }
+            else if constexpr (mode == BlendMode::Add)
+            {
+                return std::min(d + div255(s * alpha), 255U);
+            }
+            else if constexpr (mode == BlendMode::Multiply)
+            {
+                return div255(div255(s * d) * alpha + d * inverse);
+            }
+            else { return div255((s + d - div255(s * d)) * alpha + d * inverse); }
+        };
+
+        return Color{static_cast<u8>(color(dst.r, src.r)), static_cast<u8>(color(dst.g, src.g)),
+                     static_cast<u8>(color(dst.b, src.b)),
+                     static_cast<u8>(alpha + div255(channel(dst.a) * inverse))};
+    }
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+// the few integer ops the kernels need, at the widest width available
+namespace lanes
+{
+#if defined(__AVX2__)
+using Type                  = __m256i;
+constexpr inline auto width = u64{8}; // pixels per register
+
+[[nodiscard]] inline auto load(const Color* pointer) noexcept
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pointer));
+}
+inline void store(Color* pointer, Type value) noexcept
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pointer), value);
+}
+[[nodiscard]] inline auto set1(i16 value) noexcept { return _mm256_set1_epi16(value); }
+[[nodiscard]] inline auto zero() noexcept { return _mm256_setzero_si256(); }
+[[nodiscard]] inline auto widen_low(Type a) noexcept { return _mm256_unpacklo_epi8(a, zero()); }
+[[nodiscard]] inline auto widen_high(Type a) noexcept { return _mm256_unpackhi_epi8(a, zero()); }
+[[nodiscard]] inline auto narrow(Type low, Type high) noexcept
+{
+    return _mm256_packus_epi16(low, high);
+}
+[[nodiscard]] inline auto add_saturate(Type a, Type b) noexcept { return _mm256_adds_epu8(a, b); }
+[[nodiscard]] inline auto add(Type a, Type b) noexcept { return _mm256_add_epi16(a, b); }
+[[nodiscard]] inline auto sub(Type a, Type b) noexcept { return _mm256_sub_epi16(a, b); }
+[[nodiscard]] inline auto mul(Type a, Type b) noexcept { return _mm256_mullo_epi16(a, b); }
+[[nodiscard]] inline auto shift_right_8(Type a) noexcept { return _mm256_srli_epi16(a, 8); }
+[[nodiscard]] inline auto broadcast_alpha(Type a) noexcept
+{
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, 0xFF), 0xFF);
+}
+[[nodiscard]] inline auto alpha_mask() noexcept // the top 16 bits of each pixel
+{
+    return _mm256_set1_epi64x(static_cast<i64>(u64{0xFFFF'0000'0000'0000}));
+}
+[[nodiscard]] inline auto select(Type mask, Type a, Type b) noexcept
+{
+    return _mm256_blendv_epi8(b, a, mask);
+}
+[[nodiscard]] inline auto set_opaque(Type a) noexcept
+{
+    return _mm256_or_si256(a, _mm256_set1_epi64x(static_cast<i64>(u64{0x00FF'0000'0000'0000})));
+}
+#else
+using Type                  = __m128i;
+constexpr inline auto width = u64{4};
+
+[[nodiscard]] inline auto load(const Color* pointer) noexcept
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pointer));
+}
+inline void store(Color* pointer, Type value) noexcept
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pointer), value);
+}
+[[nodiscard]] inline auto set1(i16 value) noexcept { return _mm_set1_epi16(value); }
+[[nodiscard]] inline auto zero() noexcept { return _mm_setzero_si128(); }
+[[nodiscard]] inline auto widen_low(Type a) noexcept { return _mm_unpacklo_epi8(a, zero()); }
+[[nodiscard]] inline auto widen_high(Type a) noexcept { return _mm_unpackhi_epi8(a, zero()); }
+[[nodiscard]] inline auto narrow(Type low, Type high) noexcept
+{
+    return _mm_packus_epi16(low, high);
+}
+[[nodiscard]] inline auto add_saturate(Type a, Type b) noexcept { return _mm_adds_epu8(a, b); }
+[[nodiscard]] inline auto add(Type a, Type b) noexcept { return _mm_add_epi16(a, b); }
+[[nodiscard]] inline auto sub(Type a, Type b) noexcept { return _mm_sub_epi16(a, b); }
+[[nodiscard]] inline auto mul(Type a, Type b) noexcept { return _mm_mullo_epi16(a, b); }
+[[nodiscard]] inline auto shift_right_8(Type a) noexcept { return _mm_srli_epi16(a, 8); }
+[[nodiscard]] inline auto broadcast_alpha(Type a) noexcept
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xFF), 0xFF);
+}
+[[nodiscard]] inline auto alpha_mask() noexcept
+{
+    return _mm_set1_epi64x(static_cast<i64>(u64{0xFFFF'0000'0000'0000}));
+}
+[[nodiscard]] inline auto select(Type mask, Type a, Type b) noexcept
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+[[nodiscard]] inline auto set_opaque(Type a) noexcept
+{
+    return _mm_or_si128(a, _mm_set1_epi64x(static_cast<i64>(u64{0x00FF'0000'0000'0000})));
+}
+#endif
+
+// each 16 bit lane of x / 255, rounded, for lanes <= 255 * 255
+[[nodiscard]] inline auto div255(Type x) noexcept
+{
+    x = add(x, set1(128));
+    return shift_right_8(add(x, shift_right_8(x)));
+}
+} // namespace lanes
+
+// pixels widened to 16 bits per channel
+template <BlendMode mode>
+[[nodiscard]] inline auto blend_wide(lanes::Type dst, lanes::Type src) noexcept
+{
+    using namespace lanes;
+    const auto alpha   = broadcast_alpha(src);
+    const auto inverse = sub(set1(255), alpha);
+
+    if constexpr (mode == BlendMode::PremultipliedOver)
+    {
+        return add(src, div255(mul(dst, inverse))); // saturated by narrow
+    }
+    else if constexpr (mode == BlendMode::Add)
+    {
+        const auto color     = add(dst, div255(mul(src, alpha))); // saturated by narrow
+        const auto alpha_out = add(alpha, div255(mul(dst, inverse)));
+        return select(alpha_mask(), alpha_out, color);
+    }
+    else
+    {
+        // with 255 in the alpha lane of the blended color, blending it over dst by alpha also
+        // gives the composited alpha: alpha + dst.a * (255 - alpha) / 255
+        auto blended = src;
+        if constexpr (mode != BlendMode::Over)
+        {
+            const auto product = div255(mul(src, dst));
+            blended = mode == BlendMode::Multiply ? product : sub(add(src, dst), product);
+        }
+        return div255(add(mul(set_opaque(blended), alpha), mul(dst, inverse)));
+    }
+}
+#endif
+
+template <BlendMode mode>
+void blend_span(std::span<Color> destination, std::span<const Color> source) noexcept
+{
+    auto i = u64{};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + lanes::width <= destination.size(); i += lanes::width)
+    {
+        const auto d = lanes::load(destination.data() + i);
+        const auto s = lanes::load(source.data() + i);
+
+        if constexpr (mode == BlendMode::PremultipliedAdd)
+        {
+            lanes::store(destination.data() + i, lanes::add_saturate(d, s));
+        }
+        else
+        {
+            const auto low  = blend_wide<mode>(lanes::widen_low(d), lanes::widen_low(s));
+            const auto high = blend_wide<mode>(lanes::widen_high(d), lanes::widen_high(s));
+            lanes::store(destination.data() + i, lanes::narrow(low, high));
+        }
+    }
+#endif
+
+    for (; i < destination.size(); i++)
+    {
+        destination[i] = blend_pixel<mode>(destination[i], source[i]);
+    }
+}
+} // namespace detail
+
+SM_INLINE void blend(std::span<Color> destination, std::span<const Color> source, BlendMode mode)
+{
+    if (source.size() < destination.size())
+    {
+        throw Error{fmt::format("blend: source has {} elements, destination has {}",
+                                source.size(), destination.size())};
+    }
+
+    switch (mode)
+    {
+    case BlendMode::Over: detail::blend_span<BlendMode::Over>(destination, source); break;
+    case BlendMode::Add: detail::blend_span<BlendMode::Add>(destination, source); break;
+    case BlendMode::Multiply: detail::blend_span<BlendMode::Multiply>(destination, source); break;
+    case BlendMode::Screen: detail::blend_span<BlendMode::Screen>(destination, source); break;
+    case BlendMode::PremultipliedOver:
+        detail::blend_span<BlendMode::PremultipliedOver>(destination, source);
+        break;
+    case BlendMode::PremultipliedAdd:
+        detail::blend_span<BlendMode::PremultipliedAdd>(destination, source);
+        break;
+    }
+}
+
+SM_INLINE void
+blend(Image& destination, const Image& source, BlendMode mode, ThreadPool* thread_pool)
+{
+    if (destination.dims != source.dims)
+    {
+        throw Error{fmt::format("blend: source is {}x{} but destination is {}x{}", source.dims.x,
+                                source.dims.y, destination.dims.x, destination.dims.y)};
+    }
+
+    const auto row_length = destination.dims.x;
+    parallelize_loop(thread_pool, destination.dims.y,
+                     [&](u64 min, u64 max)
+                     {
+                         const auto count = (max - min) * row_length;
+                         blend(std::span{destination.data() + min * row_length, count},
+                               std::span{source.data() + min * row_length, count}, mode);
+                     });
+}
+
+SM_INLINE void premultiply(std::span<Color> colors)
+{
+    for (auto& color : colors)
+    {
+        const auto alpha = static_cast<u32>(color.a);
+        color.r          = static_cast<u8>(detail::div255(color.r * alpha));
+        color.g          = static_cast<u8>(detail::div255(color.g * alpha));
+        color.b          = static_cast<u8>(detail::div255(color.b * alpha));
+    }
+}
+} // namespace sm
+
+#endif
@@ -0,0 +1,564 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <vector> // for vector
+
+#include "samarium/core/types.hpp"      // for u64, f64
+#include "samarium/math/Vector2.hpp"    // for Dimensions
+#include "samarium/util/Grid.hpp"       // for Image
+#include "samarium/util/ThreadPool.hpp" // for ThreadPool
+
+namespace sm::filter
+{
+enum class Resample
+{
+    Nearest,
+    Bilinear,
+    Bicubic, ///< Catmull-Rom
+    Lanczos3
+};
+
+/**
+ * @brief               Blur each channel with a (2 radius + 1) wide box, in O(1) per pixel
+ *
+ * @param  image        Blurred in place, pixels past the edges repeat the edge
+ * @param  radius
+ * @param  thread_pool  Rows (and column strips) are split over this, or nullptr to run serially
+ */
+void box_blur(Image& image, u64 radius, ThreadPool* thread_pool = nullptr);
+
+/**
+ * @brief               Approximate a gaussian blur with 3 successive box blurs
+ *
+ * @param  image        Blurred in place
+ * @param  sigma        Standard deviation in pixels
+ * @param  thread_pool
+ */
+void gaussian_blur(Image& image, f64 sigma, ThreadPool* thread_pool = nullptr);
+
+/**
+ * @brief               Resample an image with a separable filter. When shrinking, the filter is
+ * widened to cover the source pixels, so the result doesn't alias
+ *
+ * @param  image
+ * @param  new_dims
+ * @param  mode
+ * @param  thread_pool
+ */
+[[nodiscard]] auto resize(const Image& image,
+                          Dimensions new_dims,
+                          Resample mode           = Resample::Bilinear,
+                          ThreadPool* thread_pool = nullptr) -> Image;
+
+/**
+ * @brief               Successively halve an image, averaging 2x2 blocks, down to 1x1
+ *
+ * @return              Levels from half the size of image down to 1x1, image itself is not included
+ */
+[[nodiscard]] auto mip_chain(const Image& image, ThreadPool* thread_pool = nullptr)
+    -> std::vector<Image>;
+} // namespace sm::filter
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_FILTER_IMPL)
+
+#include <algorithm> // for min, max
+#include <array>     // for array
+#include <bit>       // for bit_cast, bit_width
+#include <cmath>     // for floor, ceil, sin, sqrt, round
+#include <span>      // for span
+#include <utility>   // for swap
+
+#if defined(__SSE4_1__)
+#include <smmintrin.h> // for _mm_cvtepu8_epi32, _mm_mullo_epi32, _mm_packus_epi32
+#endif
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/math/loop.hpp"   // for start_end, end
+#include "samarium/math/math.hpp"   // for pi
+
+namespace sm::filter
+{
+namespace detail
+{
+// round (sum * multiplier) / 2^32 back to 8 bits. With 32 fractional bits the error of the rounded
+// multiplier stays below half a step for any window, the clamp is only a safeguard
+[[nodiscard]] inline auto narrow_channel(u32 sum, u32 multiplier) noexcept -> u8
+{
+    const auto scaled = (u64{sum} * multiplier + (u64{1} << 31)) >> 32;
+    return static_cast<u8>(std::min(scaled, u64{255}));
+}
+
+// 4 channels of integer sums for the box passes, and of floats for resampling
+#if defined(__SSE4_1__)
+using Sum4 = __m128i;
+
+// wrapped so that it can be stored in a std::vector without dropping its alignment
+struct Float4
+{
+    __m128 value;
+};
+
+[[nodiscard]] inline auto widen(Color color) noexcept -> Sum4
+{
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(std::bit_cast<i32>(color)));
+}
+
+[[nodiscard]] inline auto add(Sum4 a, Sum4 b) noexcept { return _mm_add_epi32(a, b); }
+
+[[nodiscard]] inline auto subtract(Sum4 a, Sum4 b) noexcept { return _mm_sub_epi32(a, b); }
+
+[[nodiscard]] inline auto scale(Sum4 sum, u32 factor) noexcept -> Sum4
+{
+    return _mm_mullo_epi32(sum, _mm_set1_epi32(static_cast<i32>(factor)));
+}
+
+// as narrow_channel, with 64 bit products of the even and odd channels
+[[nodiscard]] inline auto narrow(Sum4 sum, u32 multiplier) noexcept -> Color
+{
+    const auto factor   = _mm_set1_epi32(static_cast<i32>(multiplier));
+    const auto rounding = _mm_set1_epi64x(i64{1} << 31);
+    const auto even     = _mm_add_epi64(_mm_mul_epu32(sum, factor), rounding);
+    const auto odd      = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(sum, 32), factor), rounding);
+
+    // the high halves of the products, back in channel order
+    const auto scaled = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0b1100'1100);
+    const auto packed = _mm_packus_epi16(_mm_packus_epi32(scaled, scaled), _mm_setzero_si128());
+    return std::bit_cast<Color>(_mm_cvtsi128_si32(packed));
+}
+
+[[nodiscard]] inline auto to_float(Color color) noexcept -> Float4
+{
+    return {_mm_cvtepi32_ps(widen(color))};
+}
+
+[[nodiscard]] inline auto zero_float() noexcept -> Float4 { return {_mm_setzero_ps()}; }
+
+[[nodiscard]] inline auto multiply_add(Float4 accumulator, Float4 value, f32 weight) noexcept
+{
+    return Float4{_mm_add_ps(accumulator.value, _mm_mul_ps(value.value, _mm_set1_ps(weight)))};
+}
+
+[[nodiscard]] inline auto to_color(Float4 value) noexcept -> Color
+{
+    const auto rounded = _mm_cvtps_epi32(value.value); // saturated below by packus
+    const auto packed  = _mm_packus_epi16(_mm_packus_epi32(rounded, rounded), _mm_setzero_si128());
+    return std::bit_cast<Color>(_mm_cvtsi128_si32(packed));
+}
+#else
+using Sum4   = std::array<u32, 4>;
+using Float4 = std::array<f32, 4>;
+
+[[nodiscard]] inline auto widen(Color color) noexcept -> Sum4
+{
+    return {color.r, color.g, color.b, color.a};
+}
+
+[[nodiscard]] inline auto add(Sum4 a, Sum4 b) noexcept
+{
+    return Sum4{a[0] + b[0], a[1] + b[1], a[2] + b[2], a[3] + b[3]};
+}
+
+[[nodiscard]] inline auto subtract(Sum4 a, Sum4 b) noexcept
+{
+    return Sum4{a[0] - b[0], a[1] - b[1], a[2] - b[2], a[3] - b[3]};
+}
+
+[[nodiscard]] inline auto scale(Sum4 sum, u32 factor) noexcept
+{
+    return Sum4{sum[0] * factor, sum[1] * factor, sum[2] * factor, sum[3] * factor};
+}
+
+[[nodiscard]] inline auto narrow(Sum4 sum, u32 multiplier) noexcept -> Color
+{
+    const auto channel = [multiplier](u32 value) { return narrow_channel(value, multiplier); };
+    return Color{channel(sum[0]), channel(sum[1]), channel(sum[2]), channel(sum[3])};
+}
+
+[[nodiscard]] inline auto to_float(Color color) noexcept -> Float4
+{
+    return {f32(color.r), f32(color.g), f32(color.b), f32(color.a)};
+}
+
+[[nodiscard]] inline auto zero_float() noexcept -> Float4 { return {}; }
+
+[[nodiscard]] inline auto multiply_add(Float4 accumulator, Float4 value, f32 weight) noexcept
+{
+    for (auto i : loop::end(u64{4})) { accumulator[i] += value[i] * weight; }
+    return accumulator;
+}
+
+[[nodiscard]] inline auto to_color(Float4 value) noexcept -> Color
+{
+    const auto channel = [](f32 x)
+    { return static_cast<u8>(std::clamp(std::round(x), 0.0F, 255.0F)); };
+    return Color{channel(value[0]), channel(value[1]), channel(value[2]), channel(value[3])};
+}
+#endif
+
+// (sum * multiplier) >> 32 divides by the window size, for a radius of at least 1
+[[nodiscard]] inline auto box_multiplier(u64 radius) noexcept
+{
+    return static_cast<u32>(((u64{1} << 32) + radius) / (2 * radius + 1));
+}
+
+SM_INLINE void box_blur_row(const Color* in, Color* out, u64 width, u64 radius)
+{
+    const auto last       = width - 1;
+    const auto multiplier = box_multiplier(radius);
+
+    auto sum = scale(widen(in[0]), static_cast<u32>(radius + 1));
+    for (auto i : loop::start_end(u64{1}, radius + 1))
+    {
+        sum = add(sum, widen(in[std::min(i, last)]));
+    }
+
+    for (auto x : loop::end(width))
+    {
+        out[x] = narrow(sum, multiplier);
+
+        const auto entering = std::min(x + radius + 1, last);
+        const auto leaving  = x > radius ? x - radius : u64{};
+        sum                 = subtract(add(sum, widen(in[entering])), widen(in[leaving]));
+    }
+}
+
+// Every horizontal pass for a row is done while the row is in cache
+SM_INLINE void box_blur_rows(const Image& source,
+                             Image& destination,
+                             std::span<const u64> radii,
+                             u64 min,
+                             u64 max)
+{
+    const auto width = source.dims.x;
+    auto buffers     = std::array{std::vector<Color>(width), std::vector<Color>(width)};
+
+    for (auto y : loop::start_end(min, max))
+    {
+        const auto* in = &source[{0, y}];
+        for (auto i : loop::end(radii.size()))
+        {
+            auto* out = i + 1 == radii.size() ? &destination[{0, y}] : buffers[i % 2].data();
+            box_blur_row(in, out, width, radii[i]);
+            in = out;
+        }
+    }
+}
+
+// Vertical pass over a strip of columns, walking down the rows so every access is contiguous.
+// Operates on bytes, so the compiler vectorises the inner loops
+SM_INLINE void box_blur_columns(const Image& source,
+                                Image& destination,
+                                u64 radius,
+                                u64 column_min,
+                                u64 column_max)
+{
+    const auto height     = source.dims.y;
+    const auto last       = height - 1;
+    const auto multiplier = box_multiplier(radius);
+    const auto byte_count = (column_max - column_min) * 4;
+
+    const auto row = [&](const Image& image, u64 y)
+    { return reinterpret_cast<const u8*>(&image[{column_min, y}]); };
+
+    auto sums       = std::vector<u32>(byte_count);
+    const auto* top = row(source, 0);
+    for (auto i : loop::end(byte_count)) { sums[i] = top[i] * static_cast<u32>(radius + 1); }
+    for (auto k : loop::start_end(u64{1}, radius + 1))
+    {
+        const auto* in = row(source, std::min(k, last));
+        for (auto i : loop::end(byte_count)) { sums[i] += in[i]; }
+    }
+
+    for (auto y : loop::end(height))
+    {
+        auto* out = reinterpret_cast<u8*>(&destination[{column_min, y}]);
+        for (auto i : loop::end(byte_count))
+        {
+            out[i] = narrow_channel(sums[i], multiplier);
+        }
+
+        const auto* entering = row(source, std::min(y + radius + 1, last));
+        const auto* leaving  = row(source, y > radius ? y - radius : u64{});
+        for (auto i : loop::end(byte_count)) { sums[i] += u32{entering[i]} - u32{leaving[i]}; }
+    }
+}
+
+// horizontal passes into scratch, then vertical passes back and forth, ending in image
+SM_INLINE void
+box_passes(Image& image, Image& scratch, std::span<const u64> radii, ThreadPool* thread_pool)
+{
+    constexpr auto strip_width = u64{256};
+
+    parallelize_loop(thread_pool, image.dims.y, [&](u64 min, u64 max)
+                     { box_blur_rows(image, scratch, radii, min, max); });
+
+    const auto strip_count = (image.dims.x + strip_width - 1) / strip_width;
+    for (auto i : loop::end(radii.size()))
+    {
+        const auto& source = i % 2 == 0 ? scratch : image;
+        auto& destination  = i % 2 == 0 ? image : scratch;
+
+        parallelize_loop(thread_pool, strip_count,
+                         [&](u64 min, u64 max)
+                         {
+                             for (auto strip : loop::start_end(min, max))
+                             {
+                                 const auto column_min = strip * strip_width;
+                                 const auto column_max =
+                                     std::min(column_min + strip_width, image.dims.x);
+                                 box_blur_columns(source, destination, radii[i], column_min,
+                                                  column_max);
+                             }
+                         });
+    }
+
+    if (radii.size() % 2 == 0) { std::swap(image.elements, scratch.elements); }
+}
+
+struct Taps
+{
+    u64 count{};
+    std::vector<u32> indices; // count per output pixel, clamped to the source
+    std::vector<f32> weights; // count per output pixel, normalized
+};
+
+SM_INLINE auto kernel_support(Resample mode) -> f64
+{
+    switch (mode)
+    {
+    case Resample::Nearest: return 0.5;
+    case Resample::Bilinear: return 1.0;
+    case Resample::Bicubic: return 2.0;
+    case Resample::Lanczos3: return 3.0;
+    }
+    return 1.0;
+}
+
+SM_INLINE auto kernel(Resample mode, f64 x) -> f64
+{
+    x = std::abs(x);
+    switch (mode)
+    {
+    case Resample::Nearest: return x < 0.5 ? 1.0 : 0.0;
+    case Resample::Bilinear: return std::max(0.0, 1.0 - x);
+    case Resample::Bicubic:
+    {
+        constexpr auto a = -0.5;
+        if (x < 1.0) { return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0; }
+        if (x < 2.0) { return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a; }
+        return 0.0;
+    }
+    case Resample::Lanczos3:
+    {
+        if (x < 1e-8) { return 1.0; }
+        if (x >= 3.0) { return 0.0; }
+        const auto pi_x = math::pi * x;
+        return 3.0 * std::sin(pi_x) * std::sin(pi_x / 3.0) / (pi_x * pi_x);
+    }
+    }
+    return 0.0;
+}
+
+SM_INLINE auto make_taps(u64 source_size, u64 destination_size, Resample mode) -> Taps
+{
+    const auto ratio        = static_cast<f64>(source_size) / static_cast<f64>(destination_size);
+    const auto filter_scale = std::max(ratio, 1.0);
+    const auto support      = kernel_support(mode) * filter_scale;
+    const auto last         = static_cast<i64>(source_size) - 1;
+
+    auto taps  = Taps{};
+    taps.count =
+        mode == Resample::Nearest ? u64{1} : static_cast<u64>(std::ceil(2.0 * support)) + 1;
+    taps.indices.resize(destination_size * taps.count);
+    taps.weights.resize(destination_size * taps.count);
+
+    for (auto i : loop::end(destination_size))
+    {
+        const auto center = (static_cast<f64>(i) + 0.5) * ratio - 0.5;
+        auto* indices     = &taps.indices[i * taps.count];
+        auto* weights     = &taps.weights[i * taps.count];
+
+        if (mode == Resample::Nearest)
+        {
+            const auto nearest = static_cast<i64>(std::round(center));
+            indices[0]         = static_cast<u32>(std::clamp(nearest, i64{}, last));
+            weights[0] = 1.0F;
+            continue;
+        }
+
+        const auto first = static_cast<i64>(std::ceil(center - support));
+        auto total       = 0.0;
+        for (auto k : loop::end(taps.count))
+        {
+            const auto source = first + static_cast<i64>(k);
+            const auto weight = kernel(mode, (static_cast<f64>(source) - center) / filter_scale);
+            indices[k]        = static_cast<u32>(std::clamp(source, i64{}, last));
+            weights[k]        = static_cast<f32>(weight);
+            total += weight;
+        }
+        const auto normalizer = static_cast<f32>(1.0 / total);
+        for (auto k : loop::end(taps.count)) { weights[k] *= normalizer; }
+    }
+
+    return taps;
+}
+} // namespace detail
+
+SM_INLINE void box_blur(Image& image, u64 radius, ThreadPool* thread_pool)
+{
+    if (radius == 0 || image.size() == 0) { return; }
+
+    auto scratch     = Image{image.dims};
+    const auto radii = std::array{radius};
+    detail::box_passes(image, scratch, radii, thread_pool);
+}
+
+SM_INLINE void gaussian_blur(Image& image, f64 sigma, ThreadPool* thread_pool)
+{
+    if (sigma <= 0.0 || image.size() == 0) { return; }
+
+    // box widths whose 3 fold convolution has variance sigma^2, see
+    // http://blog.ivank.net/fastest-gaussian-blur.html
+    constexpr auto passes = 3.0;
+    const auto ideal      = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+    auto lower            = static_cast<i64>(std::floor(ideal));
+    if (lower % 2 == 0) { lower--; }
+    const auto lower_f     = static_cast<f64>(lower);
+    const auto lower_count = std::round((12.0 * sigma * sigma - passes * lower_f * lower_f -
+                                         4.0 * passes * lower_f - 3.0 * passes) /
+                                        (-4.0 * lower_f - 4.0));
+
+    auto radii = std::array<u64, 3>{};
+    for (auto pass : loop::end(radii.size()))
+    {
+        const auto width = static_cast<f64>(pass) < lower_count ? lower : lower + 2;
+        radii[pass]      = static_cast<u64>(std::max(width, i64{1}) / 2);
+    }
+    if (radii[2] == 0) { return; }
+
+    // a radius 0 pass is a no-op copy, the larger radii come last
+    const auto first = static_cast<u64>(radii[0] == 0) + static_cast<u64>(radii[1] == 0);
+    auto scratch     = Image{image.dims};
+    detail::box_passes(image, scratch, std::span{radii}.subspan(first), thread_pool);
+}
+
+SM_INLINE auto
+resize(const Image& image, Dimensions new_dims, Resample mode, ThreadPool* thread_pool) -> Image
+{
+    auto output = Image{new_dims};
+    if (image.size() == 0 || output.size() == 0) { return output; }
+
+    const auto horizontal = detail::make_taps(image.dims.x, new_dims.x, mode);
+    const auto vertical   = detail::make_taps(image.dims.y, new_dims.y, mode);
+
+    // horizontally resampled rows, at the source height
+    auto intermediate = std::vector<detail::Float4>(image.dims.y * new_dims.x);
+
+    parallelize_loop(thread_pool, image.dims.y,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             const auto* in = &image[{0, y}];
+                             auto* out      = &intermediate[y * new_dims.x];
+                             for (auto x : loop::end(new_dims.x))
+                             {
+                                 const auto* indices = &horizontal.indices[x * horizontal.count];
+                                 const auto* weights = &horizontal.weights[x * horizontal.count];
+
+                                 auto sum = detail::zero_float();
+                                 for (auto k : loop::end(horizontal.count))
+                                 {
+                                     const auto pixel = detail::to_float(in[indices[k]]);
+                                     sum = detail::multiply_add(sum, pixel, weights[k]);
+                                 }
+                                 out[x] = sum;
+                             }
+                         }
+                     });
+
+    // accumulate whole rows at a time so that the intermediate is read contiguously
+    parallelize_loop(thread_pool, new_dims.y,
+                     [&](u64 min, u64 max)
+                     {
+                         auto row = std::vector<detail::Float4>(new_dims.x);
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             std::fill(row.begin(), row.end(), detail::zero_float());
+                             for (auto k : loop::end(vertical.count))
+                             {
+                                 const auto source = vertical.indices[y * vertical.count + k];
+                                 const auto weight = vertical.weights[y * vertical.count + k];
+                                 const auto* in    = &intermediate[source * new_dims.x];
+                                 for (auto x : loop::end(new_dims.x))
+                                 {
+                                     row[x] = detail::multiply_add(row[x], in[x], weight);
+                                 }
+                             }
+
+                             auto* out = &output[{0, y}];
+                             for (auto x : loop::end(new_dims.x))
+                             {
+                                 out[x] = detail::to_color(row[x]);
+                             }
+                         }
+                     });
+
+    return output;
+}
+
+SM_INLINE auto mip_chain(const Image& image, ThreadPool* thread_pool) -> std::vector<Image>
+{
+    auto levels = std::vector<Image>{};
+    if (image.size() == 0) { return levels; }
+
+    // levels hold pointers to the previous level, so they must not reallocate
+    levels.reserve(static_cast<u64>(std::bit_width(std::max(image.dims.x, image.dims.y))));
+
+    const auto* previous = &image;
+    while (previous->dims.x > 1 || previous->dims.y > 1)
+    {
+        const auto& source = *previous;
+        auto& level =
+            levels.emplace_back(Dimensions{(source.dims.x + 1) / 2, (source.dims.y + 1) / 2});
+
+        parallelize_loop(
+            thread_pool, level.dims.y,
+            [&](u64 min, u64 max)
+            {
+                for (auto y : loop::start_end(min, max))
+                {
+                    const auto bottom_y = std::min(2 * y + 1, source.dims.y - 1);
+                    const auto* top     = reinterpret_cast<const u8*>(&source[{0, 2 * y}]);
+                    const auto* bottom  = reinterpret_cast<const u8*>(&source[{0, bottom_y}]);
+                    auto* out           = reinterpret_cast<u8*>(&level[{0, y}]);
+
+                    for (auto x : loop::end(level.dims.x))
+                    {
+                        const auto left  = 8 * x;
+                        const auto right = 4 * std::min(2 * x + 1, source.dims.x - 1);
+                        for (auto channel : loop::end(u64{4}))
+                        {
+                            const auto sum = u32{top[left + channel]} + top[right + channel] +
+                                             bottom[left + channel] + bottom[right + channel];
+                            out[4 * x + channel] = static_cast<u8>((sum + 2) >> 2);
+                        }
+                    }
+                }
+            });
+
+        previous = &level;
+    }
+
+    return levels;
+}
+} // namespace sm::filter
+
+#endif
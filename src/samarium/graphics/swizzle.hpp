@@ -0,0 +1,241 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <cstring>     // for memcpy
+#include <span>        // for span
+#include <type_traits> // for is_same_v
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h> // for _mm_shuffle_epi8, _mm_alignr_epi8
+#elif defined(__SSE2__)
+#include <emmintrin.h> // for _mm_and_si128, _mm_slli_epi32
+#endif
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/types.hpp" // for u8, u64
+#include "samarium/math/loop.hpp"  // for end
+#include "samarium/util/Error.hpp" // for Error
+
+#include "Color.hpp" // for Color, ColorFormat, RGB_t, BGR_t...
+
+namespace sm
+{
+namespace detail
+{
+#if defined(__SSSE3__)
+// byte order of 4 source pixels for each format, -1 zeroes a byte
+template <concepts::ColorFormat Format> [[nodiscard]] inline auto swizzle_mask() noexcept
+{
+    if constexpr (std::is_same_v<Format, BGRA_t>)
+    {
+        return _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    }
+    else if constexpr (std::is_same_v<Format, BGR_t>)
+    {
+        return _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    }
+    else { return _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1); }
+}
+#endif
+
+template <concepts::ColorFormat Format>
+inline void swizzle_scalar(const Color* colors, u64 count, u8* bytes) noexcept
+{
+    // byte by byte rather than through get_formatted, which compilers vectorize well
+    for (auto i : loop::end(count))
+    {
+        const auto color = colors[i];
+        auto* pixel      = bytes + i * Format::length;
+        if constexpr (std::is_same_v<Format, BGR_t> || std::is_same_v<Format, BGRA_t>)
+        {
+            pixel[0] = color.b;
+            pixel[1] = color.g;
+            pixel[2] = color.r;
+        }
+        else
+        {
+            pixel[0] = color.r;
+            pixel[1] = color.g;
+            pixel[2] = color.b;
+        }
+        if constexpr (Format::length == 4) { pixel[3] = color.a; }
+    }
+}
+} // namespace detail
+
+/**
+ * @brief               Convert colors to packed bytes in another channel order, eg for file
+ * writers and GPU uploads. Uses byte shuffles with SSSE3. See expand() for the reverse
+ *
+ * @param  colors
+ * @param  format       One of rgb, rgba, bgr, bgra
+ * @param  bytes        At least colors.size() * Format::length long
+ */
+template <concepts::ColorFormat Format>
+void swizzle(std::span<const Color> colors, [[maybe_unused]] Format format, std::span<u8> bytes)
+{
+    const auto count = colors.size();
+    if (bytes.size() < count * Format::length)
+    {
+        throw Error{fmt::format("swizzle: {} bytes is too small for {} colors", bytes.size(),
+                                count)};
+    }
+
+    if constexpr (std::is_same_v<Format, RGBA_t>)
+    {
+        std::memcpy(bytes.data(), colors.data(), count * sizeof(Color));
+        return;
+    }
+    else
+    {
+        const auto* in = colors.data();
+        auto* out      = bytes.data();
+        auto i         = u64{};
+
+#if defined(__SSSE3__)
+        const auto mask = detail::swizzle_mask<Format>();
+        const auto load = [in](u64 index)
+        { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + index)); };
+
+        if constexpr (Format::length == 4)
+        {
+            for (; i + 4 <= count; i += 4)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i),
+                                 _mm_shuffle_epi8(load(i), mask));
+            }
+        }
+        else
+        {
+            // 16 pixels become 4 runs of 12 bytes, stitched into 3 full stores
+            for (; i + 16 <= count; i += 16)
+            {
+                const auto a = _mm_shuffle_epi8(load(i), mask);
+                const auto b = _mm_shuffle_epi8(load(i + 4), mask);
+                const auto c = _mm_shuffle_epi8(load(i + 8), mask);
+                const auto d = _mm_shuffle_epi8(load(i + 12), mask);
+
+                auto* destination = reinterpret_cast<__m128i*>(out + 3 * i);
+                _mm_storeu_si128(destination, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+                _mm_storeu_si128(destination + 1,
+                                 _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+                _mm_storeu_si128(destination + 2,
+                                 _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+            }
+        }
+#elif defined(__SSE2__)
+        if constexpr (std::is_same_v<Format, BGRA_t>)
+        {
+            // swap the red and blue bytes of each 32 bit pixel
+            const auto green_alpha = _mm_set1_epi32(static_cast<i32>(0xFF00'FF00U));
+            const auto low_byte    = _mm_set1_epi32(0xFF);
+            for (; i + 4 <= count; i += 4)
+            {
+                const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                const auto red_blue =
+                    _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16), low_byte),
+                                 _mm_slli_epi32(_mm_and_si128(pixels, low_byte), 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i),
+                                 _mm_or_si128(_mm_and_si128(pixels, green_alpha), red_blue));
+            }
+        }
+#endif
+
+        detail::swizzle_scalar<Format>(in + i, count - i, out + Format::length * i);
+    }
+}
+
+/**
+ * @brief               Expand packed pixels of 1 (gray), 2 (gray and alpha), 3 (RGB) or 4 (RGBA)
+ * channels to Colors, eg after decoding an image. Alpha is 255 if there is none. Uses SSE2, and
+ * SSSE3 for RGB
+ *
+ * @param  bytes        At least colors.size() * channels long
+ * @param  channels
+ * @param  colors
+ */
+inline void expand(std::span<const u8> bytes, u64 channels, std::span<Color> colors)
+{
+    const auto count = colors.size();
+    if (channels == 0 || channels > 4 || bytes.size() < count * channels)
+    {
+        throw Error{fmt::format("expand: {} bytes of {} channels is too small for {} colors",
+                                bytes.size(), channels, count)};
+    }
+
+    const auto* in = bytes.data();
+    auto* out      = colors.data();
+    auto i         = u64{};
+
+    if (channels == 4)
+    {
+        std::memcpy(out, in, count * sizeof(Color));
+        return;
+    }
+
+#if defined(__SSE2__)
+    const auto opaque = _mm_set1_epi32(static_cast<i32>(0xFF00'0000U));
+    const auto load = [in](u64 offset)
+    { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + offset)); };
+    const auto store = [out](u64 index, __m128i pixels)
+    { _mm_storeu_si128(reinterpret_cast<__m128i*>(out + index), pixels); };
+
+    if (channels == 1)
+    {
+        for (; i + 16 <= count; i += 16)
+        {
+            const auto gray = load(i);
+            const auto low  = _mm_unpacklo_epi8(gray, gray);
+            const auto high = _mm_unpackhi_epi8(gray, gray);
+            store(i, _mm_or_si128(_mm_unpacklo_epi16(low, low), opaque));
+            store(i + 4, _mm_or_si128(_mm_unpackhi_epi16(low, low), opaque));
+            store(i + 8, _mm_or_si128(_mm_unpacklo_epi16(high, high), opaque));
+            store(i + 12, _mm_or_si128(_mm_unpackhi_epi16(high, high), opaque));
+        }
+    }
+    else if (channels == 2)
+    {
+        for (; i + 8 <= count; i += 8)
+        {
+            const auto gray_alpha = load(2 * i);
+            const auto gray       = _mm_and_si128(gray_alpha, _mm_set1_epi16(0xFF));
+            const auto gray_gray  = _mm_or_si128(gray, _mm_slli_epi16(gray, 8));
+            store(i, _mm_unpacklo_epi16(gray_gray, gray_alpha));
+            store(i + 4, _mm_unpackhi_epi16(gray_gray, gray_alpha));
+        }
+    }
+#if defined(__SSSE3__)
+    else
+    {
+        // 48 bytes of RGB to 16 pixels, 12 bytes at a time
+        const auto mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        for (; i + 16 <= count; i += 16)
+        {
+            const auto a = load(3 * i);
+            const auto b = load(3 * i + 16);
+            const auto c = load(3 * i + 32);
+            store(i, _mm_or_si128(_mm_shuffle_epi8(a, mask), opaque));
+            store(i + 4, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), opaque));
+            store(i + 8, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), opaque));
+            store(i + 12, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), opaque));
+        }
+    }
+#endif
+#endif
+
+    for (; i < count; i++)
+    {
+        const auto* pixel = in + i * channels;
+        if (channels == 1) { out[i] = Color{pixel[0], pixel[0], pixel[0], 255}; }
+        else if (channels == 2) { out[i] = Color{pixel[0], pixel[0], pixel[0], pixel[1]}; }
+        else { out[i] = Color{pixel[0], pixel[1], pixel[2], 255}; }
+    }
+}
+} // namespace sm
@@ -7,9 +7,11 @@
 
 #pragma once
 
-#include <memory>    // for allocator, unique_ptr
-#include <stdexcept> // for runtime_error
-#include <string>    // for string
+#include <filesystem> // for path
+#include <memory>     // for allocator, unique_ptr
+#include <optional>   // for optional
+#include <stdexcept>  // for runtime_error
+#include <string>     // for string
 
 #include "glad/glad.h" // for gladLoadGLLoader, glEnable
 
@@ -17,15 +19,17 @@
 #include "glm/ext/matrix_float4x4.hpp"             // for mat4
 #include "samarium/util/call_thunk/call_thunk.hpp" // for thunk
 
-#include "samarium/core/types.hpp"       // for f64, i32, u64, f32
-#include "samarium/gl/Context.hpp"       // for Context
-#include "samarium/gl/Texture.hpp"       // for Texture
-#include "samarium/gl/gl.hpp"            // for enable_debug_output, versio...
-#include "samarium/math/BoundingBox.hpp" // for BoundingBox
-#include "samarium/math/Transform.hpp"   // for Transform
-#include "samarium/math/Vector2.hpp"     // for Dimensions, Vector2_t, Vector2
-#include "samarium/math/math.hpp"        // for min, max
-#include "samarium/util/Grid.hpp"        // for Image
+#include "samarium/core/types.hpp"         // for f64, i32, u64, f32
+#include "samarium/gl/Context.hpp"         // for Context
+#include "samarium/gl/HeadlessContext.hpp" // for HeadlessContext
+#include "samarium/gl/ProgramCache.hpp"    // for ProgramCache
+#include "samarium/gl/Texture.hpp"         // for Texture
+#include "samarium/gl/gl.hpp"              // for enable_debug_output, versio...
+#include "samarium/math/BoundingBox.hpp"   // for BoundingBox
+#include "samarium/math/Transform.hpp"     // for Transform
+#include "samarium/math/Vector2.hpp"       // for Dimensions, Vector2_t, Vector2
+#include "samarium/math/math.hpp"          // for min, max
+#include "samarium/util/Grid.hpp"          // for Image
 
 #include "Mouse.hpp"    // for Mouse
 #include "keyboard.hpp" // for keyboard
@@ -43,6 +47,14 @@ struct WindowConfig
     Dimensions dims   = dims720;
     std::string title = "Samarium Window";
     bool resizable    = true;
+
+    /// Render offscreen with EGL instead of opening a window, eg on servers without a display.
+    /// There are no inputs, and frames are only seen through get_image()
+    bool headless = false;
+
+    /// Where linked shader programs are cached between runs, see gl::ProgramCache. Empty disables
+    /// the cache
+    std::filesystem::path shader_cache = gl::ProgramCache::default_directory();
 };
 
 struct ScrollCallback
@@ -99,8 +111,17 @@ struct Window
      */
     struct Init
     {
+        std::optional<gl::HeadlessContext> headless{};
+
         Init(const WindowConfig& config, Handle& handle)
         {
+            if (config.headless)
+            {
+                headless.emplace(expect(gl::HeadlessContext::make()));
+                glViewport(0, 0, static_cast<i32>(config.dims.x), static_cast<i32>(config.dims.y));
+                return;
+            }
+
             if (glfwInit() == 0) { throw Error{"failed to initialize glfw"}; }
 
             glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gl::version_major);
@@ -128,7 +149,10 @@ struct Window
         Init(Init&&) noexcept                    = default;
         auto operator=(Init&&) noexcept -> Init& = default;
 
-        ~Init() { glfwTerminate(); }
+        ~Init()
+        {
+            if (!headless) { glfwTerminate(); }
+        }
     };
 
     ScrollCallback scroll_callback{};
@@ -140,7 +164,7 @@ struct Window
     Mouse mouse{};
     keyboard::Keymap keymap{};
 
-    [[no_unique_address]] Init init;
+    Init init;
     gl::Context context;
 
     explicit Window(const WindowConfig& config = {});
@@ -155,6 +179,9 @@ struct Window
 
     [[nodiscard]] auto is_open() const -> bool;
 
+    /// If created with WindowConfig::headless
+    [[nodiscard]] auto is_headless() const -> bool;
+
     void close();
 
     void get_inputs();
@@ -209,7 +236,10 @@ struct Window
      *
      * @return Image
      */
-    [[nodiscard]] auto get_image() const -> Image;
+    [[nodiscard]] auto get_image() -> Image;
+
+  private:
+    bool should_close{}; // only used if headless, GLFW keeps track otherwise
 };
 } // namespace sm
 
@@ -224,13 +254,16 @@ struct Window
 namespace sm
 {
 SM_INLINE Window::Window(const WindowConfig& config)
-    : dims{config.dims}, init{config, handle}, context{config.dims}
+    : dims{config.dims}, init{config, handle},
+      context{config.dims, gl::ProgramCache{config.shader_cache}}
 {
     gl::enable_debug_output();
 
     glEnable(GL_BLEND); // enable blending function
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    if (is_headless()) { return; }
+
     keymap.push_back(keyboard::OnKeyPress{
         *handle, {Key::Escape}, [this] { this->close(); }}); // by default, exit on escape
 
@@ -239,12 +272,24 @@ SM_INLINE Window::Window(const WindowConfig& config)
     glfwSetScrollCallback(handle.get(), scroll_callback.thunk);
 }
 
-SM_INLINE auto Window::is_open() const -> bool { return glfwWindowShouldClose(handle.get()) == 0; }
+SM_INLINE auto Window::is_open() const -> bool
+{
+    if (is_headless()) { return !should_close; }
+    return glfwWindowShouldClose(handle.get()) == 0;
+}
+
+SM_INLINE auto Window::is_headless() const -> bool { return init.headless.has_value(); }
 
-SM_INLINE void Window::close() { glfwSetWindowShouldClose(handle.get(), true); }
+SM_INLINE void Window::close()
+{
+    if (is_headless()) { should_close = true; }
+    else { glfwSetWindowShouldClose(handle.get(), true); }
+}
 
 SM_INLINE void Window::get_inputs()
 {
+    if (is_headless()) { return; }
+
     scroll_callback.holder.scroll = 0.0;
 
     glfwPollEvents();
@@ -266,6 +311,13 @@ SM_INLINE void Window::get_inputs()
 
 SM_INLINE void Window::display()
 {
+    // nothing to show, or wait for: headless frames go as fast as they render
+    if (is_headless())
+    {
+        context.end_frame();
+        return;
+    }
+
     context.draw_frame();
 
     resize_callback.holder.resized = false;
@@ -286,6 +338,7 @@ SM_INLINE void Window::display()
 
 SM_INLINE auto Window::is_key_pressed(Key key) const -> bool
 {
+    if (is_headless()) { return false; }
     return glfwGetKey(handle.get(), static_cast<i32>(key)) == GLFW_PRESS;
 }
 
@@ -305,8 +358,10 @@ SM_INLINE auto Window::aspect_vector_max() const -> Vector2
     return dims.cast<f64>() / static_cast<f64>(math::min(dims.x, dims.y));
 }
 
-SM_INLINE auto Window::get_image() const -> Image
+SM_INLINE auto Window::get_image() -> Image
 {
+    context.flush();
+
     auto image = Image{dims};
     glReadPixels(0, 0, static_cast<i32>(dims.x), static_cast<i32>(dims.y), GL_RGBA,
                  GL_UNSIGNED_BYTE, static_cast<void*>(&image.front()));
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "samarium/math/Multigrid.hpp"
 #include "samarium/math/Polynomial.hpp"
 #include "samarium/math/SecondOrderDynamics.hpp"
 #include "samarium/math/Transform.hpp"
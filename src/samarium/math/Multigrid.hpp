@@ -0,0 +1,264 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <vector> // for vector
+
+#include "samarium/core/types.hpp"      // for u64, f64
+#include "samarium/math/Vector2.hpp"    // for Dimensions
+#include "samarium/math/loop.hpp"       // for end
+#include "samarium/math/math.hpp"       // for min, max
+#include "samarium/util/Grid.hpp"       // for Grid
+#include "samarium/util/GridLayout.hpp" // for RowMajor
+#include "samarium/util/ThreadPool.hpp" // for ThreadPool, parallelize_loop
+
+namespace sm
+{
+/**
+ * @brief               Geometric multigrid solver for \f$ (a - \nabla^2) x = b \f$ on a cell-centered
+ * Grid with Neumann (closed) boundaries
+ *
+ * @details Uses V-cycles with red-black Gauss-Seidel smoothing, full-weighting restriction and
+ * bilinear prolongation. Each smoothing pass is split into row blocks over a ThreadPool. With a = 0
+ * this is the pressure Poisson equation, with a > 0 it is an implicit diffusion step
+ *
+ * @tparam T            Value type, eg f64 or Vector2
+ * @tparam Layout       Of the grids on every level. The sweeps go row by row, so RowMajor is the
+ * fastest in benchmarks/Grid.cpp, the others pay for computing every index
+ */
+template <typename T, concepts::GridLayout Layout = layout::RowMajor> struct Multigrid
+{
+    using Field = Grid<T, Layout>;
+
+    struct Config
+    {
+        u64 cycles{2};          ///< V-cycles per call to solve()
+        u64 smoothing_steps{2}; ///< Red-black sweeps before and after each coarse correction
+        u64 coarse_steps{24};   ///< Red-black sweeps on the coarsest level
+        u64 coarsest_size{8};   ///< Stop coarsening once either dimension is at most this
+    };
+
+    struct Level
+    {
+        Field solution;
+        Field rhs;
+        Field residual;
+
+        explicit Level(Dimensions dims) : solution(dims), rhs(dims), residual(dims) {}
+    };
+
+    Config config;
+    Field residual;            ///< Residual of the finest level
+    std::vector<Level> levels; ///< Coarse levels, levels[0] has half the finest resolution
+
+    explicit Multigrid(Dimensions dims, const Config& config_ = {})
+        : config{config_}, residual(dims)
+    {
+        auto current = dims;
+        while (math::min(current.x, current.y) > config.coarsest_size)
+        {
+            current = (current + Dimensions{1, 1}) / u64{2};
+            levels.emplace_back(current);
+        }
+    }
+
+    /**
+     * @brief               Improve solution in place so that (a - laplacian) solution = rhs
+     *
+     * @param  solution     Initial guess, overwritten with the result
+     * @param  rhs          Right hand side
+     * @param  diagonal     The coefficient a, 0 for the Poisson equation
+     * @param  thread_pool  Pool to split rows over, or nullptr to run serially
+     */
+    void solve(Field& solution,
+               const Field& rhs,
+               f64 diagonal,
+               ThreadPool* thread_pool = nullptr)
+    {
+        for ([[maybe_unused]] auto i : loop::end(config.cycles))
+        {
+            vcycle(0, solution, rhs, residual, diagonal, thread_pool);
+        }
+    }
+
+  private:
+    // neighbours through the layout, which for RowMajor compiles to the same offsets of index
+    static auto relax(Field& x, const Field& b, u64 i, u64 j, f64 diagonal, f64 inv_h2)
+    {
+        auto sum   = T{};
+        auto count = 0.0;
+        if (i > 0)
+        {
+            sum += x[{i - 1, j}];
+            count += 1.0;
+        }
+        if (i + 1 < x.dims.x)
+        {
+            sum += x[{i + 1, j}];
+            count += 1.0;
+        }
+        if (j > 0)
+        {
+            sum += x[{i, j - 1}];
+            count += 1.0;
+        }
+        if (j + 1 < x.dims.y)
+        {
+            sum += x[{i, j + 1}];
+            count += 1.0;
+        }
+
+        x[{i, j}] = (b[{i, j}] + sum * inv_h2) / (diagonal + count * inv_h2);
+    }
+
+    static auto apply(const Field& x, u64 i, u64 j, f64 diagonal, f64 inv_h2)
+    {
+        const auto center = x[{i, j}];
+
+        auto laplacian = T{};
+        if (i > 0) { laplacian += x[{i - 1, j}] - center; }
+        if (i + 1 < x.dims.x) { laplacian += x[{i + 1, j}] - center; }
+        if (j > 0) { laplacian += x[{i, j - 1}] - center; }
+        if (j + 1 < x.dims.y) { laplacian += x[{i, j + 1}] - center; }
+
+        return center * diagonal - laplacian * inv_h2;
+    }
+
+    static void smooth(Field& x,
+                       const Field& b,
+                       f64 diagonal,
+                       f64 inv_h2,
+                       u64 steps,
+                       ThreadPool* thread_pool)
+    {
+        for ([[maybe_unused]] auto step : loop::end(steps))
+        {
+            for (auto color : loop::end(u64{2}))
+            {
+                parallelize_loop(thread_pool, x.dims.y,
+                                 [&](u64 min, u64 max)
+                                 {
+                                     for (auto j : loop::start_end(min, max))
+                                     {
+                                         for (auto i = (j + color) % 2; i < x.dims.x; i += 2)
+                                         {
+                                             relax(x, b, i, j, diagonal, inv_h2);
+                                         }
+                                     }
+                                 });
+            }
+        }
+    }
+
+    static void compute_residual(const Field& x,
+                                 const Field& b,
+                                 Field& r,
+                                 f64 diagonal,
+                                 f64 inv_h2,
+                                 ThreadPool* thread_pool)
+    {
+        parallelize_loop(thread_pool, x.dims.y,
+                         [&](u64 min, u64 max)
+                         {
+                             for (auto j : loop::start_end(min, max))
+                             {
+                                 for (auto i : loop::end(x.dims.x))
+                                 {
+                                     r[{i, j}] = b[{i, j}] - apply(x, i, j, diagonal, inv_h2);
+                                 }
+                             }
+                         });
+    }
+
+    // average each 2x2 block of fine cells into one coarse cell. On odd sized grids the last
+    // blocks hang off the edge, and the missing cells count as 0 rather than as copies of their
+    // neighbours, which would overweight the edge and slow convergence to a crawl
+    static void restrict_to(const Field& fine, Field& coarse, ThreadPool* thread_pool)
+    {
+        parallelize_loop(thread_pool, coarse.dims.y,
+                         [&](u64 min, u64 max)
+                         {
+                             for (auto j : loop::start_end(min, max))
+                             {
+                                 const auto y0     = 2 * j;
+                                 const auto has_y1 = y0 + 1 < fine.dims.y;
+                                 for (auto i : loop::end(coarse.dims.x))
+                                 {
+                                     const auto x0     = 2 * i;
+                                     const auto has_x1 = x0 + 1 < fine.dims.x;
+
+                                     auto sum = fine[{x0, y0}];
+                                     if (has_x1) { sum += fine[{x0 + 1, y0}]; }
+                                     if (has_y1) { sum += fine[{x0, y0 + 1}]; }
+                                     if (has_x1 && has_y1) { sum += fine[{x0 + 1, y0 + 1}]; }
+                                     coarse[{i, j}] = sum * 0.25;
+                                 }
+                             }
+                         });
+    }
+
+    // bilinearly interpolate the coarse correction and add it to the fine solution
+    static void prolongate_add(const Field& coarse, Field& fine, ThreadPool* thread_pool)
+    {
+        const auto clamp_index = [](u64 index, i64 offset, u64 size)
+        {
+            const auto shifted = static_cast<i64>(index) + offset;
+            return static_cast<u64>(
+                math::max(i64{}, math::min(shifted, static_cast<i64>(size) - 1)));
+        };
+
+        parallelize_loop(
+            thread_pool, fine.dims.y,
+            [&](u64 min, u64 max)
+            {
+                for (auto j : loop::start_end(min, max))
+                {
+                    const auto cy0 = j / 2;
+                    const auto cy1 = clamp_index(cy0, j % 2 == 0 ? -1 : 1, coarse.dims.y);
+                    for (auto i : loop::end(fine.dims.x))
+                    {
+                        const auto cx0 = i / 2;
+                        const auto cx1 = clamp_index(cx0, i % 2 == 0 ? -1 : 1, coarse.dims.x);
+
+                        fine[{i, j}] += coarse[{cx0, cy0}] * (9.0 / 16.0) +
+                                        (coarse[{cx1, cy0}] + coarse[{cx0, cy1}]) * (3.0 / 16.0) +
+                                        coarse[{cx1, cy1}] * (1.0 / 16.0);
+                    }
+                }
+            });
+    }
+
+    void vcycle(u64 depth,
+                Field& x,
+                const Field& b,
+                Field& r,
+                f64 diagonal,
+                ThreadPool* thread_pool)
+    {
+        const auto h      = static_cast<f64>(u64{1} << depth);
+        const auto inv_h2 = 1.0 / (h * h);
+
+        if (depth == levels.size())
+        {
+            smooth(x, b, diagonal, inv_h2, config.coarse_steps, thread_pool);
+            return;
+        }
+
+        smooth(x, b, diagonal, inv_h2, config.smoothing_steps, thread_pool);
+        compute_residual(x, b, r, diagonal, inv_h2, thread_pool);
+
+        auto& coarse = levels[depth];
+        restrict_to(r, coarse.rhs, thread_pool);
+        coarse.solution.fill(T{});
+        vcycle(depth + 1, coarse.solution, coarse.rhs, coarse.residual, diagonal, thread_pool);
+
+        prolongate_add(coarse.solution, x, thread_pool);
+        smooth(x, b, diagonal, inv_h2, config.smoothing_steps, thread_pool);
+    }
+};
+} // namespace sm
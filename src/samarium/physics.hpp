@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include "samarium/physics/CellularAutomaton.hpp"
+#include "samarium/physics/Fluid.hpp"
 #include "samarium/physics/Particle.hpp"
 #include "samarium/physics/ParticleSystem.hpp"
 #include "samarium/physics/RigidBody.hpp"
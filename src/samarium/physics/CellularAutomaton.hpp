@@ -0,0 +1,397 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <array>       // for array
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+#include "samarium/core/types.hpp"           // for u64, u16, u8
+#include "samarium/graphics/Color.hpp"       // for Color
+#include "samarium/graphics/colors.hpp"      // for white, black
+#include "samarium/math/Vector2.hpp"         // for Indices, Dimensions
+#include "samarium/util/Grid.hpp"            // for Image
+#include "samarium/util/RandomGenerator.hpp" // for RandomGenerator
+#include "samarium/util/Result.hpp"          // for Result
+#include "samarium/util/ThreadPool.hpp"      // for ThreadPool
+
+namespace sm
+{
+/**
+ * @brief               Birth and survival conditions of a Life-like cellular automaton
+ */
+struct LifeRule
+{
+    u16 birth{};    ///< Bit n set: a dead cell with n live neighbours comes alive
+    u16 survival{}; ///< Bit n set: a live cell with n live neighbours stays alive
+
+    /**
+     * @brief               Parse a rule in B/S notation, eg "B3/S23" for Conway's Life
+     *
+     * @param  rule         Case insensitive, the survival part may be empty as in "B2/S"
+     */
+    [[nodiscard]] static auto from_string(std::string_view rule) -> Result<LifeRule>;
+};
+
+namespace life_rules
+{
+inline constexpr auto conway    = LifeRule{0b1000, 0b1100};               // B3/S23
+inline constexpr auto highlife  = LifeRule{0b100'1000, 0b1100};           // B36/S23
+inline constexpr auto seeds     = LifeRule{0b100, 0};                     // B2/S
+inline constexpr auto day_night = LifeRule{0b1'1100'1000, 0b1'1101'1000}; // B3678/S34678
+} // namespace life_rules
+
+/**
+ * @brief               A Life-like cellular automaton packed 64 cells to a u64
+ *
+ * @details Neighbours are counted for a whole word at a time with a bit-sliced adder (SWAR), and
+ * the rule is applied with bitmasks, so the inner loop has no branches and vectorises. The grid is
+ * split into tiles of tile_words x tile_rows words, stepped in parallel into a second buffer.
+ * A tile is skipped, without being touched, if neither it nor any of its 8 neighbours changed in
+ * the previous generation. Cells outside the grid are always dead
+ */
+class CellularAutomaton
+{
+  public:
+    static constexpr auto tile_words = u64{4};  ///< Tile width in words (256 cells)
+    static constexpr auto tile_rows  = u64{64}; ///< Tile height in rows
+
+    LifeRule rule;
+
+    explicit CellularAutomaton(Dimensions dims, LifeRule rule_ = life_rules::conway);
+
+    [[nodiscard]] auto dims() const noexcept { return cell_dims; }
+
+    [[nodiscard]] auto generation() const noexcept { return generation_count; }
+
+    [[nodiscard]] auto get(Indices pos) const -> bool;
+
+    void set(Indices pos, bool alive = true);
+
+    void clear();
+
+    /**
+     * @brief               Set every cell alive with the given probability
+     */
+    void randomize(RandomGenerator& rng, f64 probability = 0.5);
+
+    /**
+     * @brief               Number of live cells
+     */
+    [[nodiscard]] auto population() const -> u64;
+
+    void step();
+
+    void step(ThreadPool& thread_pool);
+
+    /**
+     * @brief               Write the cells to an Image of the same dimensions
+     */
+    void render(Image& image,
+                Color alive             = colors::white,
+                Color dead              = colors::black,
+                ThreadPool* thread_pool = nullptr) const;
+
+    [[nodiscard]] auto to_image(Color alive = colors::white, Color dead = colors::black) const
+        -> Image;
+
+  private:
+    Dimensions cell_dims;
+    u64 words_per_row;
+    u64 stride; // words_per_row plus a dead word on either side
+    Dimensions tile_counts;
+    u64 last_word_mask;
+    u64 generation_count{};
+
+    // one dead row above and below, one dead word left and right of each row
+    std::vector<u64> current;
+    std::vector<u64> next;
+    std::vector<u8> changed;
+    std::vector<u8> changed_next;
+
+    [[nodiscard]] auto word_index(u64 row, u64 word) const noexcept
+    {
+        return (row + 1) * stride + word + 1;
+    }
+
+    [[nodiscard]] auto tile_index(Indices pos) const noexcept
+    {
+        return pos.y / tile_rows * tile_counts.x + pos.x / 64 / tile_words;
+    }
+
+    [[nodiscard]] auto needs_update(u64 tile_x, u64 tile_y) const -> bool;
+
+    void step_tile(u64 tile_x,
+                   u64 tile_y,
+                   const std::array<u64, 9>& birth_masks,
+                   const std::array<u64, 9>& survival_masks);
+
+    void step_impl(ThreadPool* thread_pool);
+};
+} // namespace sm
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_CELLULAR_AUTOMATON_IMPL)
+
+#include <algorithm> // for fill
+#include <bit>       // for popcount
+#include <cctype>    // for tolower
+#include <utility>   // for swap
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/math/loop.hpp"   // for start_end, end
+#include "samarium/math/math.hpp"   // for min
+#include "samarium/util/Error.hpp"  // for Error
+
+namespace sm
+{
+SM_INLINE auto LifeRule::from_string(std::string_view rule) -> Result<LifeRule>
+{
+    auto output  = LifeRule{};
+    u16* current = nullptr;
+
+    for (auto character : rule)
+    {
+        const auto lower = std::tolower(static_cast<unsigned char>(character));
+        if (lower == 'b') { current = &output.birth; }
+        else if (lower == 's') { current = &output.survival; }
+        else if (lower == '/') { current = nullptr; }
+        else if (current != nullptr && character >= '0' && character <= '8')
+        {
+            *current = static_cast<u16>(*current | (1U << (character - '0')));
+        }
+        else
+        {
+            return make_unexpected(
+                fmt::format("Invalid character '{}' in cellular automaton rule \"{}\"", character,
+                            rule));
+        }
+    }
+
+    return {output};
+}
+
+SM_INLINE CellularAutomaton::CellularAutomaton(Dimensions dims, LifeRule rule_)
+    : rule{rule_}, cell_dims{dims}, words_per_row{(dims.x + 63) / 64}, stride{words_per_row + 2},
+      tile_counts{(words_per_row + tile_words - 1) / tile_words,
+                  (dims.y + tile_rows - 1) / tile_rows},
+      last_word_mask{dims.x % 64 == 0 ? ~u64{} : (u64{1} << (dims.x % 64)) - 1},
+      current(stride * (dims.y + 2)), next(stride * (dims.y + 2)),
+      changed(tile_counts.x * tile_counts.y), changed_next(tile_counts.x * tile_counts.y)
+{
+}
+
+SM_INLINE auto CellularAutomaton::get(Indices pos) const -> bool
+{
+    return ((current[word_index(pos.y, pos.x / 64)] >> (pos.x % 64)) & u64{1}) != 0;
+}
+
+SM_INLINE void CellularAutomaton::set(Indices pos, bool alive)
+{
+    auto& word     = current[word_index(pos.y, pos.x / 64)];
+    const auto bit = u64{1} << (pos.x % 64);
+    word           = alive ? (word | bit) : (word & ~bit);
+
+    changed[tile_index(pos)] = 1;
+}
+
+SM_INLINE void CellularAutomaton::clear()
+{
+    std::fill(current.begin(), current.end(), u64{});
+    std::fill(next.begin(), next.end(), u64{});
+    std::fill(changed.begin(), changed.end(), u8{});
+}
+
+SM_INLINE void CellularAutomaton::randomize(RandomGenerator& rng, f64 probability)
+{
+    for (auto y : loop::end(cell_dims.y))
+    {
+        for (auto w : loop::end(words_per_row))
+        {
+            auto word = u64{};
+            for (auto bit : loop::end(u64{64}))
+            {
+                if (rng.random() < probability) { word |= u64{1} << bit; }
+            }
+            current[word_index(y, w)] = w + 1 == words_per_row ? word & last_word_mask : word;
+        }
+    }
+    std::fill(changed.begin(), changed.end(), u8{1});
+}
+
+SM_INLINE auto CellularAutomaton::population() const -> u64
+{
+    auto count = u64{};
+    for (auto word : current) { count += static_cast<u64>(std::popcount(word)); }
+    return count;
+}
+
+SM_INLINE void CellularAutomaton::step() { step_impl(nullptr); }
+
+SM_INLINE void CellularAutomaton::step(ThreadPool& thread_pool) { step_impl(&thread_pool); }
+
+SM_INLINE auto CellularAutomaton::needs_update(u64 tile_x, u64 tile_y) const -> bool
+{
+    const auto x_min = tile_x == 0 ? 0 : tile_x - 1;
+    const auto y_min = tile_y == 0 ? 0 : tile_y - 1;
+    const auto x_max = math::min(tile_x + 2, tile_counts.x);
+    const auto y_max = math::min(tile_y + 2, tile_counts.y);
+
+    for (auto y : loop::start_end(y_min, y_max))
+    {
+        for (auto x : loop::start_end(x_min, x_max))
+        {
+            if (changed[y * tile_counts.x + x] != 0) { return true; }
+        }
+    }
+    return false;
+}
+
+SM_INLINE void CellularAutomaton::step_tile(u64 tile_x,
+                                            u64 tile_y,
+                                            const std::array<u64, 9>& birth_masks,
+                                            const std::array<u64, 9>& survival_masks)
+{
+    const auto word_min = tile_x * tile_words;
+    const auto word_max = math::min(word_min + tile_words, words_per_row);
+    const auto row_min  = tile_y * tile_rows;
+    const auto row_max  = math::min(row_min + tile_rows, cell_dims.y);
+
+    auto difference = u64{};
+    for (auto row : loop::start_end(row_min, row_max))
+    {
+        // rows start at their dead left padding word, so word w of the row is at w + 1
+        const auto* above = &current[(row + 0) * stride];
+        const auto* mid   = &current[(row + 1) * stride];
+        const auto* below = &current[(row + 2) * stride];
+        auto* output      = &next[(row + 1) * stride];
+
+        // bit i of a word is column 64 * w + i, so shifting left brings in the left neighbour
+        for (auto w : loop::start_end(word_min, word_max))
+        {
+            const auto a0 = (above[w + 1] << 1) | (above[w] >> 63);
+            const auto a1 = above[w + 1];
+            const auto a2 = (above[w + 1] >> 1) | (above[w + 2] << 63);
+            const auto m0 = (mid[w + 1] << 1) | (mid[w] >> 63);
+            const auto m2 = (mid[w + 1] >> 1) | (mid[w + 2] << 63);
+            const auto b0 = (below[w + 1] << 1) | (below[w] >> 63);
+            const auto b1 = below[w + 1];
+            const auto b2 = (below[w + 1] >> 1) | (below[w + 2] << 63);
+
+            // bit-sliced sum of the 8 neighbours into count0 + 2 count1 + 4 count2 + 8 count3
+            const auto s0 = a0 ^ a1 ^ a2;
+            const auto c0 = (a0 & a1) | (a2 & (a0 ^ a1));
+            const auto s1 = m0 ^ m2 ^ b0;
+            const auto c1 = (m0 & m2) | (b0 & (m0 ^ m2));
+            const auto s2 = b1 ^ b2;
+            const auto c2 = b1 & b2;
+
+            const auto count0 = s0 ^ s1 ^ s2;
+            const auto c3     = (s0 & s1) | (s2 & (s0 ^ s1));
+
+            const auto t0     = c0 ^ c1 ^ c2;
+            const auto t1     = (c0 & c1) | (c2 & (c0 ^ c1));
+            const auto count1 = t0 ^ c3;
+            const auto t2     = t0 & c3;
+            const auto count2 = t1 ^ t2;
+            const auto count3 = t1 & t2;
+
+            auto births    = u64{};
+            auto survivals = u64{};
+            for (auto n : loop::end(u64{9}))
+            {
+                const auto equal = ((n & 1) != 0 ? count0 : ~count0) &
+                                   ((n & 2) != 0 ? count1 : ~count1) &
+                                   ((n & 4) != 0 ? count2 : ~count2) &
+                                   ((n & 8) != 0 ? count3 : ~count3);
+                births |= equal & birth_masks[n];
+                survivals |= equal & survival_masks[n];
+            }
+
+            const auto center = mid[w + 1];
+            auto result       = (center & survivals) | (~center & births);
+            if (w + 1 == words_per_row) { result &= last_word_mask; }
+
+            difference |= result ^ center;
+            output[w + 1] = result;
+        }
+    }
+
+    changed_next[tile_y * tile_counts.x + tile_x] = difference != 0 ? 1 : 0;
+}
+
+SM_INLINE void CellularAutomaton::step_impl(ThreadPool* thread_pool)
+{
+    auto birth_masks    = std::array<u64, 9>{};
+    auto survival_masks = std::array<u64, 9>{};
+    for (auto n : loop::end(u64{9}))
+    {
+        birth_masks[n]    = ((rule.birth >> n) & 1U) != 0 ? ~u64{} : u64{};
+        survival_masks[n] = ((rule.survival >> n) & 1U) != 0 ? ~u64{} : u64{};
+    }
+
+    // An unchanged tile holds the same words in both buffers, so a skipped tile stays valid
+    parallelize_loop(thread_pool, tile_counts.y,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto tile_y : loop::start_end(min, max))
+                         {
+                             for (auto tile_x : loop::end(tile_counts.x))
+                             {
+                                 if (needs_update(tile_x, tile_y))
+                                 {
+                                     step_tile(tile_x, tile_y, birth_masks, survival_masks);
+                                 }
+                                 else { changed_next[tile_y * tile_counts.x + tile_x] = 0; }
+                             }
+                         }
+                     });
+
+    std::swap(current, next);
+    std::swap(changed, changed_next);
+    generation_count++;
+}
+
+SM_INLINE void CellularAutomaton::render(Image& image,
+                                         Color alive,
+                                         Color dead,
+                                         ThreadPool* thread_pool) const
+{
+    if (image.dims != cell_dims)
+    {
+        throw Error{fmt::format("CellularAutomaton::render: image is {}x{}, expected {}x{}",
+                                image.dims.x, image.dims.y, cell_dims.x, cell_dims.y)};
+    }
+
+    parallelize_loop(thread_pool, cell_dims.y,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             const auto* row = &current[word_index(y, 0)];
+                             auto* pixels    = &image[{0, y}];
+                             for (auto x : loop::end(cell_dims.x))
+                             {
+                                 const auto bit = (row[x / 64] >> (x % 64)) & u64{1};
+                                 pixels[x]      = bit != 0 ? alive : dead;
+                             }
+                         }
+                     });
+}
+
+SM_INLINE auto CellularAutomaton::to_image(Color alive, Color dead) const -> Image
+{
+    auto image = Image{cell_dims};
+    render(image, alive, dead);
+    return image;
+}
+} // namespace sm
+
+#endif
@@ -0,0 +1,380 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <span> // for span
+
+#include "samarium/core/types.hpp"      // for f64, u64
+#include "samarium/math/Multigrid.hpp"  // for Multigrid
+#include "samarium/math/Vector2.hpp"    // for Vector2, Dimensions
+#include "samarium/math/interp.hpp"     // for clamp
+#include "samarium/util/Grid.hpp"       // for VectorField, ScalarField
+#include "samarium/util/ThreadPool.hpp" // for ThreadPool, parallelize_loop
+
+namespace sm
+{
+namespace detail
+{
+/**
+ * @brief               Bilinearly interpolate a Grid whose cell centres lie on integer coordinates
+ *
+ * @param  grid
+ * @param  pos          Position in cells, clamped to the grid
+ */
+template <typename T, typename Layout>
+[[nodiscard]] auto sample_bilinear(const Grid<T, Layout>& grid, Vector2 pos)
+{
+    const auto x = interp::clamp(pos.x, {0.0, static_cast<f64>(grid.dims.x - 1)});
+    const auto y = interp::clamp(pos.y, {0.0, static_cast<f64>(grid.dims.y - 1)});
+
+    const auto x0 = static_cast<u64>(x);
+    const auto y0 = static_cast<u64>(y);
+    const auto x1 = math::min(x0 + 1, grid.dims.x - 1);
+    const auto y1 = math::min(y0 + 1, grid.dims.y - 1);
+    const auto fx = x - static_cast<f64>(x0);
+    const auto fy = y - static_cast<f64>(y0);
+
+    const auto top    = grid[{x0, y0}] * (1.0 - fx) + grid[{x1, y0}] * fx;
+    const auto bottom = grid[{x0, y1}] * (1.0 - fx) + grid[{x1, y1}] * fx;
+    return top * (1.0 - fy) + bottom * fy;
+}
+} // namespace detail
+
+/**
+ * @brief               An incompressible fluid on a grid, after Jos Stam's "Stable Fluids"
+ *
+ * @details Positions and velocities are measured in cells: a velocity of {1, 0} moves one cell to
+ * the right per unit time. Each update implicitly diffuses the velocity, advects it through itself
+ * (semi-Lagrangian, RK2 backtrace), projects it to be divergence-free with a multigrid pressure
+ * solve, then diffuses and advects the density. Every pass is split into row blocks when given a
+ * ThreadPool. The borders of the grid are closed walls
+ */
+struct Fluid
+{
+    struct Config
+    {
+        f64 viscosity{};   ///< Kinematic viscosity, in cells^2 per unit time
+        f64 diffusion{};   ///< Diffusion rate of density, in cells^2 per unit time
+        f64 dissipation{}; ///< Fraction of density lost per unit time
+        Multigrid<f64>::Config pressure_solver{};
+        Multigrid<f64>::Config diffusion_solver{.cycles = 1};
+    };
+
+    Config config;
+    VectorField velocity;
+    ScalarField density;
+    ScalarField pressure;
+
+    explicit Fluid(Dimensions dims);
+
+    Fluid(Dimensions dims, const Config& config_);
+
+    [[nodiscard]] auto dims() const noexcept { return velocity.dims; }
+
+    /**
+     * @brief               Add velocity with a gaussian falloff around pos
+     *
+     * @param  pos          Centre, in cells
+     * @param  amount       Velocity added at the centre
+     * @param  radius       Standard radius of the falloff, in cells
+     */
+    void add_velocity(Vector2 pos, Vector2 amount, f64 radius = 1.0);
+
+    /**
+     * @brief               Add density with a gaussian falloff around pos
+     *
+     * @param  pos          Centre, in cells
+     * @param  amount       Density added at the centre
+     * @param  radius       Standard radius of the falloff, in cells
+     */
+    void add_density(Vector2 pos, f64 amount, f64 radius = 1.0);
+
+    [[nodiscard]] auto sample_velocity(Vector2 pos) const -> Vector2;
+
+    [[nodiscard]] auto sample_density(Vector2 pos) const -> f64;
+
+    void update(f64 time_delta = 1.0);
+
+    void update(ThreadPool& thread_pool, f64 time_delta = 1.0);
+
+    /**
+     * @brief               Move particles (positions in cells) along the velocity field
+     *
+     * @param  particles    Anything with a `pos` member, eg Particle
+     * @param  time_delta
+     */
+    template <typename Particle_t>
+    void advect(std::span<Particle_t> particles, f64 time_delta = 1.0) const
+    {
+        advect_impl(nullptr, particles, time_delta);
+    }
+
+    template <typename Particle_t>
+    void advect(ThreadPool& thread_pool, std::span<Particle_t> particles, f64 time_delta = 1.0) const
+    {
+        advect_impl(&thread_pool, particles, time_delta);
+    }
+
+  private:
+    VectorField velocity_scratch;
+    ScalarField density_scratch;
+    ScalarField divergence;
+    Multigrid<f64> pressure_solver;
+    Multigrid<Vector2> velocity_solver;
+    Multigrid<f64> density_solver;
+
+    void step(ThreadPool* thread_pool, f64 time_delta);
+
+    void advect_velocity(ThreadPool* thread_pool, f64 time_delta);
+
+    void advect_density(ThreadPool* thread_pool, f64 time_delta);
+
+    void project(ThreadPool* thread_pool);
+
+    void diffuse_velocity(ThreadPool* thread_pool, f64 time_delta);
+
+    void diffuse_density(ThreadPool* thread_pool, f64 time_delta);
+
+    [[nodiscard]] auto backtrace(Vector2 pos, f64 time_delta) const -> Vector2;
+
+    template <typename Particle_t>
+    void advect_impl(ThreadPool* thread_pool, std::span<Particle_t> particles, f64 time_delta) const
+    {
+        parallelize_loop(thread_pool, particles.size(),
+                         [&](u64 min, u64 max)
+                         {
+                             for (auto i : loop::start_end(min, max))
+                             {
+                                 auto& particle = particles[i];
+                                 const auto pos = particle.pos.template cast<f64>();
+                                 const auto mid = pos + 0.5 * time_delta * sample_velocity(pos);
+                                 const auto new_pos = pos + time_delta * sample_velocity(mid);
+                                 particle.pos =
+                                     new_pos.template cast<typename decltype(particle.pos)::value_type>();
+                             }
+                         });
+    }
+};
+} // namespace sm
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_FLUID_IMPL)
+
+#include <cmath>   // for exp
+#include <utility> // for swap
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/math/loop.hpp"   // for start_end, end
+
+namespace sm
+{
+SM_INLINE Fluid::Fluid(Dimensions dims) : Fluid(dims, Config{}) {}
+
+SM_INLINE Fluid::Fluid(Dimensions dims, const Config& config_)
+    : config{config_}, velocity(dims), density(dims), pressure(dims), velocity_scratch(dims),
+      density_scratch(dims), divergence(dims), pressure_solver(dims, config.pressure_solver),
+      velocity_solver(dims,
+                      {config.diffusion_solver.cycles, config.diffusion_solver.smoothing_steps,
+                       config.diffusion_solver.coarse_steps, config.diffusion_solver.coarsest_size}),
+      density_solver(dims, config.diffusion_solver)
+{
+}
+
+SM_INLINE void Fluid::add_velocity(Vector2 pos, Vector2 amount, f64 radius)
+{
+    const auto extent = 2.0 * radius;
+    const auto x_min  = static_cast<u64>(interp::clamp(pos.x - extent, {0.0, f64(dims().x - 1)}));
+    const auto x_max  = static_cast<u64>(interp::clamp(pos.x + extent, {0.0, f64(dims().x - 1)}));
+    const auto y_min  = static_cast<u64>(interp::clamp(pos.y - extent, {0.0, f64(dims().y - 1)}));
+    const auto y_max  = static_cast<u64>(interp::clamp(pos.y + extent, {0.0, f64(dims().y - 1)}));
+
+    for (auto y : loop::start_end(y_min, y_max + 1))
+    {
+        for (auto x : loop::start_end(x_min, x_max + 1))
+        {
+            const auto distance_sq = (Indices{x, y}.cast<f64>() - pos).length_sq();
+            velocity[{x, y}] += amount * std::exp(-distance_sq / (radius * radius));
+        }
+    }
+}
+
+SM_INLINE void Fluid::add_density(Vector2 pos, f64 amount, f64 radius)
+{
+    const auto extent = 2.0 * radius;
+    const auto x_min  = static_cast<u64>(interp::clamp(pos.x - extent, {0.0, f64(dims().x - 1)}));
+    const auto x_max  = static_cast<u64>(interp::clamp(pos.x + extent, {0.0, f64(dims().x - 1)}));
+    const auto y_min  = static_cast<u64>(interp::clamp(pos.y - extent, {0.0, f64(dims().y - 1)}));
+    const auto y_max  = static_cast<u64>(interp::clamp(pos.y + extent, {0.0, f64(dims().y - 1)}));
+
+    for (auto y : loop::start_end(y_min, y_max + 1))
+    {
+        for (auto x : loop::start_end(x_min, x_max + 1))
+        {
+            const auto distance_sq = (Indices{x, y}.cast<f64>() - pos).length_sq();
+            density[{x, y}] += amount * std::exp(-distance_sq / (radius * radius));
+        }
+    }
+}
+
+SM_INLINE auto Fluid::sample_velocity(Vector2 pos) const -> Vector2
+{
+    return detail::sample_bilinear(velocity, pos);
+}
+
+SM_INLINE auto Fluid::sample_density(Vector2 pos) const -> f64
+{
+    return detail::sample_bilinear(density, pos);
+}
+
+SM_INLINE void Fluid::update(f64 time_delta) { step(nullptr, time_delta); }
+
+SM_INLINE void Fluid::update(ThreadPool& thread_pool, f64 time_delta)
+{
+    step(&thread_pool, time_delta);
+}
+
+SM_INLINE void Fluid::step(ThreadPool* thread_pool, f64 time_delta)
+{
+    diffuse_velocity(thread_pool, time_delta);
+    advect_velocity(thread_pool, time_delta);
+    project(thread_pool);
+
+    diffuse_density(thread_pool, time_delta);
+    advect_density(thread_pool, time_delta);
+}
+
+SM_INLINE auto Fluid::backtrace(Vector2 pos, f64 time_delta) const -> Vector2
+{
+    const auto mid = pos - 0.5 * time_delta * sample_velocity(pos);
+    return pos - time_delta * sample_velocity(mid);
+}
+
+SM_INLINE void Fluid::advect_velocity(ThreadPool* thread_pool, f64 time_delta)
+{
+    parallelize_loop(thread_pool, dims().y,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             for (auto x : loop::end(dims().x))
+                             {
+                                 const auto from = backtrace(Indices{x, y}.cast<f64>(), time_delta);
+                                 velocity_scratch[{x, y}] = sample_velocity(from);
+                             }
+                         }
+                     });
+
+    std::swap(velocity.elements, velocity_scratch.elements);
+}
+
+SM_INLINE void Fluid::advect_density(ThreadPool* thread_pool, f64 time_delta)
+{
+    const auto retained = math::max(0.0, 1.0 - config.dissipation * time_delta);
+
+    parallelize_loop(thread_pool, dims().y,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             for (auto x : loop::end(dims().x))
+                             {
+                                 const auto from = backtrace(Indices{x, y}.cast<f64>(), time_delta);
+                                 density_scratch[{x, y}] = retained * sample_density(from);
+                             }
+                         }
+                     });
+
+    std::swap(density.elements, density_scratch.elements);
+}
+
+SM_INLINE void Fluid::project(ThreadPool* thread_pool)
+{
+    const auto [width, height] = dims();
+
+    // walls have zero normal velocity, so out of bounds neighbours contribute nothing
+    parallelize_loop(thread_pool, height,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             for (auto x : loop::end(width))
+                             {
+                                 const auto right  = x + 1 < width ? velocity[{x + 1, y}].x : 0.0;
+                                 const auto left   = x > 0 ? velocity[{x - 1, y}].x : 0.0;
+                                 const auto bottom = y + 1 < height ? velocity[{x, y + 1}].y : 0.0;
+                                 const auto top    = y > 0 ? velocity[{x, y - 1}].y : 0.0;
+
+                                 // solve -laplacian(p) = -div(v)
+                                 divergence[{x, y}] = -0.5 * (right - left + bottom - top);
+                             }
+                         }
+                     });
+
+    // the previous pressure is a good initial guess
+    pressure_solver.solve(pressure, divergence, 0.0, thread_pool);
+
+    parallelize_loop(thread_pool, height,
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto y : loop::start_end(min, max))
+                         {
+                             for (auto x : loop::end(width))
+                             {
+                                 const auto center = pressure[{x, y}];
+                                 const auto right  = x + 1 < width ? pressure[{x + 1, y}] : center;
+                                 const auto left   = x > 0 ? pressure[{x - 1, y}] : center;
+                                 const auto bottom = y + 1 < height ? pressure[{x, y + 1}] : center;
+                                 const auto top    = y > 0 ? pressure[{x, y - 1}] : center;
+
+                                 auto& vel = velocity[{x, y}];
+                                 vel -= 0.5 * Vector2{right - left, bottom - top};
+
+                                 if (x == 0 || x + 1 == width) { vel.x = 0.0; }
+                                 if (y == 0 || y + 1 == height) { vel.y = 0.0; }
+                             }
+                         }
+                     });
+}
+
+SM_INLINE void Fluid::diffuse_velocity(ThreadPool* thread_pool, f64 time_delta)
+{
+    if (config.viscosity <= 0.0) { return; }
+
+    // implicit step: (1 / (nu dt) - laplacian) v = v0 / (nu dt)
+    const auto diagonal = 1.0 / (config.viscosity * time_delta);
+    parallelize_loop(thread_pool, velocity.size(),
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto i : loop::start_end(min, max))
+                         {
+                             velocity_scratch[i] = velocity[i] * diagonal;
+                         }
+                     });
+
+    velocity_solver.solve(velocity, velocity_scratch, diagonal, thread_pool);
+}
+
+SM_INLINE void Fluid::diffuse_density(ThreadPool* thread_pool, f64 time_delta)
+{
+    if (config.diffusion <= 0.0) { return; }
+
+    const auto diagonal = 1.0 / (config.diffusion * time_delta);
+    parallelize_loop(thread_pool, density.size(),
+                     [&](u64 min, u64 max)
+                     {
+                         for (auto i : loop::start_end(min, max))
+                         {
+                             density_scratch[i] = density[i] * diagonal;
+                         }
+                     });
+
+    density_solver.solve(density, density_scratch, diagonal, thread_pool);
+}
+} // namespace sm
+
+#endif
@@ -9,7 +9,7 @@
 
 #include "fmt/format.h" // for to_string
 
-#include "samarium/gl/Shader.hpp"           // for ComputeShader
+#include "samarium/gl/Shader.hpp"           // for ComputeShader, ProgramCache
 #include "samarium/gui/Window.hpp"          // for Window
 #include "samarium/math/vector_math.hpp"    // for regular_polygon_points
 #include "samarium/physics/Particle.hpp"    // for Particle
@@ -36,9 +36,11 @@ struct ParticleSystem
 
     explicit ParticleSystem(i32 size,
                             const Particle<f32>& default_particle = {},
-                            i32 compute_shader_local_size         = 16)
+                            i32 compute_shader_local_size         = 16,
+                            gl::ProgramCache* program_cache       = nullptr)
         : particles{size, default_particle}, shader_local_size{compute_shader_local_size},
-          shaders{.update{Shaders::update_src, shader_local_size}}
+          shaders{.update = gl::ComputeShader{Shaders::update_src, shader_local_size, 1, 1,
+                                              program_cache}}
     {
     }
 
@@ -54,20 +56,19 @@ struct ParticleSystem
 
     void draw(Window& window, Color color, f32 scale = 1.0F, u32 point_count = 16)
     {
+        window.context.flush();
+
         const auto points = math::regular_polygon_points<f32>(point_count, {{}, 1.0F});
 
-        const auto& shader = window.context.shaders.at("particles");
+        const auto& shader = window.context.shader("particles");
         window.context.set_active(shader);
         shader.set("scale", scale);
         shader.set("view", window.view);
         shader.set("color", color);
 
-        const auto& buffer = window.context.vertex_buffers.at("default");
-
         auto& vao = window.context.vertex_arrays.at("Pos");
         window.context.set_active(vao);
-        buffer.set_data(points);
-        vao.bind(buffer, sizeof(Vector2_t<f32>));
+        vao.bind(window.context.stream_buffer.upload(points), sizeof(Vector2_t<f32>));
 
         glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, static_cast<i32>(points.size()),
                               static_cast<i32>(particles.data.size()));
@@ -10,7 +10,6 @@ void update(inout Particle particle) {
     particle.pos += particle.vel * delta_time;
 }
 
-layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
 void main() {
   uint index = gl_GlobalInvocationID.x;
 
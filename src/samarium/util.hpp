@@ -7,17 +7,24 @@
 
 #pragma once
 
+#include "samarium/util/AssetIndex.hpp"
 #include "samarium/util/Error.hpp"
+#include "samarium/util/FieldSeries.hpp"
+#include "samarium/util/FrameRecorder.hpp"
 #include "samarium/util/FunctionRef.hpp"
 #include "samarium/util/Grid.hpp"
+#include "samarium/util/GridLayout.hpp"
 #include "samarium/util/HashGrid.hpp"
+#include "samarium/util/MappedFile.hpp"
 #include "samarium/util/RandomGenerator.hpp"
 #include "samarium/util/Result.hpp"
 #include "samarium/util/SmallVector.hpp"
 #include "samarium/util/SourceLocation.hpp"
 #include "samarium/util/StaticVector.hpp"
 #include "samarium/util/Stopwatch.hpp"
+#include "samarium/util/VideoWriter.hpp"
 #include "samarium/util/byte_size.hpp"
+#include "samarium/util/deflate.hpp"
 #include "samarium/util/file.hpp"
 #include "samarium/util/format.hpp"
 #include "samarium/util/noise.hpp"
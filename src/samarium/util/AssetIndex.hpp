@@ -0,0 +1,533 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <span>    // for span
+#include <string>  // for string
+#include <utility> // for pair
+#include <vector>  // for vector
+
+#include "samarium/core/types.hpp" // for u64, i64
+
+#include "Result.hpp"     // for Result
+#include "ThreadPool.hpp" // for ThreadPool
+#include "file.hpp"       // for Path
+#include "unordered.hpp"  // for Map
+
+namespace sm::file
+{
+/**
+ * @brief Map file names to the paths of every file with that name under some root directories,
+ * so that repeated lookups (eg of fonts and assets at startup) don't each walk the tree like
+ * find() does
+ *
+ * @code
+ * auto assets     = file::AssetIndex::cached({"assets", "/usr/share/fonts"}, ".asset_index");
+ * const auto font = assets.find("RobotoMono-Regular.ttf");
+ * @endcode
+ *
+ * @details The modification time of every directory is recorded while walking, as it changes
+ * whenever an entry is added, removed or renamed. So update() only re-walks the roots that
+ * changed, and a cache file can be checked with one stat per directory instead of a full walk
+ */
+class AssetIndex
+{
+  public:
+    /**
+     * @brief               Walk every root. The directories at the top of each root are walked as
+     * separate tasks on thread_pool, if given
+     */
+    explicit AssetIndex(const std::vector<Path>& root_paths, ThreadPool* thread_pool = nullptr);
+
+    AssetIndex(AssetIndex&& other) noexcept;
+    auto operator=(AssetIndex&& other) noexcept -> AssetIndex&;
+    AssetIndex(const AssetIndex&)                    = delete;
+    auto operator=(const AssetIndex&) -> AssetIndex& = delete;
+
+    ~AssetIndex();
+
+    /**
+     * @brief               Load the index from cache_path, re-walking any root that changed since
+     * it was saved. If there is no valid cache for root_paths, walk them all. The cache is saved
+     * again if anything changed
+     */
+    [[nodiscard]] static auto cached(const std::vector<Path>& root_paths,
+                                     const Path& cache_path,
+                                     ThreadPool* thread_pool = nullptr) -> AssetIndex;
+
+    [[nodiscard]] static auto load(const Path& cache_path) -> Result<AssetIndex>;
+
+    auto save(const Path& cache_path) const -> Result<void>;
+
+    /**
+     * @brief               The first file called file_name, in the order of the roots and then of
+     * the paths under each root
+     */
+    [[nodiscard]] auto find(const std::string& file_name) const -> Result<Path>;
+
+    /**
+     * @brief               Every file called file_name. Invalidated by update()
+     */
+    [[nodiscard]] auto find_all(const std::string& file_name) const -> std::span<const Path>;
+
+    [[nodiscard]] auto file_count() const -> u64;
+
+    /**
+     * @brief               Watch every indexed directory with inotify, so that update() doesn't
+     * have to check modification times. Only available on Linux
+     */
+    auto watch() -> Result<void>;
+
+    /**
+     * @brief               Re-walk roots which changed: those with inotify events if watching,
+     * otherwise those with a directory whose modification time changed
+     *
+     * @return              Whether anything was re-walked
+     */
+    auto update(ThreadPool* thread_pool = nullptr) -> bool;
+
+  private:
+    struct Root
+    {
+        Path path;
+        std::vector<Path> files{};
+        std::vector<std::pair<Path, i64>> directories{}; // with their modification times
+        bool stale{};
+    };
+
+    std::vector<Root> roots{};
+    Map<std::string, std::vector<Path>> paths_by_name{};
+    int inotify_fd{-1};
+    Map<int, u64> watched_roots{}; // watch descriptor to index in roots
+
+    AssetIndex() = default;
+
+    void rebuild_map();
+
+    void watch_root(u64 index);
+};
+} // namespace sm::file
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_ASSET_INDEX_IMPL)
+
+#include <algorithm>    // for sort, equal
+#include <array>        // for array
+#include <charconv>     // for from_chars
+#include <filesystem>   // for directory_iterator, recursive_directory_iterator
+#include <fstream>      // for ifstream, ofstream
+#include <optional>     // for optional
+#include <string_view>  // for string_view
+#include <system_error> // for error_code
+#include <utility>      // for exchange, swap
+
+#if defined(__linux__)
+#include <sys/inotify.h> // for inotify_init1, inotify_add_watch, inotify_event
+#include <unistd.h>      // for read, close
+#endif
+
+#include "fmt/format.h" // for format
+#include "fmt/std.h"    // for formatter<std::filesystem::path>
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/math/loop.hpp"   // for end, start_end
+
+namespace sm::file
+{
+namespace detail
+{
+constexpr auto asset_index_version = "samarium asset index 2";
+
+// the index is one path per line, so line breaks (and the escape character) are percent-encoded
+inline auto escape_path(const Path& path)
+{
+    auto escaped = std::string{};
+    for (auto character : path.string())
+    {
+        if (character == '%') { escaped += "%25"; }
+        else if (character == '\n') { escaped += "%0A"; }
+        else if (character == '\r') { escaped += "%0D"; }
+        else { escaped += character; }
+    }
+    return escaped;
+}
+
+inline auto unescape_path(std::string_view escaped) -> std::optional<Path>
+{
+    auto path = std::string{};
+    for (auto i = u64{}; i < escaped.size(); i++)
+    {
+        if (escaped[i] != '%')
+        {
+            path += escaped[i];
+            continue;
+        }
+
+        const auto code = escaped.substr(i + 1, 2);
+        if (code == "25") { path += '%'; }
+        else if (code == "0A") { path += '\n'; }
+        else if (code == "0D") { path += '\r'; }
+        else { return std::nullopt; }
+        i += 2;
+    }
+    return {Path{path}};
+}
+
+// -1 if path doesn't exist
+inline auto modification_time(const Path& path) -> i64
+{
+    auto error      = std::error_code{};
+    const auto time = std::filesystem::last_write_time(path, error);
+    return error ? -1 : static_cast<i64>(time.time_since_epoch().count());
+}
+
+// append every file and directory under directory
+inline void walk_directory(const Path& directory,
+                           std::vector<Path>& files,
+                           std::vector<std::pair<Path, i64>>& directories)
+{
+    directories.emplace_back(directory, modification_time(directory));
+
+    auto error    = std::error_code{};
+    auto iterator = std::filesystem::recursive_directory_iterator{
+        directory, std::filesystem::directory_options::skip_permission_denied, error};
+    for (; !error && iterator != std::filesystem::recursive_directory_iterator{};
+         iterator.increment(error))
+    {
+        const auto& entry = *iterator;
+        auto entry_error  = std::error_code{};
+        if (entry.is_symlink(entry_error)) { continue; } // not followed, as they may cycle
+        if (entry.is_directory(entry_error))
+        {
+            directories.emplace_back(entry.path(), modification_time(entry.path()));
+        }
+        else if (entry.is_regular_file(entry_error)) { files.push_back(entry.path()); }
+    }
+}
+} // namespace detail
+
+SM_INLINE AssetIndex::AssetIndex(const std::vector<Path>& root_paths, ThreadPool* thread_pool)
+{
+    for (const auto& path : root_paths)
+    {
+        auto error = std::error_code{};
+        auto root  = Root{std::filesystem::weakly_canonical(path, error)};
+        if (error) { root.path = path; }
+        root.stale = true;
+        roots.push_back(std::move(root));
+    }
+    update(thread_pool);
+}
+
+SM_INLINE AssetIndex::AssetIndex(AssetIndex&& other) noexcept
+    : roots{std::move(other.roots)}, paths_by_name{std::move(other.paths_by_name)},
+      inotify_fd{std::exchange(other.inotify_fd, -1)},
+      watched_roots{std::move(other.watched_roots)}
+{
+}
+
+SM_INLINE auto AssetIndex::operator=(AssetIndex&& other) noexcept -> AssetIndex&
+{
+    if (this != &other)
+    {
+        std::swap(roots, other.roots);
+        std::swap(paths_by_name, other.paths_by_name);
+        std::swap(inotify_fd, other.inotify_fd);
+        std::swap(watched_roots, other.watched_roots);
+    }
+    return *this;
+}
+
+SM_INLINE AssetIndex::~AssetIndex()
+{
+#if defined(__linux__)
+    if (inotify_fd >= 0) { ::close(inotify_fd); }
+#endif
+}
+
+SM_INLINE auto AssetIndex::cached(const std::vector<Path>& root_paths,
+                                  const Path& cache_path,
+                                  ThreadPool* thread_pool) -> AssetIndex
+{
+    auto index = AssetIndex{};
+    if (auto loaded = load(cache_path))
+    {
+        auto normalized = std::vector<Path>{};
+        for (const auto& path : root_paths)
+        {
+            auto error = std::error_code{};
+            auto root  = std::filesystem::weakly_canonical(path, error);
+            normalized.push_back(error ? path : root);
+        }
+
+        if (std::equal(normalized.begin(), normalized.end(), loaded->roots.begin(),
+                       loaded->roots.end(),
+                       [](const Path& path, const Root& root) { return path == root.path; }))
+        {
+            index = std::move(*loaded);
+            if (!index.update(thread_pool)) { return index; }
+            (void)index.save(cache_path);
+            return index;
+        }
+    }
+
+    index = AssetIndex{root_paths, thread_pool};
+    (void)index.save(cache_path);
+    return index;
+}
+
+SM_INLINE auto AssetIndex::load(const Path& cache_path) -> Result<AssetIndex>
+{
+    auto stream = std::ifstream{cache_path};
+    auto line   = std::string{};
+    if (!std::getline(stream, line) || line != detail::asset_index_version)
+    {
+        return make_unexpected(fmt::format("{} is not an asset index", cache_path));
+    }
+
+    const auto invalid = [&cache_path]
+    { return make_unexpected(fmt::format("{} is not a valid asset index", cache_path)); };
+
+    // "root <path>", then its "dir <time> <path>" and "file <path>" lines
+    auto index = AssetIndex{};
+    while (std::getline(stream, line))
+    {
+        const auto view = std::string_view{line};
+        if (view.starts_with("root "))
+        {
+            auto path = detail::unescape_path(view.substr(5));
+            if (!path) { return invalid(); }
+            index.roots.push_back(Root{std::move(*path)});
+            continue;
+        }
+        if (index.roots.empty()) { return invalid(); }
+
+        auto& root = index.roots.back();
+        if (view.starts_with("file "))
+        {
+            auto path = detail::unescape_path(view.substr(5));
+            if (!path) { return invalid(); }
+            root.files.push_back(std::move(*path));
+        }
+        else if (view.starts_with("dir "))
+        {
+            const auto* last = view.data() + view.size();
+            auto time        = i64{};
+
+            const auto [number_end, error] = std::from_chars(view.data() + 4, last, time);
+            if (error != std::errc{} || number_end == last || *number_end != ' ')
+            {
+                return invalid();
+            }
+
+            auto path =
+                detail::unescape_path(view.substr(static_cast<u64>(number_end - view.data()) + 1));
+            if (!path) { return invalid(); }
+            root.directories.emplace_back(std::move(*path), time);
+        }
+        else { return invalid(); }
+    }
+
+    if (!stream.eof()) { return invalid(); }
+
+    index.rebuild_map();
+    return {std::move(index)};
+}
+
+SM_INLINE auto AssetIndex::save(const Path& cache_path) const -> Result<void>
+{
+    // write next to it and rename, so a concurrent load never sees half a file
+    auto temporary_path = cache_path;
+    temporary_path += ".part";
+    {
+        auto stream = std::ofstream{temporary_path};
+        stream << detail::asset_index_version << '\n';
+        for (const auto& root : roots)
+        {
+            stream << "root " << detail::escape_path(root.path) << '\n';
+            for (const auto& [path, time] : root.directories)
+            {
+                stream << "dir " << time << ' ' << detail::escape_path(path) << '\n';
+            }
+            for (const auto& path : root.files)
+            {
+                stream << "file " << detail::escape_path(path) << '\n';
+            }
+        }
+        if (!stream) { return make_unexpected(fmt::format("could not write {}", temporary_path)); }
+    }
+
+    auto error = std::error_code{};
+    std::filesystem::rename(temporary_path, cache_path, error);
+    if (error) { return make_unexpected(fmt::format("could not write {}", cache_path)); }
+    return {};
+}
+
+SM_INLINE auto AssetIndex::find(const std::string& file_name) const -> Result<Path>
+{
+    const auto paths = find_all(file_name);
+    if (paths.empty()) { return make_unexpected(fmt::format("File not found: '{}'", file_name)); }
+    return {paths.front()};
+}
+
+SM_INLINE auto AssetIndex::find_all(const std::string& file_name) const -> std::span<const Path>
+{
+    const auto iterator = paths_by_name.find(file_name);
+    if (iterator == paths_by_name.end()) { return {}; }
+    return iterator->second;
+}
+
+SM_INLINE auto AssetIndex::file_count() const -> u64
+{
+    auto count = u64{};
+    for (const auto& root : roots) { count += root.files.size(); }
+    return count;
+}
+
+SM_INLINE auto AssetIndex::watch() -> Result<void>
+{
+#if defined(__linux__)
+    if (inotify_fd < 0)
+    {
+        inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) { return make_unexpected("AssetIndex: could not start inotify"); }
+    }
+    for (auto i : loop::end(roots.size())) { watch_root(i); }
+    return {};
+#else
+    return make_unexpected("AssetIndex: watch() needs inotify, update() checks modification times");
+#endif
+}
+
+SM_INLINE auto AssetIndex::update(ThreadPool* thread_pool) -> bool
+{
+#if defined(__linux__)
+    if (inotify_fd >= 0)
+    {
+        alignas(inotify_event) auto buffer = std::array<char, 16384>{};
+        for (auto size = ::read(inotify_fd, buffer.data(), buffer.size()); size > 0;
+             size      = ::read(inotify_fd, buffer.data(), buffer.size()))
+        {
+            for (auto offset = i64{}; offset < size;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                if ((event->mask & IN_Q_OVERFLOW) != 0)
+                {
+                    for (auto& root : roots) { root.stale = true; }
+                }
+                else if (const auto root = watched_roots.find(event->wd);
+                         root != watched_roots.end())
+                {
+                    roots[root->second].stale = true;
+                }
+                offset += static_cast<i64>(sizeof(inotify_event) + event->len);
+            }
+        }
+    }
+    else
+#endif
+    {
+        for (auto& root : roots)
+        {
+            for (const auto& [path, time] : root.directories)
+            {
+                if (root.stale || detail::modification_time(path) != time)
+                {
+                    root.stale = true;
+                    break;
+                }
+            }
+            if (root.directories.empty()) { root.stale = true; }
+        }
+    }
+
+    auto changed = false;
+    for (auto index : loop::end(roots.size()))
+    {
+        auto& root = roots[index];
+        if (!root.stale) { continue; }
+
+        root.files.clear();
+        root.directories.clear();
+        root.stale = false;
+        changed    = true;
+
+        // the top of the root on this thread, each directory in it as a task
+        auto error = std::error_code{};
+        root.directories.emplace_back(root.path, detail::modification_time(root.path));
+        auto subdirectories = std::vector<Path>{};
+        auto iterator = std::filesystem::directory_iterator{
+            root.path, std::filesystem::directory_options::skip_permission_denied, error};
+        for (; !error && iterator != std::filesystem::directory_iterator{};
+             iterator.increment(error))
+        {
+            const auto& entry = *iterator;
+            auto entry_error  = std::error_code{};
+            if (entry.is_symlink(entry_error)) { continue; }
+            if (entry.is_directory(entry_error)) { subdirectories.push_back(entry.path()); }
+            else if (entry.is_regular_file(entry_error)) { root.files.push_back(entry.path()); }
+        }
+
+        auto walked = std::vector<Root>(subdirectories.size());
+        parallelize_loop(
+            thread_pool, subdirectories.size(),
+            [&](u64 min, u64 max)
+            {
+                for (auto i : loop::start_end(min, max))
+                {
+                    detail::walk_directory(subdirectories[i], walked[i].files,
+                                           walked[i].directories);
+                }
+            },
+            4);
+
+        for (auto& part : walked)
+        {
+            root.files.insert(root.files.end(), std::make_move_iterator(part.files.begin()),
+                              std::make_move_iterator(part.files.end()));
+            root.directories.insert(root.directories.end(),
+                                    std::make_move_iterator(part.directories.begin()),
+                                    std::make_move_iterator(part.directories.end()));
+        }
+        std::sort(root.files.begin(), root.files.end());
+
+        if (inotify_fd >= 0) { watch_root(index); }
+    }
+
+    if (changed) { rebuild_map(); }
+    return changed;
+}
+
+SM_INLINE void AssetIndex::rebuild_map()
+{
+    paths_by_name.clear();
+    for (const auto& root : roots)
+    {
+        for (const auto& path : root.files)
+        {
+            paths_by_name[path.filename().string()].push_back(path);
+        }
+    }
+}
+
+SM_INLINE void AssetIndex::watch_root([[maybe_unused]] u64 index)
+{
+#if defined(__linux__)
+    // re-adding a watched directory returns its existing descriptor
+    constexpr auto events = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                            IN_MOVE_SELF | IN_ONLYDIR;
+    for (const auto& [path, time] : roots[index].directories)
+    {
+        const auto descriptor = ::inotify_add_watch(inotify_fd, path.c_str(), events);
+        if (descriptor >= 0) { watched_roots[descriptor] = index; }
+    }
+#endif
+}
+} // namespace sm::file
+
+#endif
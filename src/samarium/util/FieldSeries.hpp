@@ -0,0 +1,741 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <condition_variable> // for condition_variable
+#include <fstream>            // for ofstream
+#include <mutex>              // for mutex
+#include <span>               // for span
+#include <string>             // for string
+#include <type_traits>        // for is_same_v
+#include <vector>             // for vector
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/types.hpp"       // for u8, u64, f64
+#include "samarium/math/BoundingBox.hpp" // for BoundingBox
+#include "samarium/math/Vector2.hpp"     // for Dimensions, Vector2
+
+#include "Grid.hpp"       // for Grid, ScalarField, VectorField, default_tile_dims
+#include "MappedFile.hpp" // for MappedFile
+#include "Result.hpp"     // for Result
+#include "ThreadPool.hpp" // for ThreadPool
+#include "file.hpp"       // for Path
+
+namespace sm::file
+{
+/**
+ * @brief How FieldWriter stores each value
+ */
+enum class FieldPrecision
+{
+    F64, ///< Lossless
+    F32,
+    F16 ///< About 3 significant digits, for visualisation
+};
+
+/**
+ * @brief Record a time series of ScalarField or VectorField frames to a compact binary file
+ *
+ * @code
+ * auto writer = file::FieldWriter{"density.smf", fluid.density.dims, 1};
+ * while (simulating)
+ * {
+ *     fluid.update(dt);
+ *     writer.write(fluid.density); // returns once the field is copied
+ * }
+ * @endcode
+ *
+ * @details Each frame is split into tiles. A tile is quantized, XORed with the same tile of the
+ * previous frame (so slowly changing values become mostly zero bytes), split into byte planes
+ * and run-length encoded. Every keyframe_interval frames a tile is stored without the delta, which
+ * bounds the cost of seeking. Frames are encoded and written on a background thread. Read them
+ * back with FieldReader
+ */
+class FieldWriter
+{
+  public:
+    struct Config
+    {
+        FieldPrecision precision{FieldPrecision::F32};
+        Dimensions tile_dims{default_tile_dims};
+        u64 keyframe_interval{32}; ///< Frames from one full frame to the next
+        u64 capacity{4};           ///< Frames waiting to be written before write() blocks
+    };
+
+    /**
+     * @brief               Create (or truncate) file_path and write the header
+     *
+     * @param  file_path
+     * @param  dims         Dimensions of every frame
+     * @param  components   1 for ScalarField, 2 for VectorField
+     */
+    FieldWriter(const Path& file_path, Dimensions dims, u64 components);
+
+    FieldWriter(const Path& file_path, Dimensions dims, u64 components, const Config& config);
+
+    FieldWriter(const FieldWriter&)                    = delete;
+    auto operator=(const FieldWriter&) -> FieldWriter& = delete;
+
+    /**
+     * @brief               Waits for every frame to be written
+     */
+    ~FieldWriter();
+
+    /**
+     * @brief               Copy field and queue it to be written, blocking if capacity frames are
+     * already waiting
+     */
+    void write(const ScalarField& field);
+
+    void write(const VectorField& field);
+
+    /**
+     * @brief               Block until every frame is written
+     *
+     * @return              The first write error, if any
+     */
+    auto flush() -> Result<void>;
+
+    /**
+     * @brief               Frames written or waiting to be
+     */
+    [[nodiscard]] auto frame_count() const -> u64;
+
+  private:
+    std::ofstream stream;
+    Dimensions dims;
+    u64 components;
+    Config config;
+
+    // used only by the writing thread
+    std::vector<u8> previous{}; // quantized byte planes of the last frame, one tile after another
+    std::vector<u8> tile{};
+    std::vector<u8> record{};
+    u64 frames_encoded{};
+
+    mutable std::mutex mutex;
+    std::condition_variable frame_finished;
+    u64 frames_submitted{};
+    u64 queued{};
+    std::vector<std::vector<f64>> pool{};
+    std::string error{};
+
+    // one thread, so that frames are delta encoded and written in order. Last, so that it is
+    // joined before anything it uses is destroyed
+    ThreadPool thread_pool{1};
+
+    void submit(std::span<const f64> values, Dimensions field_dims, u64 field_components);
+
+    void encode(std::vector<f64>&& values);
+};
+
+/**
+ * @brief Read frames written by FieldWriter. The file is memory-mapped, so reading a region only
+ * touches the tiles it overlaps
+ */
+class FieldReader
+{
+  public:
+    [[nodiscard]] static auto open(const Path& file_path) -> Result<FieldReader>;
+
+    [[nodiscard]] auto dims() const -> Dimensions { return header.dims; }
+
+    [[nodiscard]] auto components() const -> u64 { return header.components; }
+
+    [[nodiscard]] auto precision() const -> FieldPrecision { return header.precision; }
+
+    /**
+     * @brief               Complete frames in the file (a frame still being written is skipped)
+     */
+    [[nodiscard]] auto frame_count() const -> u64 { return frame_offsets.size(); }
+
+    /**
+     * @brief               Read a whole frame as a ScalarField (T = f64) or VectorField (T =
+     * Vector2)
+     */
+    template <typename T> [[nodiscard]] auto read(u64 frame) const -> Result<Grid<T>>
+    {
+        return read<T>(frame, BoundingBox<u64>{{}, header.dims - Indices{1, 1}});
+    }
+
+    /**
+     * @brief               Read the elements of a frame within region (inclusive), decoding only
+     * the tiles it overlaps
+     */
+    template <typename T>
+    [[nodiscard]] auto read(u64 frame, BoundingBox<u64> region) const -> Result<Grid<T>>
+    {
+        static_assert(std::is_same_v<T, f64> || std::is_same_v<T, Vector2>,
+                      "FieldReader reads ScalarFields (f64) or VectorFields (Vector2)");
+
+        const auto requested_components = sizeof(T) / sizeof(f64);
+        if (requested_components != header.components)
+        {
+            return make_unexpected(fmt::format("FieldReader: file has {} components, not {}",
+                                               header.components, requested_components));
+        }
+        if (region.min.x > region.max.x || region.min.y > region.max.y ||
+            region.max.x >= header.dims.x || region.max.y >= header.dims.y)
+        {
+            return make_unexpected(fmt::format("FieldReader: region is outside {}", header.dims));
+        }
+
+        auto grid = Grid<T>{region.max - region.min + Indices{1, 1}};
+        const auto values =
+            std::span<f64>{reinterpret_cast<f64*>(grid.data()), grid.size() * header.components};
+
+        auto result = read_values(frame, region, values);
+        if (!result) { return make_unexpected(std::move(result.error())); }
+        return {std::move(grid)};
+    }
+
+  private:
+    struct Header
+    {
+        Dimensions dims{};
+        u64 components{};
+        FieldPrecision precision{};
+        Dimensions tile_dims{};
+        u64 keyframe_interval{};
+    };
+
+    MappedFile file;
+    Header header;
+    std::vector<u64> frame_offsets;
+
+    FieldReader(MappedFile&& file_, Header header_, std::vector<u64>&& frame_offsets_);
+
+    auto read_values(u64 frame, BoundingBox<u64> region, std::span<f64> values) const
+        -> Result<void>;
+};
+} // namespace sm::file
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_FIELD_SERIES_IMPL)
+
+#include <algorithm> // for min, max, copy
+#include <array>     // for array, to_array
+#include <bit>       // for bit_cast
+#include <cmath>     // for nearbyint
+#include <cstring>   // for memcpy, memset, memcmp
+
+#include "fmt/std.h" // for formatter<std::filesystem::path>
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/util/Error.hpp"  // for Error
+
+namespace sm::file
+{
+namespace detail
+{
+constexpr auto field_magic       = std::to_array<u8>({'S', 'M', 'F', 'I', 'E', 'L', 'D', '1'});
+constexpr auto field_frame_magic = std::to_array<u8>({'F', 'R', 'A', 'M'});
+constexpr auto field_header_size = u64{64};
+constexpr auto field_frame_size  = u64{16}; // magic, flags and record size, before the tile sizes
+constexpr auto min_zero_run      = u64{4};
+
+// all integers are little-endian
+inline void append_le(std::vector<u8>& bytes, u64 value, u64 size)
+{
+    for (auto i : loop::end(size)) { bytes.push_back(static_cast<u8>(255 & (value >> (8 * i)))); }
+}
+
+inline void write_le(u8* bytes, u64 value, u64 size)
+{
+    for (auto i : loop::end(size)) { bytes[i] = static_cast<u8>(255 & (value >> (8 * i))); }
+}
+
+inline auto read_le(const u8* bytes, u64 size)
+{
+    auto value = u64{};
+    for (auto i : loop::end(size)) { value |= u64{bytes[i]} << (8 * i); }
+    return value;
+}
+
+inline auto value_size(FieldPrecision precision) -> u64
+{
+    switch (precision)
+    {
+    case FieldPrecision::F64: return 8;
+    case FieldPrecision::F32: return 4;
+    case FieldPrecision::F16: return 2;
+    }
+    return 8;
+}
+
+// round to nearest even, like _cvtss_sh
+inline auto float_to_half(f32 value) -> u16
+{
+    const auto bits      = std::bit_cast<u32>(value);
+    const auto sign      = (bits >> 16) & 0x8000U;
+    auto magnitude       = bits & 0x7FFF'FFFFU;
+    const auto as_result = [sign](u32 half) { return static_cast<u16>(sign | half); };
+
+    if (magnitude >= 0x7F80'0000U) // infinity or NaN
+    {
+        return as_result(magnitude > 0x7F80'0000U ? 0x7E00U : 0x7C00U);
+    }
+    if (magnitude >= 0x477F'F000U) { return as_result(0x7C00U); } // rounds to infinity
+    if (magnitude < 0x3880'0000U) // subnormal: scale so the rounding happens at the integer
+    {
+        return as_result(
+            static_cast<u32>(std::nearbyint(std::bit_cast<f32>(magnitude) * 16777216.0F)));
+    }
+
+    // rebias the exponent from 127 to 15 and round away 13 mantissa bits
+    magnitude += 0xC800'0FFFU + ((magnitude >> 13) & 1U);
+    return as_result(magnitude >> 13);
+}
+
+inline auto half_to_float(u16 half) -> f32
+{
+    const auto sign     = static_cast<u32>(half & 0x8000U) << 16;
+    const auto exponent = (half >> 10) & 0x1FU;
+    const auto mantissa = half & 0x3FFU;
+
+    if (exponent == 0)
+    {
+        const auto magnitude = static_cast<f32>(mantissa) / 16777216.0F;
+        return std::bit_cast<f32>(sign | std::bit_cast<u32>(magnitude));
+    }
+    if (exponent == 31) { return std::bit_cast<f32>(sign | 0x7F80'0000U | (mantissa << 13)); }
+    return std::bit_cast<f32>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+inline auto quantize(f64 value, FieldPrecision precision) -> u64
+{
+    switch (precision)
+    {
+    case FieldPrecision::F64: return std::bit_cast<u64>(value);
+    case FieldPrecision::F32: return std::bit_cast<u32>(static_cast<f32>(value));
+    case FieldPrecision::F16: return float_to_half(static_cast<f32>(value));
+    }
+    return 0;
+}
+
+inline auto dequantize(u64 bits, FieldPrecision precision) -> f64
+{
+    switch (precision)
+    {
+    case FieldPrecision::F64: return std::bit_cast<f64>(bits);
+    case FieldPrecision::F32: return static_cast<f64>(std::bit_cast<f32>(static_cast<u32>(bits)));
+    case FieldPrecision::F16: return static_cast<f64>(half_to_float(static_cast<u16>(bits)));
+    }
+    return 0.0;
+}
+
+// runs of zero bytes become a count, everything else is copied. Each run starts with a varint of
+// (length << 1) | is_zero_run
+inline void compress_bytes(std::span<const u8> bytes, std::vector<u8>& out)
+{
+    const auto put_varint = [&out](u64 value)
+    {
+        for (; value >= 0x80; value >>= 7) { out.push_back(static_cast<u8>(value | 0x80)); }
+        out.push_back(static_cast<u8>(value));
+    };
+    const auto zero_run_at = [bytes](u64 index)
+    {
+        const auto end = std::min(index + min_zero_run, bytes.size());
+        for (auto i = index; i < end; i++)
+        {
+            if (bytes[i] != 0) { return false; }
+        }
+        return end - index == min_zero_run;
+    };
+
+    auto i = u64{};
+    while (i < bytes.size())
+    {
+        auto end = i;
+        if (zero_run_at(i))
+        {
+            while (end < bytes.size() && bytes[end] == 0) { end++; }
+            put_varint(((end - i) << 1) | 1);
+        }
+        else
+        {
+            while (end < bytes.size() && !(bytes[end] == 0 && zero_run_at(end))) { end++; }
+            put_varint((end - i) << 1);
+            out.insert(out.end(), bytes.begin() + static_cast<i64>(i),
+                       bytes.begin() + static_cast<i64>(end));
+        }
+        i = end;
+    }
+}
+
+// false if compressed is malformed or doesn't decode to exactly bytes.size() bytes
+inline auto decompress_bytes(std::span<const u8> compressed, std::span<u8> bytes) -> bool
+{
+    auto in  = u64{};
+    auto out = u64{};
+    while (in < compressed.size())
+    {
+        auto token = u64{};
+        for (u64 shift = 0;; shift += 7)
+        {
+            if (in == compressed.size() || shift > 56) { return false; }
+            const auto byte = compressed[in++];
+            token |= u64{byte & 0x7FU} << shift;
+            if ((byte & 0x80U) == 0) { break; }
+        }
+
+        const auto length = token >> 1;
+        if (length > bytes.size() - out) { return false; }
+        if ((token & 1) != 0) { std::memset(bytes.data() + out, 0, length); }
+        else
+        {
+            if (length > compressed.size() - in) { return false; }
+            std::memcpy(bytes.data() + out, compressed.data() + in, length);
+            in += length;
+        }
+        out += length;
+    }
+    return out == bytes.size();
+}
+
+struct FieldTile
+{
+    Indices min;
+    Dimensions dims;
+};
+
+inline auto field_tile(Dimensions dims, Dimensions tile_dims, Indices index) -> FieldTile
+{
+    const auto min = Indices{index.x * tile_dims.x, index.y * tile_dims.y};
+    return {min, {std::min(tile_dims.x, dims.x - min.x), std::min(tile_dims.y, dims.y - min.y)}};
+}
+
+inline auto tile_counts(Dimensions dims, Dimensions tile_dims) -> Dimensions
+{
+    return {(dims.x + tile_dims.x - 1) / tile_dims.x, (dims.y + tile_dims.y - 1) / tile_dims.y};
+}
+} // namespace detail
+
+SM_INLINE FieldWriter::FieldWriter(const Path& file_path, Dimensions dims_, u64 components_)
+    : FieldWriter(file_path, dims_, components_, Config{})
+{
+}
+
+SM_INLINE FieldWriter::FieldWriter(const Path& file_path,
+                                   Dimensions dims_,
+                                   u64 components_,
+                                   const Config& config_)
+    : stream{file_path, std::ios::binary}, dims{dims_}, components{components_}, config{config_}
+{
+    if (!stream) { throw Error{fmt::format("FieldWriter: could not open {}", file_path)}; }
+    if (dims.x == 0 || dims.y == 0 || config.tile_dims.x == 0 || config.tile_dims.y == 0 ||
+        (components != 1 && components != 2))
+    {
+        throw Error{fmt::format("FieldWriter: invalid dims {}, tile dims {} or components {}",
+                                dims, config.tile_dims, components)};
+    }
+    config.keyframe_interval = std::max(config.keyframe_interval, u64{1});
+    config.capacity          = std::max(config.capacity, u64{1});
+
+    auto header = std::vector<u8>(detail::field_magic.begin(), detail::field_magic.end());
+    detail::append_le(header, components, 4);
+    detail::append_le(header, detail::value_size(config.precision), 4);
+    detail::append_le(header, dims.x, 8);
+    detail::append_le(header, dims.y, 8);
+    detail::append_le(header, config.tile_dims.x, 8);
+    detail::append_le(header, config.tile_dims.y, 8);
+    detail::append_le(header, config.keyframe_interval, 8);
+    header.resize(detail::field_header_size);
+    stream.write(reinterpret_cast<const char*>(header.data()),
+                 static_cast<std::streamsize>(header.size()));
+
+    previous.resize(dims.x * dims.y * components * detail::value_size(config.precision));
+}
+
+SM_INLINE FieldWriter::~FieldWriter() { thread_pool.wait_for_tasks(); }
+
+SM_INLINE void FieldWriter::write(const ScalarField& field)
+{
+    submit({field.data(), field.size()}, field.dims, 1);
+}
+
+SM_INLINE void FieldWriter::write(const VectorField& field)
+{
+    static_assert(sizeof(Vector2) == 2 * sizeof(f64));
+    submit({reinterpret_cast<const f64*>(field.data()), 2 * field.size()}, field.dims, 2);
+}
+
+SM_INLINE auto FieldWriter::flush() -> Result<void>
+{
+    thread_pool.wait_for_tasks();
+
+    const auto lock = std::scoped_lock{mutex};
+    if (!error.empty()) { return make_unexpected(error); }
+    return {};
+}
+
+SM_INLINE auto FieldWriter::frame_count() const -> u64
+{
+    const auto lock = std::scoped_lock{mutex};
+    return frames_submitted;
+}
+
+SM_INLINE void
+FieldWriter::submit(std::span<const f64> values, Dimensions field_dims, u64 field_components)
+{
+    if (field_dims != dims || field_components != components)
+    {
+        throw Error{fmt::format("FieldWriter: got a {} field of {} components, expected {} of {}",
+                                field_dims, field_components, dims, components)};
+    }
+
+    auto copy = std::vector<f64>{};
+    {
+        auto lock = std::unique_lock{mutex};
+        frame_finished.wait(lock, [this] { return queued < config.capacity; });
+        queued++;
+        frames_submitted++;
+        if (!pool.empty())
+        {
+            copy = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    copy.assign(values.begin(), values.end());
+    thread_pool.push_task([this, frame = std::move(copy)]() mutable { encode(std::move(frame)); });
+}
+
+SM_INLINE void FieldWriter::encode(std::vector<f64>&& values)
+{
+    const auto keyframe   = frames_encoded % config.keyframe_interval == 0;
+    const auto size       = detail::value_size(config.precision);
+    const auto tile_count = detail::tile_counts(dims, config.tile_dims);
+    const auto table_size = 4 * tile_count.x * tile_count.y;
+
+    record.assign(detail::field_frame_magic.begin(), detail::field_frame_magic.end());
+    record.resize(detail::field_frame_size + table_size);
+    detail::write_le(record.data() + 4, keyframe ? 1 : 0, 4);
+
+    auto previous_offset = u64{};
+    auto table_offset    = detail::field_frame_size;
+    for (auto tile_y : loop::end(tile_count.y))
+    {
+        for (auto tile_x : loop::end(tile_count.x))
+        {
+            const auto [min, tile_dims] =
+                detail::field_tile(dims, config.tile_dims, {tile_x, tile_y});
+            const auto count = tile_dims.x * tile_dims.y * components;
+            tile.resize(count * size);
+
+            // byte b of value i goes to plane b, so the bytes that rarely change (sign, exponent)
+            // end up next to each other
+            auto i = u64{};
+            for (auto y : loop::end(tile_dims.y))
+            {
+                const auto* row = values.data() + ((min.y + y) * dims.x + min.x) * components;
+                for (auto j : loop::end(tile_dims.x * components))
+                {
+                    const auto bits = detail::quantize(row[j], config.precision);
+                    for (auto b : loop::end(size))
+                    {
+                        tile[b * count + i] = static_cast<u8>(255 & (bits >> (8 * b)));
+                    }
+                    i++;
+                }
+            }
+
+            auto* last = previous.data() + previous_offset;
+            if (keyframe) { std::memcpy(last, tile.data(), tile.size()); }
+            else
+            {
+                for (auto k : loop::end(tile.size()))
+                {
+                    const auto current = tile[k];
+                    tile[k]            = current ^ last[k];
+                    last[k]            = current;
+                }
+            }
+            previous_offset += tile.size();
+
+            const auto start = record.size();
+            detail::compress_bytes(tile, record);
+            detail::write_le(record.data() + table_offset, record.size() - start, 4);
+            table_offset += 4;
+        }
+    }
+    detail::write_le(record.data() + 8, record.size(), 8);
+
+    stream.write(reinterpret_cast<const char*>(record.data()),
+                 static_cast<std::streamsize>(record.size()));
+    stream.flush();
+    frames_encoded++;
+
+    {
+        const auto lock = std::scoped_lock{mutex};
+        if (!stream && error.empty())
+        {
+            error = fmt::format("FieldWriter: writing frame {} failed", frames_encoded - 1);
+        }
+        queued--;
+        if (pool.size() < config.capacity) { pool.push_back(std::move(values)); }
+    }
+    frame_finished.notify_all();
+}
+
+SM_INLINE FieldReader::FieldReader(MappedFile&& file_,
+                                   Header header_,
+                                   std::vector<u64>&& frame_offsets_)
+    : file{std::move(file_)}, header{header_}, frame_offsets{std::move(frame_offsets_)}
+{
+}
+
+SM_INLINE auto FieldReader::open(const Path& file_path) -> Result<FieldReader>
+{
+    auto file = MappedFile::open(file_path);
+    if (!file) { return make_unexpected(std::move(file.error())); }
+
+    const auto bytes = file->bytes();
+    if (bytes.size() < detail::field_header_size ||
+        std::memcmp(bytes.data(), detail::field_magic.data(), detail::field_magic.size()) != 0)
+    {
+        return make_unexpected(fmt::format("{} is not a field series", file_path));
+    }
+
+    const auto* data         = bytes.data();
+    auto header              = Header{};
+    header.dims              = {detail::read_le(data + 16, 8), detail::read_le(data + 24, 8)};
+    header.components        = detail::read_le(data + 8, 4);
+    header.tile_dims         = {detail::read_le(data + 32, 8), detail::read_le(data + 40, 8)};
+    header.keyframe_interval = detail::read_le(data + 48, 8);
+
+    const auto size = detail::read_le(data + 12, 4);
+    if (size == 4) { header.precision = FieldPrecision::F32; }
+    else if (size == 2) { header.precision = FieldPrecision::F16; }
+    else if (size == 8) { header.precision = FieldPrecision::F64; }
+
+    if (detail::value_size(header.precision) != size || header.dims.x == 0 || header.dims.y == 0 ||
+        header.tile_dims.x == 0 || header.tile_dims.y == 0 || header.keyframe_interval == 0 ||
+        (header.components != 1 && header.components != 2))
+    {
+        return make_unexpected(fmt::format("{} has an invalid header", file_path));
+    }
+
+    // index every complete frame. A truncated last frame (eg the writer is still running) ends the
+    // series
+    const auto tile_count = detail::tile_counts(header.dims, header.tile_dims);
+    const auto table_end  = detail::field_frame_size + 4 * tile_count.x * tile_count.y;
+
+    auto frame_offsets = std::vector<u64>{};
+    for (auto offset = detail::field_header_size; bytes.size() - offset >= table_end;)
+    {
+        const auto* frame = data + offset;
+        const auto record_size = detail::read_le(frame + 8, 8);
+        if (std::memcmp(frame, detail::field_frame_magic.data(), 4) != 0 ||
+            record_size < table_end || record_size > bytes.size() - offset)
+        {
+            break;
+        }
+
+        frame_offsets.push_back(offset);
+        offset += record_size;
+    }
+
+    return {FieldReader{std::move(*file), header, std::move(frame_offsets)}};
+}
+
+SM_INLINE auto
+FieldReader::read_values(u64 frame, BoundingBox<u64> region, std::span<f64> values) const
+    -> Result<void>
+{
+    if (frame >= frame_offsets.size())
+    {
+        return make_unexpected(
+            fmt::format("FieldReader: frame {} of {}", frame, frame_offsets.size()));
+    }
+
+    const auto bytes      = file.bytes();
+    const auto tile_count = detail::tile_counts(header.dims, header.tile_dims);
+    const auto size       = detail::value_size(header.precision);
+    const auto keyframe   = frame - frame % header.keyframe_interval;
+    const auto width      = region.max.x - region.min.x + 1;
+
+    // the compressed bytes of a tile in a frame, or an empty span if the sizes don't add up
+    const auto tile_payload = [&](u64 index, u64 tile_index)
+    {
+        const auto* record = bytes.data() + frame_offsets[index];
+        const auto* table  = record + detail::field_frame_size;
+
+        auto offset = detail::field_frame_size + 4 * tile_count.x * tile_count.y;
+        for (auto i : loop::end(tile_index)) { offset += detail::read_le(table + 4 * i, 4); }
+
+        const auto tile_size   = detail::read_le(table + 4 * tile_index, 4);
+        const auto record_size = detail::read_le(record + 8, 8);
+        if (offset + tile_size > record_size) { return std::span<const u8>{}; }
+        return std::span<const u8>{record + offset, tile_size};
+    };
+
+    thread_local auto tile  = std::vector<u8>{};
+    thread_local auto delta = std::vector<u8>{};
+
+    for (auto tile_y : loop::start_end(region.min.y / header.tile_dims.y,
+                                       region.max.y / header.tile_dims.y + 1))
+    {
+        for (auto tile_x : loop::start_end(region.min.x / header.tile_dims.x,
+                                           region.max.x / header.tile_dims.x + 1))
+        {
+            const auto tile_index = tile_y * tile_count.x + tile_x;
+            const auto [min, tile_dims] =
+                detail::field_tile(header.dims, header.tile_dims, {tile_x, tile_y});
+            const auto count = tile_dims.x * tile_dims.y * header.components;
+            tile.resize(count * size);
+            delta.resize(count * size);
+
+            // start from the keyframe and apply each delta up to frame
+            for (auto index : loop::start_end(keyframe, frame + 1))
+            {
+                auto& target = index == keyframe ? tile : delta;
+                if (!detail::decompress_bytes(tile_payload(index, tile_index), target))
+                {
+                    return make_unexpected(fmt::format(
+                        "FieldReader: tile {} of frame {} is corrupt", tile_index, index));
+                }
+                if (index != keyframe)
+                {
+                    for (auto k : loop::end(tile.size())) { tile[k] ^= delta[k]; }
+                }
+            }
+
+            // copy the part of the tile inside region
+            const auto first =
+                Indices{std::max(min.x, region.min.x), std::max(min.y, region.min.y)};
+            const auto last  = Indices{std::min(min.x + tile_dims.x - 1, region.max.x),
+                                      std::min(min.y + tile_dims.y - 1, region.max.y)};
+            for (auto y : loop::start_end(first.y, last.y + 1))
+            {
+                for (auto x : loop::start_end(first.x, last.x + 1))
+                {
+                    for (auto c : loop::end(header.components))
+                    {
+                        const auto i =
+                            ((y - min.y) * tile_dims.x + (x - min.x)) * header.components + c;
+                        auto bits = u64{};
+                        for (auto b : loop::end(size))
+                        {
+                            bits |= u64{tile[b * count + i]} << (8 * b);
+                        }
+
+                        values[((y - region.min.y) * width + (x - region.min.x)) *
+                                   header.components +
+                               c] = detail::dequantize(bits, header.precision);
+                    }
+                }
+            }
+        }
+    }
+    return {};
+}
+} // namespace sm::file
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <condition_variable> // for condition_variable
+#include <exception>          // for exception
+#include <functional>         // for function
+#include <mutex>              // for mutex
+#include <set>                // for set
+#include <string>             // for string
+#include <vector>             // for vector
+
+#include "samarium/core/types.hpp"   // for u64, f64
+#include "samarium/math/Vector2.hpp" // for Dimensions
+
+#include "Grid.hpp"       // for Image
+#include "Result.hpp"     // for Result
+#include "ThreadPool.hpp" // for ThreadPool
+#include "file.hpp"       // for Path, write
+
+namespace sm
+{
+/**
+ * @brief Encode and write frames on worker threads so that recording doesn't stall the render
+ * loop
+ *
+ * @code
+ * auto recorder = FrameRecorder{file::png, {.directory = "frames"}};
+ * while (window.is_open())
+ * {
+ *     // draw...
+ *     recorder.submit(window.get_image());
+ * }
+ * @endcode
+ *
+ * Frames are numbered in submission order. Each is written to a temporary file and renamed to
+ * `<prefix><number><extension>` once every earlier frame has been renamed, so files appear in
+ * order even though frames are encoded concurrently. A frame that fails to be written is skipped,
+ * and the first failure is reported by flush()
+ */
+class FrameRecorder
+{
+  public:
+    /**
+     * @brief What submit() does when capacity frames are already queued or encoding
+     */
+    enum class Backpressure
+    {
+        Block, ///< Wait for a frame to finish
+        Drop,  ///< Discard the new frame
+        Grow   ///< Queue it anyway
+    };
+
+    struct Config
+    {
+        file::Path directory{"."};
+        std::string prefix{"frame_"};
+        u64 threads{}; ///< Encoder threads, 0 uses every hardware thread
+        u64 capacity{8};
+        Backpressure backpressure{Backpressure::Block};
+    };
+
+    struct Stats
+    {
+        u64 submitted{};
+        u64 written{};
+        u64 dropped{};
+        u64 failed{}; ///< Frames that could not be encoded, written or renamed into place
+        u64 queue_depth{};
+        u64 max_queue_depth{};
+        f64 total_encode_seconds{};
+        f64 max_encode_seconds{};
+
+        [[nodiscard]] auto mean_encode_seconds() const -> f64;
+    };
+
+    template <typename Format> explicit FrameRecorder(Format format);
+
+    template <typename Format>
+    FrameRecorder(Format /* format */, const Config& config_)
+        : writer{[](const Image& image, const file::Path& file_path)
+                 { file::write(Format{}, image, file_path); }},
+          extension{Format::extension}, config{config_},
+          thread_pool{static_cast<BS::concurrency_t>(config_.threads)}
+    {
+        std::filesystem::create_directories(config.directory);
+    }
+
+    FrameRecorder(const FrameRecorder&)                    = delete;
+    auto operator=(const FrameRecorder&) -> FrameRecorder& = delete;
+
+    /**
+     * @brief               Waits for every submitted frame to be written
+     */
+    ~FrameRecorder();
+
+    /**
+     * @brief               Queue a frame to be encoded and written
+     *
+     * @param  image        Moved from: pass an Image from acquire() to avoid allocating
+     * @return              false if the frame was dropped
+     */
+    auto submit(Image&& image) -> bool;
+
+    /**
+     * @brief               Copy image into a recycled Image and queue it
+     */
+    auto submit(const Image& image) -> bool;
+
+    /**
+     * @brief               An Image of dims, reused from a written frame if one is available
+     */
+    [[nodiscard]] auto acquire(Dimensions dims) -> Image;
+
+    /**
+     * @brief               Block until every submitted frame is written
+     *
+     * @return              The first write error, if any
+     */
+    auto flush() -> Result<void>;
+
+    [[nodiscard]] auto get_stats() const -> Stats;
+
+    [[nodiscard]] auto frame_path(u64 index) const -> file::Path;
+
+  private:
+    std::function<void(const Image&, const file::Path&)> writer;
+    std::string extension;
+    Config config;
+
+    mutable std::mutex mutex;
+    std::condition_variable frame_finished;
+    u64 next_index{};
+    u64 next_to_publish{};
+    std::set<u64> finished{};  // encoded but waiting for an earlier frame
+    std::set<u64> unwritten{}; // finished frames whose writer threw
+    std::string error{}; // of the first frame that failed
+    std::vector<Image> pool{};
+    Stats stats{};
+
+    // last, so that its threads are joined before anything they use is destroyed
+    ThreadPool thread_pool;
+
+    [[nodiscard]] auto temporary_path(u64 index) const -> file::Path;
+
+    void encode(u64 index, Image&& image);
+
+    void recycle(Image&& image);
+};
+
+template <typename Format>
+FrameRecorder::FrameRecorder(Format format) : FrameRecorder(format, Config{})
+{
+}
+} // namespace sm
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_FRAME_RECORDER_IMPL)
+
+#include <algorithm>    // for max, copy
+#include <filesystem>   // for rename, create_directories
+#include <system_error> // for error_code
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+#include "Stopwatch.hpp" // for Stopwatch
+
+namespace sm
+{
+SM_INLINE auto FrameRecorder::Stats::mean_encode_seconds() const -> f64
+{
+    const auto encoded = written + failed;
+    return encoded == 0 ? 0.0 : total_encode_seconds / static_cast<f64>(encoded);
+}
+
+SM_INLINE FrameRecorder::~FrameRecorder() { thread_pool.wait_for_tasks(); }
+
+SM_INLINE auto FrameRecorder::submit(Image&& image) -> bool
+{
+    auto lock = std::unique_lock{mutex};
+
+    if (stats.queue_depth >= config.capacity)
+    {
+        if (config.backpressure == Backpressure::Block)
+        {
+            frame_finished.wait(lock, [this] { return stats.queue_depth < config.capacity; });
+        }
+        else if (config.backpressure == Backpressure::Drop)
+        {
+            stats.dropped++;
+            recycle(std::move(image));
+            return false;
+        }
+    }
+
+    const auto index = next_index++;
+    stats.submitted++;
+    stats.queue_depth++;
+    stats.max_queue_depth = std::max(stats.max_queue_depth, stats.queue_depth);
+    lock.unlock();
+
+    thread_pool.push_task([this, index, frame = std::move(image)]() mutable
+                          { encode(index, std::move(frame)); });
+    return true;
+}
+
+SM_INLINE auto FrameRecorder::submit(const Image& image) -> bool
+{
+    auto frame = acquire(image.dims);
+    std::copy(image.begin(), image.end(), frame.begin());
+    return submit(std::move(frame));
+}
+
+SM_INLINE auto FrameRecorder::acquire(Dimensions dims) -> Image
+{
+    {
+        const auto lock = std::scoped_lock{mutex};
+        while (!pool.empty())
+        {
+            auto image = std::move(pool.back());
+            pool.pop_back();
+            if (image.dims == dims) { return image; }
+        }
+    }
+    return Image{dims};
+}
+
+SM_INLINE auto FrameRecorder::flush() -> Result<void>
+{
+    thread_pool.wait_for_tasks();
+
+    const auto lock = std::scoped_lock{mutex};
+    if (!error.empty()) { return make_unexpected(error); }
+    return {};
+}
+
+SM_INLINE auto FrameRecorder::get_stats() const -> Stats
+{
+    const auto lock = std::scoped_lock{mutex};
+    return stats;
+}
+
+SM_INLINE auto FrameRecorder::frame_path(u64 index) const -> file::Path
+{
+    return config.directory / fmt::format("{}{:06}{}", config.prefix, index, extension);
+}
+
+SM_INLINE auto FrameRecorder::temporary_path(u64 index) const -> file::Path
+{
+    auto file_path = frame_path(index);
+    file_path += ".part";
+    return file_path;
+}
+
+SM_INLINE void FrameRecorder::encode(u64 index, Image&& image)
+{
+    const auto watch = Stopwatch{};
+    // an exception escaping a pool task would terminate the program, and later frames would wait
+    // for this one forever
+    auto message = std::string{};
+    try
+    {
+        writer(image, temporary_path(index));
+    }
+    catch (const std::exception& exception)
+    {
+        message =
+            fmt::format("FrameRecorder: writing frame {} failed: {}", index, exception.what());
+    }
+    catch (...)
+    {
+        message = fmt::format("FrameRecorder: writing frame {} failed", index);
+    }
+    const auto seconds = watch.seconds();
+
+    {
+        const auto lock = std::scoped_lock{mutex};
+        finished.insert(index);
+        if (!message.empty())
+        {
+            unwritten.insert(index);
+            if (error.empty()) { error = std::move(message); }
+        }
+
+        while (!finished.empty() && *finished.begin() == next_to_publish)
+        {
+            auto file_error = std::error_code{};
+            if (unwritten.erase(next_to_publish) != 0)
+            {
+                // drop whatever part of the file was written
+                std::filesystem::remove(temporary_path(next_to_publish), file_error);
+                stats.failed++;
+            }
+            else
+            {
+                std::filesystem::rename(temporary_path(next_to_publish),
+                                        frame_path(next_to_publish), file_error);
+                if (!file_error) { stats.written++; }
+                else
+                {
+                    stats.failed++;
+                    if (error.empty())
+                    {
+                        error = fmt::format("FrameRecorder: renaming frame {} failed: {}",
+                                            next_to_publish, file_error.message());
+                    }
+                }
+            }
+
+            finished.erase(finished.begin());
+            next_to_publish++;
+        }
+
+        stats.queue_depth--;
+        stats.total_encode_seconds += seconds;
+        stats.max_encode_seconds = std::max(stats.max_encode_seconds, seconds);
+        recycle(std::move(image));
+    }
+    frame_finished.notify_all();
+}
+
+SM_INLINE void FrameRecorder::recycle(Image&& image)
+{
+    // called with mutex held
+    if (pool.size() < config.capacity) { pool.push_back(std::move(image)); }
+}
+} // namespace sm
+
+#endif
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <algorithm> // for copy
 #include <span>      // for span
 #include <stdexcept> // for out_of_range
 #include <vector>    // for vector
@@ -14,6 +15,7 @@
 #include "fmt/format.h"
 
 #include "range/v3/algorithm/copy.hpp"
+#include "range/v3/algorithm/fill.hpp"
 #include "range/v3/view/enumerate.hpp"
 #include "range/v3/view/iota.hpp"
 #include "range/v3/view/transform.hpp"
@@ -22,6 +24,9 @@
 #include "samarium/graphics/Color.hpp"   // for Color
 #include "samarium/math/BoundingBox.hpp" // for BoundingBox
 #include "samarium/math/loop.hpp"        // for end
+#include "samarium/math/math.hpp"        // for min
+#include "samarium/util/GridLayout.hpp"  // for RowMajor, GridLayout
+#include "samarium/util/ThreadPool.hpp"  // for ThreadPool, parallelize_loop
 
 namespace sm
 {
@@ -41,7 +46,20 @@ inline auto iota_view_2d(Dimensions dims)
            ranges::views::transform([dims](u64 index) { return convert_1d_to_2d(dims, index); });
 }
 
-template <typename T> class Grid
+/**
+ * @brief               Default tile size for Grid::for_each_tile: 64 x 64 elements fit in L1 or L2
+ */
+constexpr inline auto default_tile_dims = Dimensions{64, 64};
+
+/**
+ * @brief               A 2D array of T
+ *
+ * @tparam T            Element type
+ * @tparam Layout       How Indices map to storage, see layout::RowMajor, layout::Tiled and
+ * layout::Morton. `elements`, `operator[](u64)`, `span()` and `data()` are in storage order, which
+ * for non row-major layouts may include padding
+ */
+template <typename T, concepts::GridLayout Layout = layout::RowMajor> class Grid
 {
   public:
     // Container types
@@ -53,22 +71,43 @@ template <typename T> class Grid
     using difference_type = std::ptrdiff_t;
     using size_type       = u64;
 
+    using layout_type     = Layout;
+
+    static constexpr auto is_row_major = std::same_as<Layout, layout::RowMajor>;
+
     std::vector<T> elements;
     const Dimensions dims;
+    const Layout layout;
 
     // Constructors
-    explicit Grid(Dimensions dims_) : elements(dims_.x * dims_.y), dims{dims_} {}
+    explicit Grid(Dimensions dims_)
+        : elements(Layout{dims_}.size()), dims{dims_}, layout{dims_}
+    {
+    }
 
-    Grid(Dimensions dims_, T init_value) : elements(dims_.x * dims_.y, init_value), dims{dims_} {}
+    Grid(Dimensions dims_, T init_value)
+        : elements(Layout{dims_}.size(), init_value), dims{dims_}, layout{dims_}
+    {
+    }
 
     explicit Grid(std::span<const T> span, Dimensions dims_)
-        : elements(span.begin(), span.end()), dims{dims_}
+        requires is_row_major
+        : elements(span.begin(), span.end()), dims{dims_}, layout{dims_}
     {
     }
 
+    /**
+     * @brief               Copy a Grid with a different layout
+     */
+    template <concepts::GridLayout OtherLayout>
+    explicit Grid(const Grid<T, OtherLayout>& other) : Grid(other.dims)
+    {
+        other.for_each_row([this](Indices pos, const T& value) { (*this)[pos] = value; });
+    }
+
     template <typename Fn> static auto generate(Dimensions dims, Fn&& fn)
     {
-        auto grid = Grid<T>(dims);
+        auto grid = Grid(dims);
         for (auto y : loop::end(dims.y))
         {
             for (auto x : loop::end(dims.x))
@@ -80,15 +119,31 @@ template <typename T> class Grid
         return grid;
     }
 
+    /**
+     * @brief               Generate a Grid in parallel by evaluating fn(Indices) for every element
+     *
+     * @param  dims
+     * @param  fn           Must be safe to call concurrently
+     * @param  thread_pool
+     */
+    template <typename Fn>
+    static auto generate(Dimensions dims, Fn&& fn, ThreadPool& thread_pool)
+    {
+        auto grid = Grid(dims);
+        grid.for_each_tile(default_tile_dims, [&fn](Indices pos, T& value) { value = fn(pos); },
+                           thread_pool);
+        return grid;
+    }
+
     // -------------------------------Member functions------------------------------------
 
     auto operator[](Indices indices) -> reference
     {
-        return this->elements[indices.y * this->dims.x + indices.x];
+        return this->elements[layout.index(indices)];
     }
     auto operator[](Indices indices) const -> const_reference
     {
-        return this->elements[indices.y * this->dims.x + indices.x];
+        return this->elements[layout.index(indices)];
     }
 
     auto operator[](u64 index) noexcept -> T& { return this->elements[index]; }
@@ -168,9 +223,11 @@ template <typename T> class Grid
 
     auto bounding_box() const { return BoundingBox<u64>{Indices{}, dims - Indices{1, 1}}; }
 
-    auto fill(const T& value) { this->elements.fill(value); }
+    auto fill(const T& value) { ranges::fill(this->elements, value); }
 
-    template <concepts::ColorFormat Format> [[nodiscard]] auto formatted_data(Format format) const
+    template <concepts::ColorFormat Format>
+    [[nodiscard]] auto formatted_data(Format format) const
+        requires is_row_major
     {
         const auto format_length = Format::length;
         auto output              = std::vector<std::array<u8, format_length>>(this->size());
@@ -190,23 +247,179 @@ template <typename T> class Grid
 
     [[nodiscard]] auto upscale(u64 upscale_factor) const
     {
-        auto output = Grid<T>(this->dims * upscale_factor);
-        for (auto y : loop::end(output.dims.y))
+        auto output = Grid(this->dims * upscale_factor);
+        upscale_rows(output, upscale_factor, 0, this->dims.y);
+        return output;
+    }
+
+    [[nodiscard]] auto upscale(u64 upscale_factor, ThreadPool& thread_pool) const
+    {
+        auto output = Grid(this->dims * upscale_factor);
+        parallelize_loop(&thread_pool, this->dims.y, [&](u64 min, u64 max)
+                         { upscale_rows(output, upscale_factor, min, max); });
+        return output;
+    }
+
+    /**
+     * @brief               Call fn(Indices, T&) for every element, one row after another
+     */
+    template <typename Fn> void for_each_row(Fn&& fn) { for_each_row_impl(*this, fn, nullptr); }
+
+    template <typename Fn> void for_each_row(Fn&& fn) const
+    {
+        for_each_row_impl(*this, fn, nullptr);
+    }
+
+    /**
+     * @brief               Call fn(Indices, T&) for every element, splitting rows over thread_pool
+     */
+    template <typename Fn> void for_each_row(Fn&& fn, ThreadPool& thread_pool)
+    {
+        for_each_row_impl(*this, fn, &thread_pool);
+    }
+
+    template <typename Fn> void for_each_row(Fn&& fn, ThreadPool& thread_pool) const
+    {
+        for_each_row_impl(*this, fn, &thread_pool);
+    }
+
+    /**
+     * @brief               Call fn(Indices, T&) for every element, one tile after another
+     *
+     * @param  tile_dims    Size of each tile, eg default_tile_dims
+     * @param  fn
+     */
+    template <typename Fn> void for_each_tile(Dimensions tile_dims, Fn&& fn)
+    {
+        for_each_tile_impl(*this, tile_dims, fn, nullptr);
+    }
+
+    template <typename Fn> void for_each_tile(Dimensions tile_dims, Fn&& fn) const
+    {
+        for_each_tile_impl(*this, tile_dims, fn, nullptr);
+    }
+
+    /**
+     * @brief               Call fn(Indices, T&) for every element, distributing tiles over
+     * thread_pool. Each tile is handled by a single thread, in row-major order within the tile
+     *
+     * @param  tile_dims    Size of each tile, eg default_tile_dims
+     * @param  fn           Must be safe to call concurrently for different elements
+     * @param  thread_pool
+     */
+    template <typename Fn>
+    void for_each_tile(Dimensions tile_dims, Fn&& fn, ThreadPool& thread_pool)
+    {
+        for_each_tile_impl(*this, tile_dims, fn, &thread_pool);
+    }
+
+    template <typename Fn>
+    void for_each_tile(Dimensions tile_dims, Fn&& fn, ThreadPool& thread_pool) const
+    {
+        for_each_tile_impl(*this, tile_dims, fn, &thread_pool);
+    }
+
+    auto enumerate_1d() { return ranges::views::enumerate(elements); }
+
+    auto enumerate_2d()
+        requires is_row_major
+    {
+        return ranges::views::zip(iota_view_2d(dims), elements);
+    }
+
+    auto byte_size() const { return size() * sizeof(T); }
+
+  private:
+    void upscale_rows(Grid& output, u64 upscale_factor, u64 row_min, u64 row_max) const
+    {
+        if constexpr (!is_row_major)
         {
-            for (auto x : loop::end(output.dims.x))
+            for (auto y : loop::start_end(row_min * upscale_factor, row_max * upscale_factor))
             {
-                output[{x, y}] = this->operator[](Indices{x, y} / upscale_factor);
+                for (auto x : loop::end(output.dims.x))
+                {
+                    output[{x, y}] = this->operator[](Indices{x, y} / upscale_factor);
+                }
             }
+            return;
         }
 
-        return output;
+        for (auto y : loop::start_end(row_min, row_max))
+        {
+            const auto* source = &this->elements[y * this->dims.x];
+            auto* first_row    = &output.elements[y * upscale_factor * output.dims.x];
+
+            auto* destination = first_row;
+            for (auto x : loop::end(this->dims.x))
+            {
+                for ([[maybe_unused]] auto i : loop::end(upscale_factor))
+                {
+                    *destination++ = source[x];
+                }
+            }
+
+            for (auto i : loop::start_end(u64{1}, upscale_factor))
+            {
+                std::copy(first_row, first_row + output.dims.x, first_row + i * output.dims.x);
+            }
+        }
     }
 
-    auto enumerate_1d() { return ranges::views::enumerate(elements); }
+    // Self is Grid or const Grid, so that fn gets T& or const T&
+    template <typename Self, typename Fn>
+    static void for_each_in_row(Self& self, Fn& fn, u64 y, u64 x_min, u64 x_max)
+    {
+        if constexpr (is_row_major)
+        {
+            auto* row = self.elements.data() + y * self.dims.x;
+            for (auto x : loop::start_end(x_min, x_max)) { fn(Indices{x, y}, row[x]); }
+        }
+        else
+        {
+            for (auto x : loop::start_end(x_min, x_max)) { fn(Indices{x, y}, self[{x, y}]); }
+        }
+    }
 
-    auto enumerate_2d() { return ranges::views::zip(iota_view_2d(dims), elements); }
+    template <typename Self, typename Fn>
+    static void for_each_row_impl(Self& self, Fn& fn, ThreadPool* thread_pool)
+    {
+        parallelize_loop(thread_pool, self.dims.y,
+                         [&](u64 min, u64 max)
+                         {
+                             for (auto y : loop::start_end(min, max))
+                             {
+                                 for_each_in_row(self, fn, y, 0, self.dims.x);
+                             }
+                         });
+    }
 
-    auto byte_size() const { return size() * sizeof(T); }
+    template <typename Self, typename Fn>
+    static void
+    for_each_tile_impl(Self& self, Dimensions tile_dims, Fn& fn, ThreadPool* thread_pool)
+    {
+        const auto tiles_x = (self.dims.x + tile_dims.x - 1) / tile_dims.x;
+        const auto tiles_y = (self.dims.y + tile_dims.y - 1) / tile_dims.y;
+
+        // several tiles per thread so that uneven tiles (eg a fractal) still balance
+        parallelize_loop(
+            thread_pool, tiles_x * tiles_y,
+            [&](u64 min, u64 max)
+            {
+                for (auto tile : loop::start_end(min, max))
+                {
+                    const auto x_min = tile % tiles_x * tile_dims.x;
+                    const auto y_min = tile / tiles_x * tile_dims.y;
+                    const auto x_max = math::min(x_min + tile_dims.x, self.dims.x);
+                    const auto y_max = math::min(y_min + tile_dims.y, self.dims.y);
+
+                    for (auto y : loop::start_end(y_min, y_max))
+                    {
+                        for_each_in_row(self, fn, y, x_min, x_max);
+                    }
+                }
+            },
+            4);
+    }
 };
 
 using Image       = Grid<Color>;
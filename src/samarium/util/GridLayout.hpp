@@ -0,0 +1,147 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <bit>      // for bit_ceil, countr_zero
+#include <concepts> // for convertible_to
+
+#if defined(__BMI2__)
+#include <immintrin.h> // for _pdep_u64
+#endif
+
+#include "samarium/core/types.hpp"   // for u64
+#include "samarium/math/Vector2.hpp" // for Indices, Dimensions
+
+/**
+ * @brief Memory layouts for Grid: each maps 2D indices to an offset into the element storage
+ *
+ * A layout is constructed from the Grid's dimensions and provides `size()`, the number of elements
+ * to allocate (which may include padding), and `index(Indices)`. Layouts other than RowMajor keep
+ * 2D neighbours close in memory, which helps stencils that read the rows above and below
+ */
+namespace sm::layout
+{
+struct RowMajor
+{
+    u64 width{};
+    u64 height{};
+
+    constexpr explicit RowMajor(Dimensions dims) noexcept : width{dims.x}, height{dims.y} {}
+
+    [[nodiscard]] constexpr auto size() const noexcept { return width * height; }
+
+    [[nodiscard]] constexpr auto index(Indices indices) const noexcept
+    {
+        return indices.y * width + indices.x;
+    }
+};
+
+/**
+ * @brief               Square tiles of TileSize x TileSize elements, row-major within and across
+ * tiles. The grid is padded to a whole number of tiles
+ *
+ * @tparam TileSize     Power of 2, eg 8 for 64 elements per tile
+ */
+template <u64 TileSize = 8> struct Tiled
+{
+    static_assert(std::has_single_bit(TileSize),
+                  "sm::layout::Tiled: TileSize must be a power of 2");
+
+    static constexpr auto tile_shift = static_cast<u64>(std::countr_zero(TileSize));
+    static constexpr auto tile_mask  = TileSize - 1;
+
+    u64 tiles_x{};
+    u64 tiles_y{};
+
+    constexpr explicit Tiled(Dimensions dims) noexcept
+        : tiles_x{(dims.x + tile_mask) >> tile_shift}, tiles_y{(dims.y + tile_mask) >> tile_shift}
+    {
+    }
+
+    [[nodiscard]] constexpr auto size() const noexcept
+    {
+        return (tiles_x * tiles_y) << (2 * tile_shift);
+    }
+
+    [[nodiscard]] constexpr auto index(Indices indices) const noexcept
+    {
+        const auto tile   = (indices.y >> tile_shift) * tiles_x + (indices.x >> tile_shift);
+        const auto within = ((indices.y & tile_mask) << tile_shift) | (indices.x & tile_mask);
+        return (tile << (2 * tile_shift)) | within;
+    }
+};
+
+/**
+ * @brief               Spread the lower 32 bits of value to the even bits of the result
+ */
+[[nodiscard]] inline auto spread_bits(u64 value) noexcept -> u64
+{
+#if defined(__BMI2__)
+    return _pdep_u64(value, u64{0x5555'5555'5555'5555});
+#else
+    value &= u64{0xFFFF'FFFF};
+    value = (value | (value << 16)) & u64{0x0000'FFFF'0000'FFFF};
+    value = (value | (value << 8)) & u64{0x00FF'00FF'00FF'00FF};
+    value = (value | (value << 4)) & u64{0x0F0F'0F0F'0F0F'0F0F};
+    value = (value | (value << 2)) & u64{0x3333'3333'3333'3333};
+    value = (value | (value << 1)) & u64{0x5555'5555'5555'5555};
+    return value;
+#endif
+}
+
+/**
+ * @brief               Z-order (Morton) curve: x and y bits are interleaved, so every aligned
+ * 2^k x 2^k block is contiguous
+ *
+ * @details Each dimension is padded to a power of 2. For non-square grids the square part is
+ * interleaved and the remaining high bits of the longer side select which square it is in
+ */
+struct Morton
+{
+    u64 square_bits{};
+    u64 square_mask{};
+    u64 padded_size{};
+
+    explicit Morton(Dimensions dims) noexcept
+    {
+        const auto padded_x = std::bit_ceil(dims.x);
+        const auto padded_y = std::bit_ceil(dims.y);
+        const auto square   = padded_x < padded_y ? padded_x : padded_y;
+
+        square_bits = static_cast<u64>(std::countr_zero(square));
+        square_mask = square - 1;
+        padded_size = padded_x * padded_y;
+    }
+
+    [[nodiscard]] auto size() const noexcept { return padded_size; }
+
+    [[nodiscard]] auto index(Indices indices) const noexcept
+    {
+        const auto interleaved =
+            spread_bits(indices.x & square_mask) | (spread_bits(indices.y & square_mask) << 1);
+
+        // at most one of these is non-zero, since only the longer side extends past the square
+        const auto square = (indices.x >> square_bits) | (indices.y >> square_bits);
+        return (square << (2 * square_bits)) | interleaved;
+    }
+};
+} // namespace sm::layout
+
+namespace sm::concepts
+{
+template <typename T>
+concept GridLayout = requires(const T& layout, Dimensions dims, Indices indices) {
+                         T{dims};
+                         {
+                             layout.size()
+                             } -> std::convertible_to<u64>;
+                         {
+                             layout.index(indices)
+                             } -> std::convertible_to<u64>;
+                     };
+} // namespace sm::concepts
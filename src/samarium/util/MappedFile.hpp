@@ -0,0 +1,130 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <filesystem> // for path
+#include <span>       // for span
+#include <vector>     // for vector
+
+#include "samarium/core/types.hpp" // for u8, u64
+
+#include "Result.hpp" // for Result
+
+namespace sm::file
+{
+/**
+ * @brief A read-only view of a whole file, memory-mapped where the platform supports it (and read
+ * into memory otherwise), so that decoders can parse it in place without a copy
+ */
+class MappedFile
+{
+  public:
+    [[nodiscard]] static auto open(const std::filesystem::path& file_path) -> Result<MappedFile>;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&)                    = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+    auto operator=(MappedFile&&) -> MappedFile&      = delete;
+
+    ~MappedFile();
+
+    [[nodiscard]] auto bytes() const noexcept { return std::span<const u8>{data, size}; }
+
+  private:
+    const u8* data{};
+    u64 size{};
+    bool mapped{};
+    std::vector<u8> fallback{};
+
+    MappedFile() = default;
+};
+} // namespace sm::file
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_MAPPED_FILE_IMPL)
+
+#include <utility> // for exchange
+
+#if defined(_WIN32)
+#include <fstream> // for ifstream
+#else
+#include <fcntl.h>    // for open
+#include <sys/mman.h> // for mmap, munmap, madvise
+#include <sys/stat.h> // for fstat
+#include <unistd.h>   // for close
+#endif
+
+#include "fmt/format.h" // for format
+#include "fmt/std.h"    // for formatter<std::filesystem::path>
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+namespace sm::file
+{
+SM_INLINE auto MappedFile::open(const std::filesystem::path& file_path) -> Result<MappedFile>
+{
+    auto file = MappedFile{};
+
+#if !defined(_WIN32)
+    const auto fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) { return make_unexpected(fmt::format("could not open {}", file_path)); }
+
+    struct stat status
+    {
+    };
+    if (::fstat(fd, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        ::close(fd);
+        return make_unexpected(fmt::format("{} is not a file", file_path));
+    }
+
+    file.size = static_cast<u64>(status.st_size);
+    if (file.size != 0)
+    {
+        auto* address = ::mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            ::close(fd);
+            return make_unexpected(fmt::format("could not map {}", file_path));
+        }
+
+        // decoders read front to back
+        ::madvise(address, file.size, MADV_SEQUENTIAL);
+        file.data   = static_cast<const u8*>(address);
+        file.mapped = true;
+    }
+    ::close(fd); // the mapping keeps the file alive
+#else
+    auto stream = std::ifstream{file_path, std::ios::binary | std::ios::ate};
+    if (!stream) { return make_unexpected(fmt::format("could not open {}", file_path)); }
+
+    file.fallback.resize(static_cast<u64>(stream.tellg()));
+    stream.seekg(0).read(reinterpret_cast<char*>(file.fallback.data()),
+                         static_cast<std::streamsize>(file.fallback.size()));
+    file.data = file.fallback.data();
+    file.size = file.fallback.size();
+#endif
+
+    return {std::move(file)};
+}
+
+SM_INLINE MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data{std::exchange(other.data, nullptr)}, size{std::exchange(other.size, 0)},
+      mapped{std::exchange(other.mapped, false)}, fallback{std::move(other.fallback)}
+{
+}
+
+SM_INLINE MappedFile::~MappedFile()
+{
+#if !defined(_WIN32)
+    if (mapped) { ::munmap(const_cast<u8*>(data), size); }
+#endif
+}
+} // namespace sm::file
+
+#endif
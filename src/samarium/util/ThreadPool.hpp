@@ -2,7 +2,31 @@
 
 #include "BS_thread_pool.hpp"
 
+#include "samarium/core/types.hpp" // for u64
+
 namespace sm
 {
 using ThreadPool = BS::thread_pool;
+
+/**
+ * @brief               Split [0, count) into contiguous blocks and call job(min, max) for each
+ * block on the pool. If thread_pool is null, call job(0, count) on this thread
+ *
+ * @param  thread_pool        Pool to run on, or nullptr to run serially
+ * @param  count              Number of items (eg rows of a Grid)
+ * @param  job                Callable taking (u64 min, u64 max)
+ * @param  blocks_per_thread  More blocks balance uneven work better, at some scheduling cost
+ */
+template <typename Job>
+void parallelize_loop(ThreadPool* thread_pool, u64 count, Job&& job, u64 blocks_per_thread = 1)
+{
+    if (thread_pool == nullptr || thread_pool->get_thread_count() <= 1 || count < 2)
+    {
+        job(u64{}, count);
+        return;
+    }
+
+    const auto blocks = static_cast<u64>(thread_pool->get_thread_count()) * blocks_per_thread;
+    thread_pool->parallelize_loop(u64{}, count, job, blocks).wait();
 }
+} // namespace sm
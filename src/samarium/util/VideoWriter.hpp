@@ -0,0 +1,448 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <cstdio> // for FILE
+#include <span>   // for span
+#include <string> // for string
+#include <vector> // for vector
+
+#include "samarium/core/types.hpp"   // for u8, u64
+#include "samarium/math/Vector2.hpp" // for Dimensions
+
+#include "Grid.hpp"   // for Image
+#include "Result.hpp" // for Result
+#include "file.hpp"   // for Path
+
+namespace sm::file
+{
+enum class VideoFormat
+{
+    Y4m, ///< YUV4MPEG2 with 4:2:0 chroma, BT.601 limited range
+    Rgba ///< Headerless RGBA frames, eg for `ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i -`
+};
+
+/**
+ * @brief Stream frames to a file, pipe or file descriptor, eg for encoding with ffmpeg
+ *
+ * @code
+ * auto video = file::VideoWriter::pipe("ffmpeg -y -i - out.mp4", window.dims).value();
+ * while (window.is_open())
+ * {
+ *     // draw...
+ *     video.write(window.get_image());
+ * }
+ * @endcode
+ *
+ * Frames are written with a single writev call each, from a conversion buffer allocated once, so
+ * writing allocates nothing per frame. Every frame must have the dimensions given on construction
+ */
+class VideoWriter
+{
+  public:
+    /**
+     * @brief               Write to file_path, replacing it if it exists
+     */
+    [[nodiscard]] static auto open(const Path& file_path,
+                                   Dimensions dims,
+                                   VideoFormat format = VideoFormat::Y4m,
+                                   u64 fps            = 60) -> Result<VideoWriter>;
+
+    /**
+     * @brief               Write to the standard input of a shell command
+     */
+    [[nodiscard]] static auto pipe(const std::string& command,
+                                   Dimensions dims,
+                                   VideoFormat format = VideoFormat::Y4m,
+                                   u64 fps            = 60) -> Result<VideoWriter>;
+
+    /**
+     * @brief               Write to an open file descriptor, eg 1 for stdout. It is not closed
+     */
+    VideoWriter(int file_descriptor,
+                Dimensions dims,
+                VideoFormat format = VideoFormat::Y4m,
+                u64 fps            = 60);
+
+    VideoWriter(VideoWriter&& other) noexcept;
+    VideoWriter(const VideoWriter&)                    = delete;
+    auto operator=(const VideoWriter&) -> VideoWriter& = delete;
+    auto operator=(VideoWriter&&) -> VideoWriter&      = delete;
+
+    ~VideoWriter();
+
+    /**
+     * @brief               Append a frame. The stream header is written before the first frame
+     */
+    auto write(const Image& image) -> Result<void>;
+
+    [[nodiscard]] auto frame_count() const noexcept { return frames; }
+
+  private:
+    int fd{-1};
+    bool owns_fd{};
+    std::FILE* process{};
+    Dimensions dims;
+    VideoFormat format;
+    std::string header;
+    std::vector<u8> buffer{};
+    u64 frames{};
+};
+
+namespace detail
+{
+/**
+ * @brief               Convert RGBA to 8 bit Y, U and V planes, with each chroma sample the mean
+ * of a 2x2 block. Alpha is ignored
+ *
+ * @param  image
+ * @param  y            image.dims.x * image.dims.y bytes
+ * @param  u            ceil(width / 2) * ceil(height / 2) bytes
+ * @param  v            ceil(width / 2) * ceil(height / 2) bytes
+ */
+void rgba_to_i420(const Image& image, u8* y, u8* u, u8* v);
+} // namespace detail
+} // namespace sm::file
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_VIDEO_WRITER_IMPL)
+
+#include <algorithm>   // for min
+#include <array>       // for array
+#include <cerrno>      // for errno, EINTR
+#include <string_view> // for string_view
+#include <utility>     // for exchange
+
+#if defined(_WIN32)
+#include <fcntl.h>    // for _O_WRONLY, _O_BINARY
+#include <io.h>       // for _open, _write, _close
+#include <sys/stat.h> // for _S_IREAD, _S_IWRITE
+#else
+#include <fcntl.h>   // for open, O_WRONLY
+#include <limits.h>  // for IOV_MAX
+#include <sys/uio.h> // for writev, iovec
+#include <unistd.h>  // for close
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h> // for _mm_madd_epi16, _mm_avg_epu8
+#endif
+
+#include "fmt/format.h" // for format
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+#include "samarium/math/loop.hpp"   // for end
+
+namespace sm::file
+{
+namespace detail
+{
+struct Chunk
+{
+    const u8* data;
+    u64 size;
+};
+
+// write every byte of chunks, in order, retrying partial writes
+[[nodiscard]] inline auto write_all(int fd, std::span<Chunk> chunks) -> bool
+{
+#if defined(_WIN32)
+    for (auto chunk : chunks)
+    {
+        while (chunk.size != 0)
+        {
+            const auto size    = static_cast<unsigned>(std::min(chunk.size, u64{1} << 30));
+            const auto written = _write(fd, chunk.data, size);
+            if (written < 0) { return false; }
+            chunk.data += written;
+            chunk.size -= static_cast<u64>(written);
+        }
+    }
+    return true;
+#else
+    auto parts = std::array<iovec, 4>{};
+    auto count = std::min(chunks.size(), parts.size());
+    for (auto i : loop::end(count))
+    {
+        parts[i] = {const_cast<u8*>(chunks[i].data), chunks[i].size};
+    }
+
+    auto* part = parts.data();
+    while (count != 0)
+    {
+        const auto written = ::writev(fd, part, static_cast<int>(std::min(count, u64{IOV_MAX})));
+        if (written < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return false;
+        }
+
+        auto remaining = static_cast<u64>(written);
+        while (count != 0 && remaining >= part->iov_len)
+        {
+            remaining -= part->iov_len;
+            part++;
+            count--;
+        }
+        if (count != 0)
+        {
+            part->iov_base = static_cast<u8*>(part->iov_base) + remaining;
+            part->iov_len -= remaining;
+        }
+    }
+    return true;
+#endif
+}
+
+constexpr auto luma(i32 r, i32 g, i32 b) noexcept
+{
+    return static_cast<u8>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+constexpr auto chroma_u(i32 r, i32 g, i32 b) noexcept
+{
+    return static_cast<u8>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+constexpr auto chroma_v(i32 r, i32 g, i32 b) noexcept
+{
+    return static_cast<u8>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// rounded up mean, the same as _mm_avg_epu8
+constexpr auto average(u8 a, u8 b) noexcept { return static_cast<u8>((a + b + 1) >> 1); }
+
+#if defined(__SSE2__)
+[[nodiscard]] inline auto load(const Color* pointer) noexcept
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pointer));
+}
+
+// the 2 products per pixel from _mm_madd_epi16 of 4 pixels, summed to 1 value per pixel
+[[nodiscard]] inline auto weigh(__m128i pixels, __m128i weights) noexcept
+{
+    const auto zero = _mm_setzero_si128();
+    const auto low  = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights));
+    const auto high = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights));
+
+    const auto first  = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+    const auto second = _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(first, second);
+}
+
+// 8 bit results of (weigh(pixels) + 128) >> 8 + offset for 2 groups of 4 pixels
+[[nodiscard]] inline auto weigh_8(__m128i a, __m128i b, __m128i weights, i16 offset) noexcept
+{
+    const auto rounding = _mm_set1_epi32(128);
+    const auto first    = _mm_srai_epi32(_mm_add_epi32(weigh(a, weights), rounding), 8);
+    const auto second   = _mm_srai_epi32(_mm_add_epi32(weigh(b, weights), rounding), 8);
+    return _mm_add_epi16(_mm_packs_epi32(first, second), _mm_set1_epi16(offset));
+}
+
+// mean of horizontally adjacent pixels: 8 pixels to 4
+[[nodiscard]] inline auto halve(__m128i a, __m128i b) noexcept
+{
+    const auto first  = _mm_castsi128_ps(a);
+    const auto second = _mm_castsi128_ps(b);
+    const auto even   = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+    const auto odd    = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_avg_epu8(even, odd);
+}
+#endif
+
+SM_INLINE void rgba_to_i420(const Image& image, u8* y, u8* u, u8* v)
+{
+    const auto width        = image.dims.x;
+    const auto height       = image.dims.y;
+    const auto chroma_width = (width + 1) / 2;
+
+    for (auto row : loop::end(height))
+    {
+        const auto* in = image.data() + row * width;
+        auto* out      = y + row * width;
+        auto x         = u64{};
+
+#if defined(__SSE2__)
+        const auto weights = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+        for (; x + 16 <= width; x += 16)
+        {
+            const auto first  = weigh_8(load(in + x), load(in + x + 4), weights, 16);
+            const auto second = weigh_8(load(in + x + 8), load(in + x + 12), weights, 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                             _mm_packus_epi16(first, second));
+        }
+#endif
+
+        for (; x < width; x++) { out[x] = luma(in[x].r, in[x].g, in[x].b); }
+    }
+
+    for (auto chroma_row : loop::end((height + 1) / 2))
+    {
+        // an odd last row pairs with itself, as does an odd last column
+        const auto* top    = image.data() + 2 * chroma_row * width;
+        const auto* bottom = 2 * chroma_row + 1 < height ? top + width : top;
+        auto* u_out        = u + chroma_row * chroma_width;
+        auto* v_out        = v + chroma_row * chroma_width;
+        auto x             = u64{};
+
+#if defined(__SSE2__)
+        const auto u_weights = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+        const auto v_weights = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+        for (; 2 * x + 16 <= width; x += 8)
+        {
+            const auto column = [&](u64 offset)
+            { return _mm_avg_epu8(load(top + 2 * x + offset), load(bottom + 2 * x + offset)); };
+
+            const auto first  = halve(column(0), column(4));
+            const auto second = halve(column(8), column(12));
+
+            const auto zero = _mm_setzero_si128();
+            const auto u_8  = _mm_packus_epi16(weigh_8(first, second, u_weights, 128), zero);
+            const auto v_8  = _mm_packus_epi16(weigh_8(first, second, v_weights, 128), zero);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(u_out + x), u_8);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(v_out + x), v_8);
+        }
+#endif
+
+        for (; x < chroma_width; x++)
+        {
+            const auto left  = 2 * x;
+            const auto right = left + 1 < width ? left + 1 : left;
+
+            const auto mean = [&](u8 Color::*channel)
+            {
+                const auto left_mean  = average(top[left].*channel, bottom[left].*channel);
+                const auto right_mean = average(top[right].*channel, bottom[right].*channel);
+                return static_cast<i32>(average(left_mean, right_mean));
+            };
+
+            const auto r = mean(&Color::r);
+            const auto g = mean(&Color::g);
+            const auto b = mean(&Color::b);
+            u_out[x]     = chroma_u(r, g, b);
+            v_out[x]     = chroma_v(r, g, b);
+        }
+    }
+}
+} // namespace detail
+
+SM_INLINE
+VideoWriter::VideoWriter(int file_descriptor, Dimensions dims_, VideoFormat format_, u64 fps)
+    : fd{file_descriptor}, dims{dims_}, format{format_}
+{
+    if (format == VideoFormat::Y4m)
+    {
+        header = fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n", dims.x, dims.y, fps);
+        buffer.resize(dims.x * dims.y + 2 * ((dims.x + 1) / 2) * ((dims.y + 1) / 2));
+    }
+}
+
+SM_INLINE VideoWriter::VideoWriter(VideoWriter&& other) noexcept
+    : fd{std::exchange(other.fd, -1)}, owns_fd{std::exchange(other.owns_fd, false)},
+      process{std::exchange(other.process, nullptr)}, dims{other.dims}, format{other.format},
+      header{std::move(other.header)}, buffer{std::move(other.buffer)}, frames{other.frames}
+{
+}
+
+SM_INLINE VideoWriter::~VideoWriter()
+{
+    if (process != nullptr)
+    {
+#if defined(_WIN32)
+        _pclose(process);
+#else
+        pclose(process);
+#endif
+    }
+    else if (owns_fd && fd >= 0)
+    {
+#if defined(_WIN32)
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+}
+
+SM_INLINE auto
+VideoWriter::open(const Path& file_path, Dimensions dims, VideoFormat format, u64 fps)
+    -> Result<VideoWriter>
+{
+#if defined(_WIN32)
+    const auto fd = _open(file_path.string().c_str(),
+                          _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    const auto fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) { return make_unexpected(fmt::format("could not open {}", file_path)); }
+
+    auto writer    = VideoWriter{fd, dims, format, fps};
+    writer.owns_fd = true;
+    return {std::move(writer)};
+}
+
+SM_INLINE auto
+VideoWriter::pipe(const std::string& command, Dimensions dims, VideoFormat format, u64 fps)
+    -> Result<VideoWriter>
+{
+#if defined(_WIN32)
+    auto* process = _popen(command.c_str(), "wb");
+#else
+    auto* process = popen(command.c_str(), "w");
+#endif
+    if (process == nullptr)
+    {
+        return make_unexpected(fmt::format("could not start '{}'", command));
+    }
+
+#if defined(_WIN32)
+    auto writer = VideoWriter{_fileno(process), dims, format, fps};
+#else
+    auto writer = VideoWriter{fileno(process), dims, format, fps};
+#endif
+    writer.process = process;
+    return {std::move(writer)};
+}
+
+SM_INLINE auto VideoWriter::write(const Image& image) -> Result<void>
+{
+    if (image.dims != dims)
+    {
+        return make_unexpected(fmt::format("VideoWriter: frame is {}x{}, expected {}x{}",
+                                           image.dims.x, image.dims.y, dims.x, dims.y));
+    }
+
+    auto chunks = std::array<detail::Chunk, 4>{};
+    auto count  = u64{};
+    const auto add = [&](const void* data, u64 size)
+    { chunks[count++] = {static_cast<const u8*>(data), size}; };
+
+    if (frames == 0 && !header.empty()) { add(header.data(), header.size()); }
+
+    if (format == VideoFormat::Y4m)
+    {
+        static constexpr auto frame_header = std::string_view{"FRAME\n"};
+        auto* y = buffer.data();
+        detail::rgba_to_i420(image, y, y + image.size(),
+                             y + image.size() + (buffer.size() - image.size()) / 2);
+        add(frame_header.data(), frame_header.size());
+        add(buffer.data(), buffer.size());
+    }
+    else { add(image.data(), image.byte_size()); }
+
+    if (!detail::write_all(fd, std::span{chunks.data(), count}))
+    {
+        return make_unexpected(fmt::format("VideoWriter: writing frame {} failed", frames));
+    }
+
+    frames++;
+    return {};
+}
+} // namespace sm::file
+
+#endif
@@ -0,0 +1,569 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#pragma once
+
+#include <span>   // for span
+#include <vector> // for vector
+
+#include "samarium/core/types.hpp" // for u8, u32, u64
+
+namespace sm::deflate
+{
+/**
+ * @brief               Compress PNG scanlines of 4 byte pixels (each a filter byte followed by
+ * width pixels) into deflate blocks, appending them to out. Runs of identical pixels become
+ * matches at distance 4, like fpng, and every strip gets its own Huffman table
+ *
+ * @details The output starts and ends on a byte boundary: unless final is set it ends with an
+ * empty stored block (a sync flush). So strips compressed independently, eg on different threads,
+ * can be concatenated into one zlib stream. Falls back to stored blocks if Huffman coding would
+ * be larger
+ *
+ * @param  rows         Filtered scanlines, (1 + 4 * width) bytes each
+ * @param  width        Pixels per scanline
+ * @param  final        Whether these are the last blocks of the stream
+ * @param  out          Appended to
+ */
+void compress_rows(std::span<const u8> rows, u64 width, bool final, std::vector<u8>& out);
+
+/**
+ * @brief               The Adler-32 of two buffers concatenated, from their individual checksums
+ *
+ * @param  first        Adler-32 of the first buffer
+ * @param  second       Adler-32 of the second buffer
+ * @param  second_size  Size in bytes of the second buffer
+ */
+[[nodiscard]] auto adler32_combine(u32 first, u32 second, u64 second_size) -> u32;
+
+/**
+ * @brief               The CRC-32 of two buffers concatenated, from their individual checksums
+ *
+ * @param  first        CRC-32 of the first buffer
+ * @param  second       CRC-32 of the second buffer
+ * @param  second_size  Size in bytes of the second buffer
+ */
+[[nodiscard]] auto crc32_combine(u32 first, u32 second, u64 second_size) -> u32;
+} // namespace sm::deflate
+
+
+#if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_DEFLATE_IMPL)
+
+#include <algorithm> // for sort, fill, min
+#include <array>     // for array, to_array
+#include <bit>       // for endian
+#include <cstring>   // for memcpy
+
+#include "samarium/core/inline.hpp" // for SM_INLINE
+
+namespace sm::deflate
+{
+namespace detail
+{
+struct Code
+{
+    u32 bits{}; // bit-reversed, as deflate writes Huffman codes from the most significant bit
+    u32 length{};
+};
+
+struct LengthCode
+{
+    u32 symbol{};
+    u32 extra_bits{};
+    u32 extra{};
+};
+
+// symbol, extra bits and their value for every match length
+inline constexpr auto length_codes = []
+{
+    constexpr auto base  = std::to_array<u32>({3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                               15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                               67, 83, 99, 115, 131, 163, 195, 227, 258});
+    constexpr auto extra = std::to_array<u32>(
+        {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0});
+
+    auto codes = std::array<LengthCode, 259>{};
+    for (u32 i = 0; i < base.size(); i++)
+    {
+        const auto end = i + 1 == base.size() ? 259U : base[i + 1];
+        for (auto length = base[i]; length < end; length++)
+        {
+            codes[length] = {257 + i, extra[i], length - base[i]};
+        }
+    }
+    return codes;
+}();
+
+// code length code lengths are written in this order, so that trailing ones are likely unused
+inline constexpr auto code_length_order =
+    std::to_array<u8>({16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15});
+
+constexpr auto literal_count     = u32{286};
+constexpr auto end_of_block      = u32{256};
+constexpr auto max_match_pixels  = u64{64}; // 256 bytes, within the 258 byte limit
+constexpr auto max_stored_length = u64{65535};
+
+class BitWriter
+{
+  public:
+    explicit BitWriter(u8* out_) : out{out_} {}
+
+    void put(u32 bits, u32 length)
+    {
+        buffer |= u64{bits} << count;
+        count += length;
+        if (count >= 32)
+        {
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                std::memcpy(out, &buffer, 4);
+            }
+            else
+            {
+                for (u32 i = 0; i < 4; i++) { out[i] = static_cast<u8>(buffer >> (8 * i)); }
+            }
+            out += 4;
+            buffer >>= 32;
+            count -= 32;
+        }
+    }
+
+    void put(Code code) { put(code.bits, code.length); }
+
+    // pad with zeros to a byte boundary and return the end of the output
+    auto align() -> u8*
+    {
+        for (; count > 0; count = count > 8 ? count - 8 : 0)
+        {
+            *out++ = static_cast<u8>(buffer);
+            buffer >>= 8;
+        }
+        return out;
+    }
+
+  private:
+    u8* out;
+    u64 buffer{};
+    u32 count{};
+};
+
+inline auto load_pixel(const u8* pixel)
+{
+    auto value = u32{};
+    std::memcpy(&value, pixel, 4);
+    return value;
+}
+
+// calls literal(byte) for filter bytes, pixel(bytes) for 4 literals and match(length), the same
+// way for both passes
+template <typename Literal, typename Pixel, typename Match>
+void tokenize(std::span<const u8> rows, u64 width, Literal&& literal, Pixel&& pixel, Match&& match)
+{
+    const auto row_size = 1 + 4 * width;
+    for (u64 offset = 0; offset < rows.size(); offset += row_size)
+    {
+        const auto* row = rows.data() + offset;
+        literal(row[0]);
+        if (width == 0) { continue; } // the row is only its filter byte
+
+        const auto* pixels = row + 1;
+        auto previous      = load_pixel(pixels);
+        pixel(pixels);
+
+        auto x = u64{1};
+        while (x < width)
+        {
+            const auto current = load_pixel(pixels + 4 * x);
+            if (current == previous)
+            {
+                auto run = u64{1};
+                while (x + run < width && run < max_match_pixels &&
+                       load_pixel(pixels + 4 * (x + run)) == previous)
+                {
+                    run++;
+                }
+                match(4 * run);
+                x += run;
+            }
+            else
+            {
+                pixel(pixels + 4 * x);
+                previous = current;
+                x++;
+            }
+        }
+    }
+}
+
+// length-limited Huffman code lengths for frequencies
+inline void build_lengths(std::span<const u64> frequencies, u32 max_length, std::span<u8> lengths)
+{
+    std::fill(lengths.begin(), lengths.end(), u8{});
+
+    auto symbols      = std::array<u32, literal_count>{};
+    auto symbol_count = u64{};
+    for (u32 i = 0; i < frequencies.size(); i++)
+    {
+        if (frequencies[i] != 0) { symbols[symbol_count++] = i; }
+    }
+
+    if (symbol_count == 0) { return; }
+    if (symbol_count == 1)
+    {
+        // a one symbol code isn't complete, so pair it with an unused symbol
+        lengths[symbols[0]]                  = 1;
+        lengths[symbols[0] == 0 ? 1U : 0U] = 1;
+        return;
+    }
+
+    std::sort(symbols.begin(), symbols.begin() + static_cast<i64>(symbol_count),
+              [&](u32 a, u32 b) { return frequencies[a] < frequencies[b]; });
+
+    // two-queue Huffman: leaves are sorted, and internal nodes are created in weight order
+    auto weights = std::array<u64, 2 * literal_count>{};
+    auto parents = std::array<u64, 2 * literal_count>{};
+    for (u64 i = 0; i < symbol_count; i++) { weights[i] = frequencies[symbols[i]]; }
+
+    auto next_leaf = u64{};
+    auto next_node = symbol_count;
+    const auto take_smallest = [&](u64 end)
+    {
+        if (next_leaf < symbol_count &&
+            (next_node >= end || weights[next_leaf] <= weights[next_node]))
+        {
+            return next_leaf++;
+        }
+        return next_node++;
+    };
+
+    const auto root = 2 * symbol_count - 2;
+    for (auto node = symbol_count; node <= root; node++)
+    {
+        const auto a  = take_smallest(node);
+        const auto b  = take_smallest(node);
+        weights[node] = weights[a] + weights[b];
+        parents[a]    = node;
+        parents[b]    = node;
+    }
+
+    // reuse weights as depths, walking from the root down
+    auto counts   = std::array<u64, 16>{};
+    weights[root] = 0;
+    for (auto node = root; node-- > 0;)
+    {
+        weights[node] = weights[parents[node]] + 1;
+        if (node < symbol_count) { counts[std::min<u64>(weights[node], max_length)]++; }
+    }
+
+    // clamping made the code over-subscribed: lengthen codes until the Kraft sum is 1 again
+    auto total = u64{};
+    for (u32 length = 1; length <= max_length; length++)
+    {
+        total += counts[length] << (max_length - length);
+    }
+    for (; total > (u64{1} << max_length); total--)
+    {
+        counts[max_length]--;
+        for (auto length = max_length - 1; length > 0; length--)
+        {
+            if (counts[length] != 0)
+            {
+                counts[length]--;
+                counts[length + 1] += 2;
+                break;
+            }
+        }
+    }
+
+    // the rarest symbols get the longest codes
+    auto index = u64{};
+    for (auto length = max_length; length > 0; length--)
+    {
+        for (u64 i = 0; i < counts[length]; i++)
+        {
+            lengths[symbols[index++]] = static_cast<u8>(length);
+        }
+    }
+}
+
+inline void build_codes(std::span<const u8> lengths, std::span<Code> codes)
+{
+    auto counts = std::array<u32, 16>{};
+    for (auto length : lengths) { counts[length]++; }
+    counts[0] = 0;
+
+    auto next = std::array<u32, 16>{};
+    auto code = u32{};
+    for (u32 length = 1; length < 16; length++)
+    {
+        code         = (code + counts[length - 1]) << 1;
+        next[length] = code;
+    }
+
+    for (u64 i = 0; i < lengths.size(); i++)
+    {
+        const auto length = u32{lengths[i]};
+        if (length == 0) { continue; }
+
+        const auto canonical = next[length]++;
+        auto reversed        = u32{};
+        for (u32 bit = 0; bit < length; bit++)
+        {
+            reversed |= ((canonical >> bit) & 1U) << (length - 1 - bit);
+        }
+        codes[i] = {reversed, length};
+    }
+}
+
+inline void compress_stored(std::span<const u8> rows, bool final, std::vector<u8>& out)
+{
+    auto offset = u64{};
+    do {
+        const auto size = std::min(rows.size() - offset, max_stored_length);
+        const auto last = offset + size == rows.size();
+
+        // the 3 bit block header, padded to a byte, then the length and its complement
+        const auto header = std::to_array<u8>(
+            {static_cast<u8>(final && last), static_cast<u8>(size), static_cast<u8>(size >> 8),
+             static_cast<u8>(~size), static_cast<u8>(~size >> 8)});
+        out.insert(out.end(), header.begin(), header.end());
+        out.insert(out.end(), rows.begin() + static_cast<i64>(offset),
+                   rows.begin() + static_cast<i64>(offset + size));
+        offset += size;
+    } while (offset < rows.size());
+}
+} // namespace detail
+
+SM_INLINE void compress_rows(std::span<const u8> rows, u64 width, bool final, std::vector<u8>& out)
+{
+    // first pass: count symbols
+    auto frequencies = std::array<u64, detail::literal_count>{};
+    auto extra_bits  = u64{};
+    detail::tokenize(
+        rows, width, [&](u8 byte) { frequencies[byte]++; },
+        [&](const u8* pixel)
+        {
+            frequencies[pixel[0]]++;
+            frequencies[pixel[1]]++;
+            frequencies[pixel[2]]++;
+            frequencies[pixel[3]]++;
+        },
+        [&](u64 length)
+        {
+            const auto& code = detail::length_codes[length];
+            frequencies[code.symbol]++;
+            extra_bits += code.extra_bits + 1; // + 1 for the distance code
+        });
+    frequencies[detail::end_of_block] = 1;
+
+    auto literal_lengths = std::array<u8, detail::literal_count>{};
+    detail::build_lengths(frequencies, 15, literal_lengths);
+
+    // every match has distance 4 (symbol 3), and symbol 0 makes the distance code complete
+    constexpr auto distance_lengths = std::to_array<u8>({1, 0, 0, 1});
+
+    auto literal_end = detail::literal_count;
+    while (literal_lengths[literal_end - 1] == 0) { literal_end--; }
+
+    // run-length encode the code lengths with symbols 16 (repeat), 17 and 18 (zeros)
+    struct Run
+    {
+        u32 symbol;
+        u32 extra;
+    };
+    auto runs      = std::array<Run, detail::literal_count + distance_lengths.size()>{};
+    auto run_count = u64{};
+    auto all_lengths = std::array<u8, detail::literal_count + distance_lengths.size()>{};
+    std::copy_n(literal_lengths.begin(), literal_end, all_lengths.begin());
+    std::copy(distance_lengths.begin(), distance_lengths.end(), all_lengths.begin() + literal_end);
+    const auto length_count = literal_end + distance_lengths.size();
+
+    for (u64 i = 0; i < length_count;)
+    {
+        const auto value = u32{all_lengths[i]};
+        auto repeat      = u64{1};
+        while (i + repeat < length_count && all_lengths[i + repeat] == value) { repeat++; }
+        i += repeat;
+
+        if (value == 0)
+        {
+            for (; repeat >= 11; repeat -= std::min<u64>(repeat, 138))
+            {
+                runs[run_count++] = {18, static_cast<u32>(std::min<u64>(repeat, 138) - 11)};
+            }
+            if (repeat >= 3)
+            {
+                runs[run_count++] = {17, static_cast<u32>(repeat - 3)};
+                repeat            = 0;
+            }
+        }
+        else
+        {
+            runs[run_count++] = {value, 0};
+            repeat--;
+            for (; repeat >= 3; repeat -= std::min<u64>(repeat, 6))
+            {
+                runs[run_count++] = {16, static_cast<u32>(std::min<u64>(repeat, 6) - 3)};
+            }
+        }
+        for (; repeat > 0; repeat--) { runs[run_count++] = {value, 0}; }
+    }
+
+    auto run_frequencies = std::array<u64, 19>{};
+    for (u64 i = 0; i < run_count; i++) { run_frequencies[runs[i].symbol]++; }
+    auto run_lengths = std::array<u8, 19>{};
+    detail::build_lengths(run_frequencies, 7, run_lengths);
+
+    auto run_length_count = detail::code_length_order.size();
+    while (run_length_count > 4 &&
+           run_lengths[detail::code_length_order[run_length_count - 1]] == 0)
+    {
+        run_length_count--;
+    }
+
+    // exact size, to choose between Huffman and stored blocks and to size the output
+    constexpr auto run_extra_bits = std::to_array<u64>({2, 3, 7});
+    auto bits                     = 3 + 5 + 5 + 4 + 3 * run_length_count + extra_bits;
+    for (u64 i = 0; i < run_count; i++)
+    {
+        bits += run_lengths[runs[i].symbol] +
+                (runs[i].symbol >= 16 ? run_extra_bits[runs[i].symbol - 16] : 0);
+    }
+    for (u64 i = 0; i < literal_end; i++) { bits += frequencies[i] * literal_lengths[i]; }
+    if (!final) { bits += 3 + 7 + 32; } // sync flush
+
+    const auto stored_blocks =
+        (rows.size() + detail::max_stored_length - 1) / detail::max_stored_length;
+    const auto stored_size = rows.size() + 5 * stored_blocks;
+    if ((bits + 7) / 8 >= stored_size)
+    {
+        detail::compress_stored(rows, final, out);
+        return;
+    }
+
+    auto literal_codes = std::array<detail::Code, detail::literal_count>{};
+    detail::build_codes(literal_lengths, literal_codes);
+    auto run_codes = std::array<detail::Code, 19>{};
+    detail::build_codes(run_lengths, run_codes);
+
+    const auto start = out.size();
+    out.resize(start + (bits + 7) / 8 + 8); // + 8 as BitWriter writes 4 bytes at a time
+    auto writer = detail::BitWriter{out.data() + start};
+
+    writer.put(final ? 1 : 0, 1);
+    writer.put(2, 2); // dynamic Huffman
+    writer.put(static_cast<u32>(literal_end - 257), 5);
+    writer.put(static_cast<u32>(distance_lengths.size() - 1), 5);
+    writer.put(static_cast<u32>(run_length_count - 4), 4);
+    for (u64 i = 0; i < run_length_count; i++)
+    {
+        writer.put(run_lengths[detail::code_length_order[i]], 3);
+    }
+    for (u64 i = 0; i < run_count; i++)
+    {
+        const auto [symbol, extra] = runs[i];
+        writer.put(run_codes[symbol]);
+        if (symbol >= 16) { writer.put(extra, static_cast<u32>(run_extra_bits[symbol - 16])); }
+    }
+
+    // distance symbol 3 has the canonical code 1
+    detail::tokenize(
+        rows, width, [&](u8 byte) { writer.put(literal_codes[byte]); },
+        [&](const u8* pixel)
+        {
+            // two codes of at most 15 bits at a time
+            const auto& r = literal_codes[pixel[0]];
+            const auto& g = literal_codes[pixel[1]];
+            const auto& b = literal_codes[pixel[2]];
+            const auto& a = literal_codes[pixel[3]];
+            writer.put(r.bits | (g.bits << r.length), r.length + g.length);
+            writer.put(b.bits | (a.bits << b.length), b.length + a.length);
+        },
+        [&](u64 length)
+        {
+            const auto& code     = detail::length_codes[length];
+            const auto& huffman  = literal_codes[code.symbol];
+            const auto code_bits = huffman.length + code.extra_bits;
+            writer.put(huffman.bits | (code.extra << huffman.length) | (1U << code_bits),
+                       code_bits + 1);
+        });
+    writer.put(literal_codes[detail::end_of_block]);
+
+    if (!final) { writer.put(0, 3); }
+    auto* end = writer.align();
+    if (!final)
+    {
+        constexpr auto flush = std::to_array<u8>({0x00, 0x00, 0xFF, 0xFF});
+        end                  = std::copy(flush.begin(), flush.end(), end);
+    }
+    out.resize(static_cast<u64>(end - out.data()));
+}
+
+SM_INLINE auto adler32_combine(u32 first, u32 second, u64 second_size) -> u32
+{
+    // from zlib's adler32_combine
+    constexpr auto base = u32{65521};
+
+    const auto remainder = static_cast<u32>(second_size % base);
+    auto sum1            = first & 0xFFFFU;
+    auto sum2            = static_cast<u32>((u64{remainder} * sum1) % base);
+    sum1 += (second & 0xFFFFU) + base - 1;
+    sum2 += (first >> 16) + (second >> 16) + base - remainder;
+    if (sum1 >= base) { sum1 -= base; }
+    if (sum1 >= base) { sum1 -= base; }
+    if (sum2 >= 2 * base) { sum2 -= 2 * base; }
+    if (sum2 >= base) { sum2 -= base; }
+    return sum1 | (sum2 << 16);
+}
+
+namespace detail
+{
+constexpr auto crc32_polynomial = u32{0xEDB88320};
+
+// a * b modulo the CRC polynomial, with bits reflected so that x^0 is the top bit
+constexpr auto multiply_mod_polynomial(u32 a, u32 b)
+{
+    auto product = u32{};
+    for (auto mask = u32{1} << 31; mask != 0; mask >>= 1)
+    {
+        if ((a & mask) != 0) { product ^= b; }
+        b = (b & 1U) != 0 ? (b >> 1) ^ crc32_polynomial : b >> 1;
+    }
+    return product;
+}
+
+// x^(2^n) modulo the CRC polynomial, which repeat after 32
+inline constexpr auto crc32_powers = []
+{
+    auto powers = std::array<u32, 32>{};
+    auto power  = u32{1} << 30; // x^1
+    for (auto& value : powers)
+    {
+        value = power;
+        power = multiply_mod_polynomial(power, power);
+    }
+    return powers;
+}();
+} // namespace detail
+
+SM_INLINE auto crc32_combine(u32 first, u32 second, u64 second_size) -> u32
+{
+    // shift first by second_size zero bytes, ie multiply it by x^(8 * second_size)
+    auto shift = u32{1} << 31; // x^0
+    auto bits  = second_size;
+    for (u64 n = 3; bits != 0; bits >>= 1, n++)
+    {
+        if ((bits & 1U) != 0)
+        {
+            shift = detail::multiply_mod_polynomial(detail::crc32_powers[n % 32], shift);
+        }
+    }
+    return detail::multiply_mod_polynomial(shift, first) ^ second;
+}
+} // namespace sm::deflate
+
+#endif
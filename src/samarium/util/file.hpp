@@ -9,11 +9,15 @@
 
 #include <filesystem>       // for path
 #include <initializer_list> // for initializer_list
+#include <span>             // for span
 #include <string>           // for string, operator+
+#include <utility>          // for pair
+#include <vector>           // for vector
 
-#include "samarium/math/Vector2.hpp" // for Dimensions
-#include "samarium/util/Grid.hpp"    // for Image
-#include "samarium/util/format.hpp"  // for date_time_str
+#include "samarium/math/Vector2.hpp"    // for Dimensions
+#include "samarium/util/Grid.hpp"       // for Image
+#include "samarium/util/ThreadPool.hpp" // for ThreadPool
+#include "samarium/util/format.hpp"     // for date_time_str
 
 #include "Result.hpp"    // for Result
 #include "fpng/fpng.hpp" // for fpng_encode_image_to_file
@@ -30,34 +34,80 @@ static constexpr auto text = Text{};
 
 struct Targa
 {
+    static constexpr auto extension = ".tga";
 };
 
 static constexpr auto targa = Targa{};
 
 struct Pam
 {
+    static constexpr auto extension = ".pam";
 };
 
 static constexpr auto pam = Pam{};
 
 struct Png
 {
+    static constexpr auto extension = ".png";
 };
 
 static constexpr auto png = Png{};
 
 struct Bmp
 {
+    static constexpr auto extension = ".bmp";
 };
 
 static constexpr auto bmp = Bmp{};
 
+/**
+ * @brief The Quite OK Image format: lossless, and much faster to encode and decode than PNG
+ *
+ * @details See https://qoiformat.org/qoi-specification.pdf
+ */
+struct Qoi
+{
+    static constexpr auto extension = ".qoi";
+};
+
+static constexpr auto qoi = Qoi{};
+
 auto read([[maybe_unused]] Text tag, const Path& file_path) -> Result<std::string>;
 
 auto read(const Path& file_path) -> Result<std::string>;
 
+/**
+ * @brief               Read a PNG, JPEG, Targa, BMP, PSD, GIF, HDR, PIC, PNM or QOI file. The file
+ * is memory-mapped and decoded in place
+ */
 auto read_image(const Path& file_path) -> Result<Image>;
 
+auto read_image([[maybe_unused]] Qoi tag, const Path& file_path) -> Result<Image>;
+
+/**
+ * @brief               Read every image file directly in directory, decoding on thread_pool
+ *
+ * @return              Each path with its Image (or error), sorted by path
+ */
+auto read_images(const Path& directory, ThreadPool& thread_pool)
+    -> std::vector<std::pair<Path, Result<Image>>>;
+
+/**
+ * @brief               Decode an image in memory, in any format read_image() reads. The format
+ * is detected from the contents
+ */
+auto decode(std::span<const u8> bytes) -> Result<Image>;
+
+/**
+ * @brief               Decode a QOI image in memory
+ */
+auto decode([[maybe_unused]] Qoi tag, std::span<const u8> bytes) -> Result<Image>;
+
+/**
+ * @brief               Encode image as QOI into bytes, replacing its contents
+ */
+void encode([[maybe_unused]] Qoi tag, const Image& image, std::vector<u8>& bytes);
+
 
 void write([[maybe_unused]] Targa tag,
            const Image& image,
@@ -82,10 +132,33 @@ inline void write(Png, const Image& image, const Path& file_path = date_time_str
         static_cast<u32>(image.dims.x), static_cast<u32>(image.dims.y), 4U);
 }
 
+/**
+ * @brief               Encode image as PNG into bytes, replacing its contents. Strips of rows are
+ * deflated in parallel on thread_pool and joined into one IDAT chunk, for large frames where
+ * single threaded encoding dominates export time
+ */
+void encode([[maybe_unused]] Png tag,
+            const Image& image,
+            std::vector<u8>& bytes,
+            ThreadPool& thread_pool);
+
+/**
+ * @brief               Write image as a PNG, deflating strips of rows in parallel on thread_pool
+ */
+void write([[maybe_unused]] Png tag,
+           const Image& image,
+           const Path& file_path,
+           ThreadPool& thread_pool);
+
 void write([[maybe_unused]] Bmp tag,
            const Image& image,
            const Path& file_path = date_time_str() + ".bmp");
 
+void write([[maybe_unused]] Qoi tag,
+           const Image& image,
+           const Path& file_path = date_time_str() + ".qoi");
+
+// walks the directory on every call, use AssetIndex for repeated lookups
 auto find(const std::string& file_name, const Path& directory = std::filesystem::current_path())
     -> Result<Path>;
 
@@ -97,12 +170,19 @@ auto find(const std::string& file_name, std::initializer_list<Path> search_paths
 
 #if defined(SAMARIUM_HEADER_ONLY) || defined(SAMARIUM_FILE_IMPL)
 
-#include <array>      // for to_array, array
-#include <cstring>    // for memcpy
-#include <filesystem> // for path
-#include <fstream>    // for ifstream, ofstream, basic_ostream::write
-#include <iterator>   // for ifstreambuf_iterator
-#include <string>     // for string
+#include <algorithm>   // for min, max, fill_n, copy_n, sort, find, equal, transform
+#include <array>       // for to_array, array
+#include <bit>         // for bit_cast
+#include <cctype>      // for tolower
+#include <cstring>     // for memcpy
+#include <filesystem>  // for path, directory_iterator
+#include <fstream>     // for ifstream, ofstream, basic_ostream::write
+#include <iterator>    // for ifstreambuf_iterator
+#include <limits>      // for numeric_limits
+#include <optional>    // for optional
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
 
 #include "fmt/os.h"
 #include "range/v3/algorithm/copy.hpp"
@@ -114,12 +194,16 @@ auto find(const std::string& file_name, std::initializer_list<Path> search_paths
 #include "stb_image.h"
 #include "stb_image_write.h"
 
-#include "samarium/core/inline.hpp"    // for SM_INLINE
-#include "samarium/core/types.hpp"     // for u8
-#include "samarium/graphics/Color.hpp" // for BGR_t, bgr
-#include "samarium/math/Extents.hpp"   // for range
-#include "samarium/math/Vector2.hpp"   // for Dimensions
-#include "samarium/util/Grid.hpp"      // for Image
+#include "samarium/core/inline.hpp"      // for SM_INLINE
+#include "samarium/core/types.hpp"       // for u8
+#include "samarium/graphics/Color.hpp"   // for BGR_t, bgr, bgra
+#include "samarium/graphics/swizzle.hpp" // for swizzle, expand
+#include "samarium/math/Extents.hpp"     // for range
+#include "samarium/math/Vector2.hpp"     // for Dimensions
+#include "samarium/util/Error.hpp"       // for Error
+#include "samarium/util/Grid.hpp"        // for Image
+#include "samarium/util/MappedFile.hpp"  // for MappedFile
+#include "samarium/util/deflate.hpp"     // for compress_rows, adler32_combine, crc32_combine
 
 #include "fpng/fpng.hpp"
 
@@ -147,67 +231,163 @@ SM_INLINE auto read(const Path& file_path) -> Result<std::string>
 
 SM_INLINE auto read_image(const Path& file_path) -> Result<Image>
 {
-    if (!std::filesystem::exists(file_path))
+    const auto file = MappedFile::open(file_path);
+    if (!file) { return make_unexpected(file.error()); }
+
+    auto image = decode(file->bytes());
+    if (!image) { return make_unexpected(fmt::format("{}: {}", file_path, image.error())); }
+    return image;
+}
+
+SM_INLINE auto read_images(const Path& directory, ThreadPool& thread_pool)
+    -> std::vector<std::pair<Path, Result<Image>>>
+{
+    static constexpr auto extensions =
+        std::to_array<std::string_view>({".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif",
+                                         ".hdr", ".pic", ".pnm", ".ppm", ".pgm", Qoi::extension});
+
+    auto paths = std::vector<Path>{};
+    for (const auto& entry : std::filesystem::directory_iterator{directory})
     {
-        return {make_unexpected(fmt::format("{} does not exist", file_path))};
+        auto extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](char character)
+                       { return static_cast<char>(std::tolower(static_cast<u8>(character))); });
+
+        if (entry.is_regular_file() &&
+            std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+        {
+            paths.push_back(entry.path());
+        }
     }
-    if (!std::filesystem::is_regular_file(file_path))
+    std::sort(paths.begin(), paths.end());
+
+    // Image isn't assignable, so decode into optionals and move them out afterwards
+    auto images = std::vector<std::optional<Result<Image>>>(paths.size());
+    parallelize_loop(
+        &thread_pool, paths.size(),
+        [&](u64 min, u64 max)
+        {
+            for (auto i : loop::start_end(min, max)) { images[i].emplace(read_image(paths[i])); }
+        },
+        4); // file sizes vary, so use smaller blocks
+
+    auto results = std::vector<std::pair<Path, Result<Image>>>{};
+    results.reserve(paths.size());
+    for (auto i : loop::end(paths.size()))
     {
-        return {make_unexpected(fmt::format("{} is not a file", file_path))};
+        results.emplace_back(std::move(paths[i]), std::move(*images[i]));
     }
+    return results;
+}
 
-    auto width         = 0;
-    auto height        = 0;
-    auto channel_count = 0;
-
-    const auto data = stbi_load(file_path.string().c_str(), &width, &height, &channel_count, 0);
+SM_INLINE auto decode(std::span<const u8> bytes) -> Result<Image>
+{
+    static constexpr auto qoi_magic     = std::to_array<u8>({'q', 'o', 'i', 'f'});
+    static constexpr auto png_signature =
+        std::to_array<u8>({0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'});
 
-    if (data == nullptr)
+    const auto starts_with = [bytes](const auto& magic)
     {
-        return {make_unexpected(fmt::format("stb_load failed while reading {}", file_path))};
-    }
+        return bytes.size() >= magic.size() &&
+               std::equal(magic.begin(), magic.end(), bytes.begin());
+    };
 
-    auto image = Image{{static_cast<u64>(width), static_cast<u64>(height)}};
+    if (starts_with(qoi_magic)) { return decode(qoi, bytes); }
 
-    if (channel_count == 4) { std::memcpy(&image.front(), data, image.size() * 4); }
-    else if (channel_count == 3)
+    if (starts_with(png_signature) && bytes.size() <= std::numeric_limits<u32>::max())
     {
-        for (auto i : loop::end(image.size()))
+        // fpng only decodes the PNGs it wrote (eg with write(png)), and is much faster at it than
+        // stb_image. Others fall through to stb_image
+        thread_local auto pixels = std::vector<u8>{};
+        auto width               = u32{};
+        auto height              = u32{};
+        auto channel_count       = u32{};
+
+        if (fpng::fpng_decode_memory(bytes.data(), static_cast<u32>(bytes.size()), pixels, width,
+                                     height, channel_count, 4) == fpng::FPNG_DECODE_SUCCESS)
         {
-            image[i].r = data[i * 3];
-            image[i].g = data[i * 3 + 1];
-            image[i].b = data[i * 3 + 2];
+            auto image = Image{{width, height}};
+            std::memcpy(image.data(), pixels.data(), image.byte_size());
+            return {std::move(image)};
         }
     }
-    else if (channel_count == 2)
+
+    if (bytes.size() > static_cast<u64>(std::numeric_limits<i32>::max()))
     {
-        for (auto i : loop::end(image.size()))
-        {
-            const auto value = data[i * 2];
-            image[i].r       = value;
-            image[i].g       = value;
-            image[i].b       = value;
-            image[i].a       = data[i * 2 + 1];
-        }
+        return make_unexpected(fmt::format("{} bytes is too large to decode", bytes.size()));
     }
-    else if (channel_count == 1)
+
+    auto width         = 0;
+    auto height        = 0;
+    auto channel_count = 0;
+
+    auto* data = stbi_load_from_memory(bytes.data(), static_cast<i32>(bytes.size()), &width,
+                                       &height, &channel_count, 0);
+    if (data == nullptr)
     {
-        for (auto i : loop::end(image.size()))
+        return make_unexpected(fmt::format("stb_image failed: {}", stbi_failure_reason()));
+    }
+
+    auto image          = Image{{static_cast<u64>(width), static_cast<u64>(height)}};
+    const auto channels = static_cast<u64>(channel_count);
+    expand({data, image.size() * channels}, channels, image.elements);
+    stbi_image_free(data);
+
+    return {std::move(image)};
+}
+
+namespace detail
+{
+/**
+ * @brief Convert rows of image to format in a small reused buffer and write them a strip at a
+ * time, so that writing never holds a converted copy of the whole image
+ */
+template <concepts::ColorFormat Format>
+void write_rows(std::ostream& stream, const Image& image, Format format, bool bottom_up = false)
+{
+    constexpr auto strip_bytes = u64{1} << 16;
+
+    const auto row_bytes      = image.dims.x * Format::length;
+    const auto rows_per_strip = std::max(strip_bytes / std::max(row_bytes, u64{1}), u64{1});
+
+    thread_local auto buffer = std::vector<u8>{};
+    buffer.resize(rows_per_strip * row_bytes);
+
+    for (auto strip = u64{}; strip < image.dims.y; strip += rows_per_strip)
+    {
+        const auto rows = std::min(rows_per_strip, image.dims.y - strip);
+        for (auto i : loop::end(rows))
         {
-            const auto value = data[i];
-            image[i].r       = value;
-            image[i].g       = value;
-            image[i].b       = value;
+            const auto y = bottom_up ? image.dims.y - 1 - (strip + i) : strip + i;
+            swizzle(std::span{image.data() + y * image.dims.x, image.dims.x}, format,
+                    std::span{buffer}.subspan(i * row_bytes, row_bytes));
         }
+        stream.write(reinterpret_cast<const char*>(buffer.data()),
+                     static_cast<std::streamsize>(rows * row_bytes));
     }
-    else
+}
+
+// value as size little-endian bytes at offset
+template <u64 Size>
+constexpr void put_le(std::array<u8, Size>& bytes, u64 offset, u64 value, u64 size)
+{
+    for (auto i : loop::end(size))
     {
-        return make_unexpected(
-            fmt::format("{} has unknown channel count: {}", file_path, channel_count));
+        bytes[offset + i] = static_cast<u8>(255 & (value >> (8 * i)));
     }
+}
 
-    return {image};
+// value as size big-endian bytes at offset
+template <u64 Size>
+constexpr void put_be(std::array<u8, Size>& bytes, u64 offset, u64 value, u64 size)
+{
+    for (auto i : loop::end(size))
+    {
+        bytes[offset + i] = static_cast<u8>(255 & (value >> (8 * (size - 1 - i))));
+    }
 }
+} // namespace detail
 
 SM_INLINE void write([[maybe_unused]] Targa tag, const Image& image, const Path& file_path)
 {
@@ -216,12 +396,9 @@ SM_INLINE void write([[maybe_unused]] Targa tag, const Image& image, const Path&
          static_cast<u8>(255 & (image.dims.x >> 8)), static_cast<u8>(255 & image.dims.y),
          static_cast<u8>(255 & (image.dims.y >> 8)), 24, 32});
 
-    const auto data = image.formatted_data(bgr);
-
-    std::ofstream(file_path, std::ios::binary)
-        .write(reinterpret_cast<const char*>(&header[0]), header.size())
-        .write(reinterpret_cast<const char*>(&data[0]),
-               static_cast<std::streamsize>(data.size() * data[0].size()));
+    auto stream = std::ofstream(file_path, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(&header[0]), header.size());
+    detail::write_rows(stream, image, bgr);
 }
 
 SM_INLINE void write([[maybe_unused]] Pam tag, const Image& image, const Path& file_path)
@@ -244,11 +421,385 @@ ENDHDR
 
 SM_INLINE void write([[maybe_unused]] Bmp tag, const Image& image, const Path& file_path)
 {
-    stbi_write_bmp(file_path.string().c_str(), static_cast<i32>(image.dims.x),
-                   static_cast<i32>(image.dims.y), 4 /* RGBA */,
-                   static_cast<const void*>(&image.front()));
+    // same layout stbi_write_bmp uses for 4 channels: a BITMAPV4HEADER with an alpha mask and
+    // 32 bit BGRA rows, bottom row first
+    constexpr auto header_size = u64{14 + 108};
+    const auto image_size      = image.size() * 4;
+
+    auto header = std::array<u8, header_size>{'B', 'M'};
+    detail::put_le(header, 2, header_size + image_size, 4); // file size
+    detail::put_le(header, 10, header_size, 4);             // offset of the pixels
+    detail::put_le(header, 14, 108, 4);                     // size of the info header
+    detail::put_le(header, 18, image.dims.x, 4);
+    detail::put_le(header, 22, image.dims.y, 4);
+    detail::put_le(header, 26, 1, 2);  // planes
+    detail::put_le(header, 28, 32, 2); // bits per pixel
+    detail::put_le(header, 30, 3, 4);  // BI_BITFIELDS
+    detail::put_le(header, 54, 0x00FF'0000, 4);
+    detail::put_le(header, 58, 0x0000'FF00, 4);
+    detail::put_le(header, 62, 0x0000'00FF, 4);
+    detail::put_le(header, 66, 0xFF00'0000, 4);
+
+    auto stream = std::ofstream(file_path, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(header.data()), header_size);
+    detail::write_rows(stream, image, bgra, true);
+}
+
+namespace detail
+{
+[[nodiscard]] constexpr auto qoi_hash(Color color) noexcept -> u64
+{
+    return (color.r * u64{3} + color.g * u64{5} + color.b * u64{7} + color.a * u64{11}) & 63;
+}
+
+// encode into a fixed buffer, handing it to flush(const u8*, u64) whenever it fills up
+template <typename Flush> void encode_qoi(const Image& image, Flush&& flush)
+{
+    constexpr auto buffer_size = u64{1} << 16;
+
+    auto buffer = std::array<u8, buffer_size>{};
+    auto* out   = buffer.data();
+    // checked before each pixel, whose ops (at most a run and a QOI_OP_RGBA) are up to 6 bytes,
+    // and before the 8 byte end marker
+    const auto* flush_at = buffer.data() + buffer_size - 8;
+    const auto flush_if_full = [&]
+    {
+        if (out < flush_at) { return; }
+        flush(buffer.data(), static_cast<u64>(out - buffer.data()));
+        out = buffer.data();
+    };
+
+    const auto put_u32 = [&](u64 value)
+    {
+        for (auto shift : {24, 16, 8, 0}) { *out++ = static_cast<u8>(255 & (value >> shift)); }
+    };
+
+    for (auto byte : {'q', 'o', 'i', 'f'}) { *out++ = static_cast<u8>(byte); }
+    put_u32(image.dims.x);
+    put_u32(image.dims.y);
+    *out++ = 4; // channels
+    *out++ = 0; // sRGB with linear alpha
+
+    // zero initialised as in the specification, Color{} would be opaque black
+    auto index = std::array<Color, 64>{};
+    index.fill(Color{0, 0, 0, 0});
+
+    auto previous   = Color{0, 0, 0, 255};
+    auto run        = u8{};
+    const auto* end = image.data() + image.size();
+
+    for (const auto* pixel = image.data(); pixel != end; pixel++)
+    {
+        flush_if_full();
+
+        const auto color = *pixel;
+        if (std::bit_cast<u32>(color) == std::bit_cast<u32>(previous))
+        {
+            run++;
+            if (run == 62 || pixel + 1 == end)
+            {
+                *out++ = static_cast<u8>(0xC0 | (run - 1)); // QOI_OP_RUN
+                run    = 0;
+            }
+            continue;
+        }
+
+        if (run != 0)
+        {
+            *out++ = static_cast<u8>(0xC0 | (run - 1));
+            run    = 0;
+        }
+
+        const auto hash = qoi_hash(color);
+        if (std::bit_cast<u32>(index[hash]) == std::bit_cast<u32>(color))
+        {
+            *out++ = static_cast<u8>(hash); // QOI_OP_INDEX
+        }
+        else if (color.a == previous.a)
+        {
+            index[hash] = color;
+
+            const auto difference = [](u8 a, u8 b) { return static_cast<i8>(a - b); };
+            const auto dr         = difference(color.r, previous.r);
+            const auto dg         = difference(color.g, previous.g);
+            const auto db         = difference(color.b, previous.b);
+            const auto dr_dg      = dr - dg;
+            const auto db_dg      = db - dg;
+
+            if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+            {
+                *out++ = static_cast<u8>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)); // DIFF
+            }
+            else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8)
+            {
+                *out++ = static_cast<u8>(0x80 | (dg + 32)); // QOI_OP_LUMA
+                *out++ = static_cast<u8>((dr_dg + 8) << 4 | (db_dg + 8));
+            }
+            else
+            {
+                *out++ = 0xFE; // QOI_OP_RGB
+                *out++ = color.r;
+                *out++ = color.g;
+                *out++ = color.b;
+            }
+        }
+        else
+        {
+            index[hash] = color;
+            *out++      = 0xFF; // QOI_OP_RGBA
+            *out++      = color.r;
+            *out++      = color.g;
+            *out++      = color.b;
+            *out++      = color.a;
+        }
+
+        previous = color;
+    }
+
+    flush_if_full();
+    for (auto i : loop::end(8)) { *out++ = i == 7 ? 1 : 0; }
+    flush(buffer.data(), static_cast<u64>(out - buffer.data()));
 }
+} // namespace detail
+
+SM_INLINE void encode([[maybe_unused]] Qoi tag, const Image& image, std::vector<u8>& bytes)
+{
+    bytes.clear();
+    detail::encode_qoi(image, [&bytes](const u8* data, u64 size)
+                       { bytes.insert(bytes.end(), data, data + size); });
+}
+
+SM_INLINE auto decode([[maybe_unused]] Qoi tag, std::span<const u8> bytes) -> Result<Image>
+{
+    constexpr auto header_size = u64{14};
+    constexpr auto end_size    = u64{8};
 
+    if (bytes.size() < header_size + end_size || bytes[0] != 'q' || bytes[1] != 'o' ||
+        bytes[2] != 'i' || bytes[3] != 'f')
+    {
+        return make_unexpected(std::string{"not a QOI image"});
+    }
+
+    const auto get_u32 = [&](u64 offset)
+    {
+        return u64{bytes[offset]} << 24 | u64{bytes[offset + 1]} << 16 |
+               u64{bytes[offset + 2]} << 8 | u64{bytes[offset + 3]};
+    };
+    const auto dims = Dimensions{get_u32(4), get_u32(8)};
+    // the specification's limit, which also keeps dims.x * dims.y from overflowing
+    if (dims.x == 0 || dims.y == 0 || dims.x * dims.y > 400'000'000)
+    {
+        return make_unexpected(fmt::format("QOI image has invalid size {}x{}", dims.x, dims.y));
+    }
+
+    auto image = Image{dims};
+    auto index = std::array<Color, 64>{};
+    index.fill(Color{0, 0, 0, 0});
+
+    auto previous          = Color{0, 0, 0, 255};
+    const auto* in         = bytes.data() + header_size;
+    const auto* chunks_end = bytes.data() + bytes.size() - end_size;
+    auto* out              = image.data();
+    const auto* out_end    = out + image.size();
+
+    const auto add = [](u8 value, i32 delta) { return static_cast<u8>(value + delta); };
+
+    while (out != out_end)
+    {
+        // every op is at most 5 bytes, and the 8 byte end marker follows the last one
+        if (in >= chunks_end) { return make_unexpected(std::string{"QOI image is truncated"}); }
+
+        const auto op = *in++;
+        if (op == 0xFE)
+        {
+            previous.r = in[0];
+            previous.g = in[1];
+            previous.b = in[2];
+            in += 3;
+        }
+        else if (op == 0xFF)
+        {
+            previous = Color{in[0], in[1], in[2], in[3]};
+            in += 4;
+        }
+        else if ((op >> 6) == 0) { previous = index[op]; }
+        else if ((op >> 6) == 1)
+        {
+            previous.r = add(previous.r, ((op >> 4) & 3) - 2);
+            previous.g = add(previous.g, ((op >> 2) & 3) - 2);
+            previous.b = add(previous.b, (op & 3) - 2);
+        }
+        else if ((op >> 6) == 2)
+        {
+            const auto dg   = (op & 63) - 32;
+            const auto next = *in++;
+            previous.r      = add(previous.r, dg - 8 + (next >> 4));
+            previous.g      = add(previous.g, dg);
+            previous.b      = add(previous.b, dg - 8 + (next & 15));
+        }
+        else
+        {
+            // all but the last pixel of the run, which is written below like any other op
+            const auto run =
+                std::min(static_cast<u64>(op & 63), static_cast<u64>(out_end - out) - 1);
+            std::fill_n(out, run, previous);
+            out += run;
+        }
+
+        // after runs too, as the reference decoder does, which matters if the image starts with one
+        index[detail::qoi_hash(previous)] = previous;
+        *out++                            = previous;
+    }
+
+    return {std::move(image)};
+}
+
+SM_INLINE auto read_image([[maybe_unused]] Qoi tag, const Path& file_path) -> Result<Image>
+{
+    const auto file = MappedFile::open(file_path);
+    if (!file) { return make_unexpected(file.error()); }
+
+    auto image = decode(qoi, file->bytes());
+    if (!image) { return make_unexpected(fmt::format("{}: {}", file_path, image.error())); }
+    return image;
+}
+
+SM_INLINE void write([[maybe_unused]] Qoi tag, const Image& image, const Path& file_path)
+{
+    auto stream = std::ofstream(file_path, std::ios::binary);
+    detail::encode_qoi(image, [&stream](const u8* data, u64 size)
+                       { stream.write(reinterpret_cast<const char*>(data),
+                                      static_cast<std::streamsize>(size)); });
+}
+
+
+namespace detail
+{
+// encode as PNG, handing each piece to flush(const u8*, u64) in order
+template <typename Flush>
+void encode_png(const Image& image, ThreadPool& thread_pool, Flush&& flush)
+{
+    struct Strip
+    {
+        std::vector<u8> bytes{};
+        u32 adler{};
+        u32 crc{};
+        u64 raw_size{};
+    };
+
+    const auto width    = image.dims.x;
+    const auto height   = image.dims.y;
+    const auto row_size = 1 + 4 * width;
+
+    // several strips per thread balance uneven content, but each one pays for a Huffman table, so
+    // keep them above 64KiB
+    const auto target_strips  = std::clamp(row_size * height >> 16, u64{1},
+                                           4 * u64{thread_pool.get_thread_count()});
+    const auto rows_per_strip = std::max((height + target_strips - 1) / target_strips, u64{1});
+
+    // at least one, so that an image with no rows still ends its zlib stream with a final block
+    const auto strip_count = std::max((height + rows_per_strip - 1) / rows_per_strip, u64{1});
+
+    auto strips = std::vector<Strip>(strip_count);
+    parallelize_loop(
+        &thread_pool, strip_count,
+        [&](u64 min, u64 max)
+        {
+            thread_local auto filtered = std::vector<u8>{};
+            for (auto index : loop::start_end(min, max))
+            {
+                const auto first = index * rows_per_strip;
+                const auto last  = std::min(first + rows_per_strip, height);
+                filtered.resize((last - first) * row_size);
+
+                // None for the first row and Up for the rest, like fpng. Up can read the row
+                // above across strips, since filtering is independent of compression
+                for (auto y : loop::start_end(first, last))
+                {
+                    auto* out = filtered.data() + (y - first) * row_size;
+                    const auto* row = reinterpret_cast<const u8*>(image.data() + y * width);
+                    out[0]          = y == 0 ? 0 : 2;
+                    // copy_n, as row is null when width is 0
+                    if (y == 0) { std::copy_n(row, 4 * width, out + 1); }
+                    else
+                    {
+                        const auto* above = row - 4 * width;
+                        for (auto i : loop::end(4 * width))
+                        {
+                            out[1 + i] = static_cast<u8>(row[i] - above[i]);
+                        }
+                    }
+                }
+
+                auto& strip    = strips[index];
+                strip.raw_size = filtered.size();
+                strip.adler    = fpng::fpng_adler32(filtered.data(), filtered.size());
+                deflate::compress_rows(filtered, width, index + 1 == strip_count, strip.bytes);
+                strip.crc = fpng::fpng_crc32(strip.bytes.data(), strip.bytes.size());
+            }
+        },
+        4);
+
+    // the zlib header, then each strip's blocks, then the Adler-32 of the filtered rows
+    auto idat_size = u64{2 + 4};
+    auto adler     = fpng::FPNG_ADLER32_INIT;
+    for (const auto& strip : strips)
+    {
+        idat_size += strip.bytes.size();
+        adler = deflate::adler32_combine(adler, strip.adler, strip.raw_size);
+    }
+    if (idat_size > 0x7FFF'FFFF)
+    {
+        throw Error{fmt::format("{} bytes is too large for a PNG chunk", idat_size)};
+    }
+
+    auto header = std::to_array<u8>({0x89, 'P',  'N', 'G', '\r', '\n', 0x1A, '\n', 0,   0,   0,
+                                     13,   'I',  'H', 'D', 'R',  0,    0,    0,    0,    0,   0,
+                                     0,    0,    8,   6,   0,    0,    0,    0,    0,    0,   0,
+                                     0,    0,    0,   0,   'I',  'D',  'A',  'T',  0x78, 0x01});
+    put_be(header, 16, width, 4);
+    put_be(header, 20, height, 4);
+    put_be(header, 29, fpng::fpng_crc32(header.data() + 12, 17), 4);
+    put_be(header, 33, idat_size, 4);
+    flush(header.data(), header.size());
+
+    auto crc = fpng::fpng_crc32(header.data() + 37, 6);
+    for (const auto& strip : strips)
+    {
+        flush(strip.bytes.data(), strip.bytes.size());
+        crc = deflate::crc32_combine(crc, strip.crc, strip.bytes.size());
+    }
+
+    auto trailer = std::to_array<u8>({0, 0, 0, 0, 0, 0, 0, 0, 0,    0,    0,    0,
+                                      'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82});
+    put_be(trailer, 0, adler, 4);
+    put_be(trailer, 4, fpng::fpng_crc32(trailer.data(), 4, crc), 4);
+    flush(trailer.data(), trailer.size());
+}
+} // namespace detail
+
+SM_INLINE void encode([[maybe_unused]] Png tag,
+                      const Image& image,
+                      std::vector<u8>& bytes,
+                      ThreadPool& thread_pool)
+{
+    bytes.clear();
+    detail::encode_png(image, thread_pool, [&bytes](const u8* data, u64 size)
+                       { bytes.insert(bytes.end(), data, data + size); });
+}
+
+SM_INLINE void write([[maybe_unused]] Png tag,
+                     const Image& image,
+                     const Path& file_path,
+                     ThreadPool& thread_pool)
+{
+    auto stream = std::ofstream(file_path, std::ios::binary);
+    detail::encode_png(image, thread_pool,
+                       [&stream](const u8* data, u64 size) {
+                           stream.write(reinterpret_cast<const char*>(data),
+                                        static_cast<std::streamsize>(size));
+                       });
+}
 
 SM_INLINE auto find(const std::string& file_name, const Path& directory) -> Result<Path>
 {
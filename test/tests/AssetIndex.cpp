@@ -0,0 +1,118 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <filesystem> // for temp_directory_path, create_directories, remove_all
+#include <fstream>    // for ofstream
+#include <string>     // for string
+
+#include "samarium/util/AssetIndex.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+void touch(const file::Path& path) { std::ofstream{path} << path.filename().string(); }
+
+void write_cache(const file::Path& path, const std::string& contents)
+{
+    std::ofstream{path} << contents;
+}
+} // namespace
+
+TEST_CASE("AssetIndex")
+{
+    const auto directory = std::filesystem::temp_directory_path() / "samarium_asset_index_test";
+    const auto root      = directory / "assets";
+    const auto cache     = directory / "index";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(root / "fonts" / "mono");
+    std::filesystem::create_directories(root / "images");
+    touch(root / "readme.txt");
+    touch(root / "fonts" / "mono" / "Roboto.ttf");
+    touch(root / "images" / "logo.png");
+    touch(root / "images" / "readme.txt");
+
+    SECTION("find")
+    {
+        const auto index = file::AssetIndex{{root}};
+        REQUIRE(index.file_count() == 4);
+        REQUIRE(index.find("Roboto.ttf").value().filename() == "Roboto.ttf");
+        REQUIRE(index.find_all("readme.txt").size() == 2);
+        REQUIRE(!index.find("missing.png"));
+    }
+
+    SECTION("save, load and update")
+    {
+        {
+            const auto index = file::AssetIndex{{root}};
+            REQUIRE(index.save(cache));
+        }
+
+        auto loaded = file::AssetIndex::load(cache);
+        REQUIRE(loaded);
+        REQUIRE(loaded->file_count() == 4);
+        REQUIRE(loaded->find("logo.png").value() == file::AssetIndex{{root}}.find("logo.png"));
+        REQUIRE(!loaded->update());
+
+        touch(root / "fonts" / "mono" / "Added.ttf");
+        REQUIRE(loaded->update());
+        REQUIRE(loaded->file_count() == 5);
+        REQUIRE(loaded->find("Added.ttf"));
+        REQUIRE(!loaded->update());
+
+        // cached() re-walks what changed since the cache was saved, and saves it again
+        touch(root / "images" / "icon.png");
+        const auto cached = file::AssetIndex::cached({root}, cache);
+        REQUIRE(cached.file_count() == 6);
+        REQUIRE(cached.find("icon.png"));
+        REQUIRE(file::AssetIndex::load(cache).value().find("icon.png"));
+    }
+
+#if !defined(_WIN32)
+    SECTION("paths with line breaks round trip")
+    {
+        touch(root / "two\nlines%0A.txt");
+        {
+            const auto index = file::AssetIndex{{root}};
+            REQUIRE(index.save(cache));
+        }
+
+        const auto loaded = file::AssetIndex::load(cache);
+        REQUIRE(loaded);
+        REQUIRE(loaded->file_count() == 5);
+        REQUIRE(loaded->find("two\nlines%0A.txt"));
+        REQUIRE(!loaded->find("two"));
+    }
+#endif
+
+    SECTION("invalid caches are errors")
+    {
+        const auto header = std::string{"samarium asset index 2\n"};
+
+        write_cache(cache, header + "root /a\ndir x /a\n");
+        REQUIRE(!file::AssetIndex::load(cache));
+        write_cache(cache, header + "root /a\ndir 99999999999999999999999 /a\n");
+        REQUIRE(!file::AssetIndex::load(cache));
+        write_cache(cache, header + "root /a\ndir 12\n");
+        REQUIRE(!file::AssetIndex::load(cache));
+        write_cache(cache, header + "root /a\nfile /a/%zz\n");
+        REQUIRE(!file::AssetIndex::load(cache));
+        write_cache(cache, header + "file /a/b\n");
+        REQUIRE(!file::AssetIndex::load(cache));
+        write_cache(cache, "samarium asset index 1\nroot /a\n");
+        REQUIRE(!file::AssetIndex::load(cache));
+
+        write_cache(cache, header + "root /a\ndir -1 /a\nfile /a/100%25.txt\n");
+        const auto loaded = file::AssetIndex::load(cache);
+        REQUIRE(loaded);
+        REQUIRE(loaded->find("100%.txt"));
+    }
+
+    std::filesystem::remove_all(directory);
+}
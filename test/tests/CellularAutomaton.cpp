@@ -0,0 +1,118 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <array>  // for to_array
+#include <vector> // for vector
+
+#include "samarium/physics/CellularAutomaton.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+auto live_cells(const CellularAutomaton& automaton)
+{
+    auto cells = std::vector<Indices>{};
+    for (auto y : loop::end(automaton.dims().y))
+    {
+        for (auto x : loop::end(automaton.dims().x))
+        {
+            if (automaton.get({x, y})) { cells.push_back({x, y}); }
+        }
+    }
+    return cells;
+}
+} // namespace
+
+TEST_CASE("LifeRule::from_string")
+{
+    const auto conway = LifeRule::from_string("B3/S23");
+    REQUIRE(conway);
+    REQUIRE(conway->birth == life_rules::conway.birth);
+    REQUIRE(conway->survival == life_rules::conway.survival);
+
+    const auto highlife = LifeRule::from_string("b36/s23");
+    REQUIRE(highlife);
+    REQUIRE(highlife->birth == life_rules::highlife.birth);
+    REQUIRE(highlife->survival == life_rules::highlife.survival);
+
+    const auto seeds = LifeRule::from_string("B2/S");
+    REQUIRE(seeds);
+    REQUIRE(seeds->birth == life_rules::seeds.birth);
+    REQUIRE(seeds->survival == 0);
+
+    REQUIRE(!LifeRule::from_string("B9/S23"));
+    REQUIRE(!LifeRule::from_string("B3/S2x"));
+    REQUIRE(!LifeRule::from_string("3/23"));
+}
+
+TEST_CASE("CellularAutomaton")
+{
+    SECTION("blinker has period 2")
+    {
+        // across the boundary between the first two words of the row
+        auto automaton = CellularAutomaton{{100, 20}};
+        for (auto x : std::to_array<u64>({63, 64, 65})) { automaton.set({x, 10}); }
+        const auto start = live_cells(automaton);
+
+        automaton.step();
+        REQUIRE(live_cells(automaton) == std::vector<Indices>{{64, 9}, {64, 10}, {64, 11}});
+        automaton.step();
+        REQUIRE(live_cells(automaton) == start);
+        REQUIRE(automaton.generation() == 2);
+    }
+
+    SECTION("glider has period 4")
+    {
+        // starts in the upper half of a word in the first tile, and moves down and right across
+        // words, then into the tiles right of (x 256), below (y 64) and diagonal to it
+        auto automaton = CellularAutomaton{{320, 128}};
+        const auto x0  = u64{231};
+        const auto y0  = u64{40};
+        for (auto [x, y] : std::vector<Indices>{{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}})
+        {
+            automaton.set({x0 + x, y0 + y});
+        }
+
+        for (auto generation : loop::end(u64{4} * 60))
+        {
+            if (generation % 4 == 0)
+            {
+                const auto x = x0 + generation / 4;
+                const auto y = y0 + generation / 4;
+                REQUIRE(automaton.population() == 5);
+                REQUIRE(live_cells(automaton) == std::vector<Indices>{{x + 1, y + 0},
+                                                                      {x + 2, y + 1},
+                                                                      {x + 0, y + 2},
+                                                                      {x + 1, y + 2},
+                                                                      {x + 2, y + 2}});
+            }
+            automaton.step();
+        }
+
+        // now wholly in the diagonal tile
+        REQUIRE(automaton.population() == 5);
+        REQUIRE(live_cells(automaton).front().x >= CellularAutomaton::tile_words * 64);
+        REQUIRE(live_cells(automaton).front().y >= CellularAutomaton::tile_rows);
+    }
+
+    SECTION("every bit of a word is a cell")
+    {
+        auto automaton = CellularAutomaton{{130, 3}};
+        auto rng       = RandomGenerator{};
+        automaton.randomize(rng, 1.0);
+        REQUIRE(automaton.population() == 130 * 3);
+
+        automaton.clear();
+        automaton.set({127, 1});
+        REQUIRE(automaton.get({127, 1}));
+        REQUIRE(!automaton.get({63, 1}));
+        REQUIRE(automaton.population() == 1);
+    }
+}
@@ -0,0 +1,280 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <bit>        // for bit_cast
+#include <cmath>      // for sin, cos, ldexp, isnan
+#include <filesystem> // for temp_directory_path, remove
+#include <limits>     // for numeric_limits
+#include <utility>    // for pair
+#include <vector>     // for vector
+
+#include "samarium/util/FieldSeries.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+// slowly changing, except for a few cells that change completely every frame and a block that
+// never changes, so that frames have both zero and literal runs after the delta
+auto scalar_frame(Dimensions dims, u64 frame)
+{
+    return ScalarField::generate(
+        dims,
+        [frame](Indices pos)
+        {
+            const auto [x, y] = pos.cast<f64>();
+            const auto t      = static_cast<f64>(frame);
+            if (pos.x < 10 && pos.y < 10) { return -0.0; }
+            if ((pos.x * 7 + pos.y * 3 + frame) % 31 == 0) { return 1e300 * (t - 4.5); }
+            return std::sin(0.1 * x + 0.01 * t) * std::cos(0.07 * y) + 1e-9 * t;
+        });
+}
+
+auto same_bits(f64 a, f64 b) { return std::bit_cast<u64>(a) == std::bit_cast<u64>(b); }
+
+// every element of region, compared bit for bit so that -0.0 and NaN count
+auto same_region(const ScalarField& read, const ScalarField& written, BoundingBox<u64> region)
+{
+    if (read.dims != region.max - region.min + Indices{1, 1}) { return false; }
+    for (auto y : loop::end(read.dims.y))
+    {
+        for (auto x : loop::end(read.dims.x))
+        {
+            if (!same_bits(read[{x, y}], written[region.min + Indices{x, y}])) { return false; }
+        }
+    }
+    return true;
+}
+
+// write values as one frame of a ScalarField, and read them back
+auto quantize(const file::Path& path,
+              const std::vector<f64>& values,
+              file::FieldPrecision precision)
+{
+    const auto dims = Dimensions{values.size(), 1};
+    {
+        auto writer = file::FieldWriter{path, dims, 1, {.precision = precision}};
+        writer.write(ScalarField{values, dims});
+        REQUIRE(writer.flush());
+    }
+
+    const auto reader = file::FieldReader::open(path);
+    REQUIRE(reader);
+    REQUIRE(reader->precision() == precision);
+    const auto field = reader->read<f64>(0);
+    REQUIRE(field);
+    return std::vector<f64>(field->begin(), field->end());
+}
+} // namespace
+
+TEST_CASE("FieldWriter and FieldReader")
+{
+    const auto path = std::filesystem::temp_directory_path() / "samarium_field_series_test.smf";
+
+    SECTION("F64 is lossless")
+    {
+        // not a multiple of the tiles, so the last column and row of tiles are partial
+        const auto dims        = Dimensions{70, 45};
+        const auto frame_count = u64{11};
+        auto frames            = std::vector<ScalarField>{};
+        for (auto frame : loop::end(frame_count)) { frames.push_back(scalar_frame(dims, frame)); }
+
+        {
+            auto writer = file::FieldWriter{path, dims, 1,
+                                            {.precision         = file::FieldPrecision::F64,
+                                             .tile_dims         = {16, 16},
+                                             .keyframe_interval = 4}};
+            for (const auto& frame : frames) { writer.write(frame); }
+            REQUIRE(writer.flush());
+            REQUIRE(writer.frame_count() == frame_count);
+        }
+
+        const auto reader = file::FieldReader::open(path);
+        REQUIRE(reader);
+        REQUIRE(reader->dims() == dims);
+        REQUIRE(reader->components() == 1);
+        REQUIRE(reader->precision() == file::FieldPrecision::F64);
+        REQUIRE(reader->frame_count() == frame_count);
+
+        const auto whole = BoundingBox<u64>{{0, 0}, dims - Indices{1, 1}};
+        const auto regions =
+            std::vector<BoundingBox<u64>>{whole,
+                                          {{17, 18}, {20, 22}},  // inside one tile
+                                          {{15, 15}, {16, 16}},  // a corner of four tiles
+                                          {{60, 40}, {69, 44}},  // in the partial tiles
+                                          {{33, 0}, {33, 44}}}; // one column
+
+        // frames 4 and 8 are keyframes, and the ones after are deltas from them
+        for (auto frame : loop::end(frame_count))
+        {
+            for (const auto& region : regions)
+            {
+                const auto read = reader->read<f64>(frame, region);
+                REQUIRE(read);
+                REQUIRE(same_region(*read, frames[frame], region));
+            }
+        }
+
+        // out of order, so that no decoding state carries over from the previous read
+        for (auto frame : {u64{9}, u64{2}, u64{10}, u64{5}})
+        {
+            const auto read = reader->read<f64>(frame);
+            REQUIRE(read);
+            REQUIRE(same_region(*read, frames[frame], whole));
+        }
+
+        REQUIRE(!reader->read<f64>(frame_count));
+        REQUIRE(!reader->read<f64>(0, {{0, 0}, {70, 10}}));
+        REQUIRE(!reader->read<Vector2>(0));
+    }
+
+    SECTION("VectorField")
+    {
+        const auto dims = Dimensions{33, 20};
+        {
+            auto writer = file::FieldWriter{path, dims, 2,
+                                            {.precision         = file::FieldPrecision::F64,
+                                             .tile_dims         = {8, 8},
+                                             .keyframe_interval = 2}};
+            for (auto frame : loop::end(u64{5}))
+            {
+                writer.write(VectorField::generate(
+                    dims, [frame](Indices pos) { return (pos + Indices{frame, 0}).cast<f64>(); }));
+            }
+            REQUIRE(writer.flush());
+        }
+
+        const auto reader = file::FieldReader::open(path);
+        REQUIRE(reader);
+        REQUIRE(reader->components() == 2);
+
+        const auto read = reader->read<Vector2>(3, {{5, 6}, {12, 9}});
+        REQUIRE(read);
+        REQUIRE(read->dims == Dimensions{8, 4});
+        REQUIRE((*read)[{0, 0}] == Vector2{8, 6});
+        REQUIRE((*read)[{7, 3}] == Vector2{15, 9});
+    }
+
+    SECTION("F32 rounds to the nearest f32")
+    {
+        constexpr auto infinity = std::numeric_limits<f64>::infinity();
+
+        // {value, its f32}
+        const auto table = std::vector<std::pair<f64, f64>>{
+            {0.0, 0.0},
+            {-0.0, -0.0},
+            {1.0, 1.0},
+            {0.1, 0.100000001490116119384765625},
+            {-1.0 / 3.0, -0.3333333432674407958984375},
+            {16'777'217.0, 16'777'216.0}, // a tie, to the even 2^24
+            {16'777'219.0, 16'777'220.0}, // a tie, to the even 2^24 + 4
+            {std::ldexp(1.0, -149), std::ldexp(1.0, -149)}, // the smallest subnormal
+            {std::ldexp(1.0, -151), 0.0},
+            {1e-300, 0.0},
+            {3.4028234663852886e38, 3.4028234663852886e38}, // the largest f32
+            {1e300, infinity},
+            {-1e300, -infinity},
+            {infinity, infinity}};
+
+        auto values = std::vector<f64>{};
+        for (const auto& [value, single] : table) { values.push_back(value); }
+        const auto read = quantize(path, values, file::FieldPrecision::F32);
+        for (auto i : loop::end(table.size()))
+        {
+            INFO("value " << table[i].first);
+            REQUIRE(same_bits(read[i], table[i].second));
+        }
+
+        REQUIRE(std::isnan(
+            quantize(path, {std::numeric_limits<f64>::quiet_NaN()}, file::FieldPrecision::F32)[0]));
+    }
+
+    SECTION("F16 rounds to the nearest half, ties to even")
+    {
+        constexpr auto infinity = std::numeric_limits<f64>::infinity();
+        const auto half_ulp     = std::ldexp(1.0, -11); // of 1.0
+        const auto subnormal    = std::ldexp(1.0, -24); // the smallest half
+
+        // {value, its half}
+        const auto table = std::vector<std::pair<f64, f64>>{
+            {0.0, 0.0},
+            {-0.0, -0.0},
+            {1.0, 1.0},
+            {-2.0, -2.0},
+            {0.1, 0.0999755859375},
+            {1.0 + half_ulp, 1.0},                       // a tie, to the even 1.0
+            {1.0 + 3 * half_ulp, 1.0 + 4 * half_ulp},    // a tie, to the even mantissa 2
+            {1.0 + 1.5 * half_ulp, 1.0 + 2 * half_ulp},  // above the tie
+            {65'504.0, 65'504.0},                        // the largest half
+            {65'519.0, 65'504.0},                        // just below the tie with infinity
+            {65'520.0, infinity},                        // the tie, to the even infinity
+            {1e6, infinity},
+            {-1e6, -infinity},
+            {1e300, infinity},
+            {infinity, infinity},
+            {-infinity, -infinity},
+            {subnormal, subnormal},
+            {0.5 * subnormal, 0.0},                      // a tie, to the even 0
+            {-0.5 * subnormal, -0.0},
+            {1.5 * subnormal, 2 * subnormal},            // a tie, to the even 2
+            {0.25 * subnormal, 0.0},
+            {1023 * subnormal, 1023 * subnormal},        // the largest subnormal
+            {1023.5 * subnormal, std::ldexp(1.0, -14)},  // a tie, to the smallest normal
+            {std::ldexp(1.0, -14), std::ldexp(1.0, -14)},
+            {1e-300, 0.0}};
+
+        auto values = std::vector<f64>{};
+        for (const auto& [value, half] : table) { values.push_back(value); }
+        const auto read = quantize(path, values, file::FieldPrecision::F16);
+        for (auto i : loop::end(table.size()))
+        {
+            INFO("value " << table[i].first);
+            REQUIRE(same_bits(read[i], table[i].second));
+        }
+
+        REQUIRE(std::isnan(
+            quantize(path, {std::numeric_limits<f64>::quiet_NaN()}, file::FieldPrecision::F16)[0]));
+    }
+
+    SECTION("F16 frames past keyframes")
+    {
+        // multiples of 1/8 below 256 are exact halves, so every frame reads back exactly
+        const auto dims  = Dimensions{21, 13};
+        const auto frame = [dims](u64 index)
+        {
+            return ScalarField::generate(dims,
+                                         [index](Indices pos)
+                                         {
+                                             const auto step = (pos.x + 3 * pos.y + index) % 64;
+                                             return pos.x < 8 ? 1.5 : static_cast<f64>(step) / 8.0;
+                                         });
+        };
+
+        {
+            auto writer = file::FieldWriter{path, dims, 1,
+                                            {.precision         = file::FieldPrecision::F16,
+                                             .tile_dims         = {8, 8},
+                                             .keyframe_interval = 3}};
+            for (auto index : loop::end(u64{8})) { writer.write(frame(index)); }
+            REQUIRE(writer.flush());
+        }
+
+        const auto reader = file::FieldReader::open(path);
+        REQUIRE(reader);
+        for (auto index : loop::end(u64{8}))
+        {
+            const auto region = BoundingBox<u64>{{5, 2}, {17, 12}};
+            const auto read   = reader->read<f64>(index, region);
+            REQUIRE(read);
+            REQUIRE(same_region(*read, frame(index), region));
+        }
+    }
+
+    std::filesystem::remove(path);
+}
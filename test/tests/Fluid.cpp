@@ -0,0 +1,64 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <cmath> // for sqrt
+
+#include "samarium/physics/Fluid.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+// root mean square of the central difference divergence, walls having zero normal velocity
+auto divergence_norm(const VectorField& velocity)
+{
+    const auto [width, height] = velocity.dims;
+    auto sum                   = 0.0;
+    for (auto y : loop::end(height))
+    {
+        for (auto x : loop::end(width))
+        {
+            const auto right  = x + 1 < width ? velocity[{x + 1, y}].x : 0.0;
+            const auto left   = x > 0 ? velocity[{x - 1, y}].x : 0.0;
+            const auto bottom = y + 1 < height ? velocity[{x, y + 1}].y : 0.0;
+            const auto top    = y > 0 ? velocity[{x, y - 1}].y : 0.0;
+
+            const auto divergence = 0.5 * (right - left + bottom - top);
+            sum += divergence * divergence;
+        }
+    }
+    return std::sqrt(sum / static_cast<f64>(velocity.size()));
+}
+} // namespace
+
+TEST_CASE("Fluid")
+{
+    SECTION("projection removes divergence")
+    {
+        auto fluid = Fluid{{64, 48}};
+        fluid.add_velocity({20.0, 20.0}, {5.0, 3.0}, 4.0);
+        fluid.add_velocity({40.0, 30.0}, {-4.0, 2.0}, 3.0);
+        const auto initial = divergence_norm(fluid.velocity);
+        REQUIRE(initial > 0.1);
+
+        // no time passes, so only the projection changes the velocity
+        fluid.update(0.0);
+        REQUIRE(divergence_norm(fluid.velocity) < 0.1 * initial);
+        fluid.update(0.0);
+        REQUIRE(divergence_norm(fluid.velocity) < 0.02 * initial);
+    }
+
+    SECTION("walls are closed")
+    {
+        auto fluid = Fluid{{32, 32}};
+        fluid.add_velocity({1.0, 16.0}, {-10.0, 0.0}, 3.0);
+        fluid.update(0.5);
+        for (auto y : loop::end(u64{32})) { REQUIRE(fluid.velocity[{0, y}].x == 0.0); }
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <filesystem> // for temp_directory_path, exists, remove_all
+
+#include "samarium/util/Error.hpp" // for Error
+#include "samarium/util/file.hpp"  // for Targa, write
+
+// a format that fails on frames whose first pixel is red, declared before FrameRecorder so that
+// it finds this write()
+namespace sm::file
+{
+struct FailsOnRed
+{
+    static constexpr auto extension = ".tga";
+};
+
+inline void write(FailsOnRed /* tag */, const Image& image, const Path& file_path)
+{
+    if (image[{0, 0}].r != 0) { throw Error{"red frame"}; }
+    write(Targa{}, image, file_path);
+}
+} // namespace sm::file
+
+#include "samarium/util/FrameRecorder.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+TEST_CASE("FrameRecorder")
+{
+    const auto directory = std::filesystem::temp_directory_path() / "samarium_frame_recorder_test";
+    std::filesystem::remove_all(directory);
+
+    {
+        auto recorder = FrameRecorder{file::FailsOnRed{}, {.directory = directory, .capacity = 2}};
+        for (auto i : loop::end(u64{6}))
+        {
+            const auto red = i == 1 || i == 4;
+            REQUIRE(recorder.submit(Image{{4, 4}, red ? Color{255, 0, 0} : Color{0, 0, 255}}));
+        }
+
+        // a failed frame is skipped without holding up the ones after it
+        const auto result = recorder.flush();
+        REQUIRE(!result);
+        REQUIRE(result.error().find("frame 1") != std::string::npos);
+
+        const auto stats = recorder.get_stats();
+        REQUIRE(stats.written == 4);
+        REQUIRE(stats.failed == 2);
+        for (auto i : loop::end(u64{6}))
+        {
+            REQUIRE(std::filesystem::exists(recorder.frame_path(i)) == (i != 1 && i != 4));
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+}
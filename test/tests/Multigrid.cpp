@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <cmath> // for sin, cos, sqrt
+
+#include "samarium/math/Multigrid.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+// norm of b - (a - laplacian) x, with the same closed boundaries as Multigrid
+auto residual_norm(const ScalarField& x, const ScalarField& b, f64 diagonal)
+{
+    const auto [width, height] = x.dims;
+    auto sum                   = 0.0;
+    for (auto j : loop::end(height))
+    {
+        for (auto i : loop::end(width))
+        {
+            const auto center = x[{i, j}];
+            auto laplacian    = 0.0;
+            if (i > 0) { laplacian += x[{i - 1, j}] - center; }
+            if (i + 1 < width) { laplacian += x[{i + 1, j}] - center; }
+            if (j > 0) { laplacian += x[{i, j - 1}] - center; }
+            if (j + 1 < height) { laplacian += x[{i, j + 1}] - center; }
+
+            const auto residual = b[{i, j}] - (diagonal * center - laplacian);
+            sum += residual * residual;
+        }
+    }
+    return std::sqrt(sum);
+}
+
+auto make_rhs(Dimensions dims)
+{
+    auto rhs = ScalarField{dims};
+    for (auto j : loop::end(dims.y))
+    {
+        for (auto i : loop::end(dims.x))
+        {
+            const auto x     = static_cast<f64>(i);
+            const auto y     = static_cast<f64>(j);
+            const auto spike = (i * 7 + j * 13) % 5 == 0 ? 1.0 : 0.0;
+            rhs[{i, j}]      = std::sin(0.3 * x) * std::cos(0.2 * y) + spike;
+        }
+    }
+
+    // with closed boundaries the Poisson equation only has a solution if the rhs sums to 0
+    auto mean = 0.0;
+    for (auto value : rhs) { mean += value; }
+    mean /= static_cast<f64>(rhs.size());
+    for (auto& value : rhs) { value -= mean; }
+    return rhs;
+}
+} // namespace
+
+TEST_CASE("Multigrid")
+{
+    // odd sizes, so that coarse levels round up
+    const auto dims = Dimensions{101, 70};
+    const auto rhs  = make_rhs(dims);
+
+    for (auto diagonal : {0.0, 0.5})
+    {
+        auto solver   = Multigrid<f64>{dims, {.cycles = 1}};
+        auto solution = ScalarField{dims};
+        auto previous = residual_norm(solution, rhs, diagonal);
+
+        for ([[maybe_unused]] auto cycle : loop::end(u64{6}))
+        {
+            solver.solve(solution, rhs, diagonal);
+            const auto current = residual_norm(solution, rhs, diagonal);
+            REQUIRE(current < 0.5 * previous);
+            previous = current;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <vector> // for vector
+
+#include "samarium/graphics/Trail.hpp"
+#include "samarium/math/loop.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+// the points pushed from first up to (not including) last, oldest first
+auto pushed_points(u64 first, u64 last)
+{
+    auto points = std::vector<Vector2>{};
+    for (auto i : loop::start_end(first, last)) { points.push_back({static_cast<f64>(i), 0.0}); }
+    return points;
+}
+
+auto trail_points(const Trail& trail) { return std::vector<Vector2>(trail.begin(), trail.end()); }
+} // namespace
+
+TEST_CASE("Trail")
+{
+    SECTION("keeps the last max_length points, oldest first")
+    {
+        auto trail = Trail{5};
+        REQUIRE(trail.empty());
+        REQUIRE(trail.span().empty());
+
+        for (auto i : loop::end(u64{23}))
+        {
+            trail.push_back({static_cast<f64>(i), 0.0});
+
+            const auto pushed = i + 1;
+            const auto first  = pushed < 5 ? 0 : pushed - 5;
+            REQUIRE(trail.push_count() == pushed);
+            REQUIRE(trail.size() == pushed - first);
+            REQUIRE(trail_points(trail) == pushed_points(first, pushed));
+
+            // stored once until full, then mirrored
+            REQUIRE(trail.points.size() == (pushed <= 5 ? pushed : 10));
+
+            // indexing agrees with iterating, across the wrap of the ring
+            for (auto j : loop::end(trail.size()))
+            {
+                REQUIRE(trail[j] == Vector2{static_cast<f64>(first + j), 0.0});
+            }
+        }
+        REQUIRE(!trail.empty());
+    }
+
+    SECTION("exactly full")
+    {
+        auto trail = Trail{4};
+        for (auto i : loop::end(u64{8})) { trail.push_back({static_cast<f64>(i), 0.0}); }
+        REQUIRE(trail.push_count() == 8);
+        REQUIRE(trail_points(trail) == pushed_points(4, 8));
+    }
+
+    SECTION("max_length of 1 and 0")
+    {
+        auto single = Trail{1};
+        single.push_back({1.0, 2.0});
+        single.push_back({3.0, 4.0});
+        REQUIRE(trail_points(single) == std::vector<Vector2>{{3.0, 4.0}});
+        REQUIRE(single.push_count() == 2);
+
+        auto none = Trail{0};
+        none.push_back({1.0, 2.0});
+        REQUIRE(none.empty());
+        REQUIRE(none.span().empty());
+        REQUIRE(none.push_count() == 0);
+    }
+}
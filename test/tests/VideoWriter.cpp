@@ -0,0 +1,136 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <filesystem> // for temp_directory_path, remove
+#include <fstream>    // for ifstream
+#include <iterator>   // for istreambuf_iterator
+#include <string>     // for string
+#include <utility>    // for pair
+
+#include "samarium/util/VideoWriter.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+auto read(const file::Path& path)
+{
+    auto stream = std::ifstream{path, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{stream}, {}};
+}
+
+auto byte(const std::string& bytes, u64 index) { return static_cast<u8>(bytes[index]); }
+
+// a different gradient in each channel, changing with the frame
+auto gradient(Dimensions dims, u64 frame)
+{
+    return Image::generate(dims,
+                           [frame](Indices pos)
+                           {
+                               return Color{static_cast<u8>(pos.x * 12 + frame),
+                                            static_cast<u8>(pos.y * 50),
+                                            static_cast<u8>(255 - pos.x * 7), 255};
+                           });
+}
+} // namespace
+
+TEST_CASE("VideoWriter")
+{
+    const auto path = std::filesystem::temp_directory_path() / "samarium_video_writer_test";
+
+    SECTION("Y4m")
+    {
+        // wider than the 16 pixel SIMD body, and odd so the last chroma column and row are halves
+        const auto dims        = Dimensions{21, 5};
+        const auto frame_count = u64{3};
+        {
+            auto video = file::VideoWriter::open(path, dims, file::VideoFormat::Y4m, 30);
+            REQUIRE(video);
+            for (auto frame : loop::end(frame_count))
+            {
+                REQUIRE(video->write(gradient(dims, frame)));
+                REQUIRE(video->frame_count() == frame + 1);
+            }
+        }
+
+        const auto header      = std::string{"YUV4MPEG2 W21 H5 F30:1 Ip A1:1 C420jpeg\n"};
+        const auto frame_bytes = std::string{"FRAME\n"}.size() + 21 * 5 + 2 * 11 * 3;
+        const auto bytes       = read(path);
+        REQUIRE(bytes.size() == header.size() + frame_count * frame_bytes);
+        REQUIRE(bytes.starts_with(header));
+
+        // the Y plane of the last frame, against BT.601 limited range luma
+        const auto last  = gradient(dims, frame_count - 1);
+        const auto plane = header.size() + (frame_count - 1) * frame_bytes + 6;
+        REQUIRE(bytes.substr(plane - 6, 6) == "FRAME\n");
+        for (auto i : loop::end(last.size()))
+        {
+            const auto [r, g, b, a] = last[i];
+            const auto luma         = (66 * u32{r} + 129 * u32{g} + 25 * u32{b} + 128) / 256 + 16;
+            REQUIRE(byte(bytes, plane + i) == luma);
+        }
+    }
+
+    SECTION("Y4m chroma of flat colors")
+    {
+        const auto dims = Dimensions{33, 3};
+        {
+            auto video = file::VideoWriter::open(path, dims);
+            REQUIRE(video);
+            REQUIRE(video->write(Image{dims, Color{255, 255, 255}}));
+            REQUIRE(video->write(Image{dims, Color{0, 0, 0}}));
+        }
+
+        const auto bytes = read(path);
+        const auto luma  = u64{33 * 3};
+        const auto frame = 6 + luma + 2 * 17 * 2;
+        const auto start = bytes.find('\n') + 1 + 6;
+        for (auto [offset, y] : {std::pair{u64{}, u8{235}}, std::pair{frame, u8{16}}})
+        {
+            for (auto i : loop::end(luma)) { REQUIRE(byte(bytes, start + offset + i) == y); }
+            for (auto i : loop::end(2 * 17 * 2))
+            {
+                REQUIRE(byte(bytes, start + offset + luma + i) == 128);
+            }
+        }
+    }
+
+    SECTION("Rgba")
+    {
+        const auto dims = Dimensions{4, 3};
+        {
+            auto video = file::VideoWriter::open(path, dims, file::VideoFormat::Rgba);
+            REQUIRE(video);
+            for (auto frame : loop::end(u64{2})) { REQUIRE(video->write(gradient(dims, frame))); }
+            REQUIRE(video->frame_count() == 2);
+        }
+
+        const auto bytes = read(path);
+        REQUIRE(bytes.size() == 2 * 4 * 3 * 4);
+        const auto second = gradient(dims, 1);
+        REQUIRE(bytes.compare(4 * 3 * 4, 4 * 3 * 4,
+                              std::string(reinterpret_cast<const char*>(second.data()),
+                                          second.byte_size())) == 0);
+    }
+
+    SECTION("errors")
+    {
+        REQUIRE(!file::VideoWriter::open(path / "missing" / "video.y4m", {4, 4}));
+
+        auto video = file::VideoWriter::open(path, {4, 4});
+        REQUIRE(video);
+        REQUIRE(!video->write(Image{{4, 5}}));
+        REQUIRE(!video->write(Image{{5, 4}}));
+        REQUIRE(video->frame_count() == 0);
+        REQUIRE(video->write(Image{{4, 4}}));
+        REQUIRE(video->frame_count() == 1);
+    }
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <algorithm> // for min, copy
+#include <utility>   // for pair
+#include <vector>    // for vector
+
+#include "samarium/graphics/blend.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+// x / 255 rounded to nearest, written independently of the library's shift trick
+auto div255(u32 x) { return (x + 127) / 255; }
+
+// the formulas of each mode, one pixel at a time
+auto reference(Color dst, Color src, BlendMode mode)
+{
+    const auto alpha   = u32{src.a};
+    const auto inverse = 255 - alpha;
+    const auto byte    = [](u32 value) { return static_cast<u8>(std::min(value, 255U)); };
+
+    const auto color = [&](u8 d_, u8 s_) -> u32
+    {
+        const auto d = u32{d_};
+        const auto s = u32{s_};
+        switch (mode)
+        {
+        case BlendMode::Over: return div255(s * alpha + d * inverse);
+        case BlendMode::Add: return d + div255(s * alpha);
+        case BlendMode::Multiply: return div255(div255(s * d) * alpha + d * inverse);
+        case BlendMode::Screen: return div255((s + d - div255(s * d)) * alpha + d * inverse);
+        case BlendMode::PremultipliedOver: return s + div255(d * inverse);
+        case BlendMode::PremultipliedAdd: return s + d;
+        }
+        return 0;
+    };
+
+    const auto premultiplied =
+        mode == BlendMode::PremultipliedOver || mode == BlendMode::PremultipliedAdd;
+    return Color{byte(color(dst.r, src.r)), byte(color(dst.g, src.g)), byte(color(dst.b, src.b)),
+                 premultiplied ? byte(color(dst.a, src.a))
+                               : byte(alpha + div255(u32{dst.a} * inverse))};
+}
+
+// 8k + 5 pixels, so both the 8 and 4 wide kernels leave a scalar tail. Source alphas cycle
+// through 0, 255 and values in between, so each lands in the vector body and in the tail
+auto layers(u64 size)
+{
+    const auto alphas = std::vector<u8>{0, 255, 1, 128, 254, 37, 0, 200, 255, 99, 64};
+    auto destination  = std::vector<Color>(size);
+    auto source       = std::vector<Color>(size);
+    for (auto i : loop::end(size))
+    {
+        const auto channel = [i](u64 seed) { return static_cast<u8>((i + 7) * seed % 256); };
+        destination[i]     = Color{channel(13), channel(71), channel(151), channel(29)};
+        source[i] = Color{channel(97), channel(43), channel(199), alphas[i % alphas.size()]};
+    }
+    return std::pair{destination, source};
+}
+
+constexpr auto modes = {BlendMode::Over,   BlendMode::Add,
+                        BlendMode::Multiply,          BlendMode::Screen,
+                        BlendMode::PremultipliedOver, BlendMode::PremultipliedAdd};
+} // namespace
+
+TEST_CASE("blend")
+{
+    SECTION("matches the scalar formulas")
+    {
+        const auto [destination, source] = layers(8 * 16 + 5);
+        for (auto mode : modes)
+        {
+            auto blended = destination;
+            blend(blended, source, mode);
+            for (auto i : loop::end(blended.size()))
+            {
+                INFO("mode " << static_cast<int>(mode) << ", pixel " << i);
+                REQUIRE(blended[i] == reference(destination[i], source[i], mode));
+            }
+        }
+    }
+
+    SECTION("alpha 0 and 255")
+    {
+        const auto [destination, source] = layers(8 * 2 + 5);
+        auto blended                     = destination;
+        blend(blended, source, BlendMode::Over);
+        for (auto i : loop::end(blended.size()))
+        {
+            if (source[i].a == 0) { REQUIRE(blended[i] == destination[i]); }
+            if (source[i].a == 255) { REQUIRE(blended[i] == source[i]); }
+        }
+    }
+
+    SECTION("Images")
+    {
+        const auto dims                  = Dimensions{13, 7};
+        const auto [destination, source] = layers(dims.x * dims.y);
+        auto thread_pool                 = ThreadPool{3};
+        for (auto mode : modes)
+        {
+            auto blended = Image{dims};
+            std::copy(destination.begin(), destination.end(), blended.begin());
+            blend(blended, Image{std::span{source}, dims}, mode, &thread_pool);
+            for (auto i : loop::end(blended.size()))
+            {
+                REQUIRE(blended[i] == reference(destination[i], source[i], mode));
+            }
+        }
+
+        auto wrong = Image{{12, 7}};
+        REQUIRE_THROWS(blend(wrong, Image{std::span{source}, dims}));
+    }
+
+    SECTION("short source")
+    {
+        auto destination  = std::vector<Color>(9);
+        const auto source = std::vector<Color>(8);
+        REQUIRE_THROWS(blend(destination, source, BlendMode::Over));
+    }
+}
@@ -0,0 +1,464 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <algorithm> // for equal
+#include <array>     // for array, to_array
+#include <cstdlib>   // for abs
+#include <span>      // for span
+#include <string>    // for string
+#include <tuple>     // for ignore
+#include <vector>    // for vector
+
+#include "samarium/util/Error.hpp"
+#include "samarium/util/RandomGenerator.hpp"
+#include "samarium/util/ThreadPool.hpp"
+#include "samarium/util/file.hpp"
+#include "samarium/util/fpng/fpng.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+auto same_pixels(const Image& a, const Image& b)
+{
+    return a.dims == b.dims && std::equal(a.begin(), a.end(), b.begin());
+}
+
+auto qoi_round_trip(const Image& image)
+{
+    auto bytes = std::vector<u8>{};
+    file::encode(file::qoi, image, bytes);
+    const auto decoded = file::decode(file::qoi, bytes);
+    return decoded && same_pixels(*decoded, image);
+}
+
+auto get_be(std::span<const u8> bytes, u64 offset)
+{
+    auto value = u32{};
+    for (auto i : loop::end(u64{4})) { value = value << 8 | bytes[offset + i]; }
+    return value;
+}
+
+// a minimal inflate (RFC 1951), independent of the encoder, decoding codes a bit at a time
+class Inflater
+{
+  public:
+    explicit Inflater(std::span<const u8> input) : input{input} {}
+
+    auto inflate() -> std::vector<u8>
+    {
+        auto is_last = false;
+        while (!is_last)
+        {
+            is_last         = bits(1) == 1;
+            const auto type = bits(2);
+            if (type == 0) { stored(); }
+            else if (type == 1) { fixed(); }
+            else if (type == 2) { dynamic(); }
+            else { throw Error{"invalid deflate block type"}; }
+        }
+        return std::move(output);
+    }
+
+    [[nodiscard]] auto consumed() const { return position; }
+
+  private:
+    struct Huffman
+    {
+        std::array<u16, 16> counts{};
+        std::vector<u16> symbols{};
+
+        explicit Huffman(std::span<const u8> lengths) : symbols(lengths.size())
+        {
+            for (auto length : lengths) { counts[length]++; }
+            counts[0]    = 0;
+            auto offsets = std::array<u16, 16>{};
+            for (auto length : loop::start_end(u64{1}, u64{15}))
+            {
+                offsets[length + 1] = static_cast<u16>(offsets[length] + counts[length]);
+            }
+            for (auto symbol : loop::end(lengths.size()))
+            {
+                if (lengths[symbol] == 0) { continue; }
+                symbols[offsets[lengths[symbol]]++] = static_cast<u16>(symbol);
+            }
+        }
+    };
+
+    std::span<const u8> input;
+    u64 position{};
+    u32 bit_buffer{};
+    u32 bit_count{};
+    std::vector<u8> output{};
+
+    auto bits(u32 count) -> u32
+    {
+        while (bit_count < count)
+        {
+            if (position == input.size()) { throw Error{"deflate stream is truncated"}; }
+            bit_buffer |= u32{input[position++]} << bit_count;
+            bit_count += 8;
+        }
+        const auto value = bit_buffer & ((u32{1} << count) - 1);
+        bit_buffer >>= count;
+        bit_count -= count;
+        return value;
+    }
+
+    auto decode(const Huffman& huffman) -> u16
+    {
+        auto code  = 0;
+        auto first = 0;
+        auto index = 0;
+        for (auto length : loop::start_end(u64{1}, u64{16}))
+        {
+            code |= static_cast<i32>(bits(1));
+            const auto count = huffman.counts[length];
+            if (code - count < first)
+            {
+                return huffman.symbols[static_cast<u64>(index + code - first)];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw Error{"invalid Huffman code"};
+    }
+
+    void stored()
+    {
+        bit_buffer = 0;
+        bit_count  = 0;
+        if (position + 4 > input.size()) { throw Error{"deflate stream is truncated"}; }
+        const auto size       = u64{input[position]} | u64{input[position + 1]} << 8;
+        const auto complement = u64{input[position + 2]} | u64{input[position + 3]} << 8;
+        if ((size ^ 0xFFFF) != complement) { throw Error{"invalid stored block length"}; }
+        position += 4;
+        if (position + size > input.size()) { throw Error{"deflate stream is truncated"}; }
+        output.insert(output.end(), input.begin() + position, input.begin() + position + size);
+        position += size;
+    }
+
+    void fixed()
+    {
+        auto lengths = std::array<u8, 288 + 30>{};
+        std::fill_n(lengths.begin(), 144, 8);
+        std::fill_n(lengths.begin() + 144, 112, 9);
+        std::fill_n(lengths.begin() + 256, 24, 7);
+        std::fill_n(lengths.begin() + 280, 8, 8);
+        std::fill_n(lengths.begin() + 288, 30, 5);
+        codes(Huffman{std::span{lengths}.first(288)}, Huffman{std::span{lengths}.subspan(288)});
+    }
+
+    void dynamic()
+    {
+        static constexpr auto order =
+            std::to_array<u8>({16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15});
+
+        const auto literal_count  = bits(5) + 257;
+        const auto distance_count = bits(5) + 1;
+        const auto length_count   = bits(4) + 4;
+
+        auto length_lengths = std::array<u8, 19>{};
+        for (auto i : loop::end(length_count))
+        {
+            length_lengths[order[i]] = static_cast<u8>(bits(3));
+        }
+        const auto length_code = Huffman{length_lengths};
+
+        auto lengths = std::vector<u8>{};
+        while (lengths.size() < literal_count + distance_count)
+        {
+            const auto symbol = decode(length_code);
+            if (symbol < 16) { lengths.push_back(static_cast<u8>(symbol)); }
+            else
+            {
+                if (symbol == 16 && lengths.empty()) { throw Error{"repeat with no length"}; }
+                const auto value  = symbol == 16 ? lengths.back() : u8{};
+                const auto repeat = symbol == 16   ? 3 + bits(2)
+                                    : symbol == 17 ? 3 + bits(3)
+                                                   : 11 + bits(7);
+                lengths.insert(lengths.end(), repeat, value);
+            }
+        }
+        if (lengths.size() != literal_count + distance_count)
+        {
+            throw Error{"code lengths overrun"};
+        }
+
+        codes(Huffman{std::span{lengths}.first(literal_count)},
+              Huffman{std::span{lengths}.subspan(literal_count)});
+    }
+
+    void codes(const Huffman& literals, const Huffman& distances)
+    {
+        static constexpr auto length_base = std::to_array<u16>(
+            {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23,  27,
+             31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258});
+        static constexpr auto length_extra =
+            std::to_array<u8>({0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0});
+        static constexpr auto distance_base =
+            std::to_array<u16>({1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577});
+        static constexpr auto distance_extra =
+            std::to_array<u8>({0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13});
+
+        while (true)
+        {
+            const auto symbol = decode(literals);
+            if (symbol < 256) { output.push_back(static_cast<u8>(symbol)); }
+            else if (symbol == 256) { return; }
+            else
+            {
+                const auto length_symbol = symbol - 257U;
+                if (length_symbol >= length_base.size()) { throw Error{"invalid length symbol"}; }
+                const auto length = length_base[length_symbol] + bits(length_extra[length_symbol]);
+
+                const auto distance_symbol = decode(distances);
+                if (distance_symbol >= distance_base.size())
+                {
+                    throw Error{"invalid distance symbol"};
+                }
+                const auto distance =
+                    distance_base[distance_symbol] + bits(distance_extra[distance_symbol]);
+                if (distance > output.size()) { throw Error{"distance is too far back"}; }
+
+                for (auto i : loop::end(u64{length}))
+                {
+                    std::ignore = i;
+                    output.push_back(output[output.size() - distance]);
+                }
+            }
+        }
+    }
+};
+
+// the filtered scanlines of a PNG, checking its chunks and the zlib stream around them
+auto png_scanlines(std::span<const u8> png, Dimensions dims)
+{
+    static constexpr auto signature =
+        std::to_array<u8>({0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'});
+    REQUIRE(std::equal(signature.begin(), signature.end(), png.begin()));
+
+    auto zlib      = std::vector<u8>{};
+    auto offset    = signature.size();
+    auto chunk_ids = std::vector<std::string>{};
+    while (offset < png.size())
+    {
+        REQUIRE(offset + 12 <= png.size());
+        const auto size = get_be(png, offset);
+        REQUIRE(offset + 12 + size <= png.size());
+
+        const auto chunk = png.subspan(offset + 4, 4 + size);
+        REQUIRE(get_be(png, offset + 8 + size) == fpng::fpng_crc32(chunk.data(), chunk.size()));
+
+        const auto id   = std::string(chunk.begin(), chunk.begin() + 4);
+        const auto data = chunk.subspan(4);
+        if (id == "IHDR")
+        {
+            REQUIRE(get_be(data, 0) == dims.x);
+            REQUIRE(get_be(data, 4) == dims.y);
+            REQUIRE(data[8] == 8); // bit depth
+            REQUIRE(data[9] == 6); // RGBA
+        }
+        if (id == "IDAT") { zlib.insert(zlib.end(), data.begin(), data.end()); }
+        chunk_ids.push_back(id);
+        offset += 12 + size;
+    }
+    REQUIRE(chunk_ids.front() == "IHDR");
+    REQUIRE(chunk_ids.back() == "IEND");
+
+    REQUIRE(zlib.size() >= 6);
+    REQUIRE((zlib[0] & 15) == 8); // deflate
+    REQUIRE((zlib[0] << 8 | zlib[1]) % 31 == 0);
+
+    auto inflater      = Inflater{std::span{zlib}.subspan(2)};
+    auto scanlines     = inflater.inflate();
+    const auto trailer = 2 + inflater.consumed();
+    REQUIRE(trailer + 4 == zlib.size());
+    REQUIRE(get_be(zlib, trailer) == fpng::fpng_adler32(scanlines.data(), scanlines.size()));
+    return scanlines;
+}
+
+// undo each row's filter byte, for any of the five PNG filters
+auto unfilter(std::span<const u8> scanlines, Dimensions dims)
+{
+    const auto row_size = 4 * dims.x;
+    REQUIRE(scanlines.size() == (1 + row_size) * dims.y);
+
+    auto pixels = std::vector<u8>(row_size * dims.y);
+    for (auto y : loop::end(dims.y))
+    {
+        const auto filter = scanlines[y * (1 + row_size)];
+        const auto* in    = scanlines.data() + y * (1 + row_size) + 1;
+        auto* row         = pixels.data() + y * row_size;
+        REQUIRE(filter <= 4);
+
+        for (auto i : loop::end(row_size))
+        {
+            const auto left       = i >= 4 ? i32{row[i - 4]} : 0;
+            const auto above      = y > 0 ? i32{row[i - row_size]} : 0;
+            const auto above_left = i >= 4 && y > 0 ? i32{row[i - row_size - 4]} : 0;
+
+            auto prediction = 0;
+            if (filter == 1) { prediction = left; }
+            else if (filter == 2) { prediction = above; }
+            else if (filter == 3) { prediction = (left + above) / 2; }
+            else if (filter == 4)
+            {
+                const auto estimate = left + above - above_left;
+                const auto to_left  = std::abs(estimate - left);
+                const auto to_above = std::abs(estimate - above);
+                const auto to_both  = std::abs(estimate - above_left);
+                prediction          = to_left <= to_above && to_left <= to_both ? left
+                                      : to_above <= to_both                     ? above
+                                                                                : above_left;
+            }
+            row[i] = static_cast<u8>(in[i] + prediction);
+        }
+    }
+    return pixels;
+}
+} // namespace
+
+TEST_CASE("file::encode(qoi)")
+{
+    SECTION("matches the reference encoder")
+    {
+        // one of each op, worked out by hand from the specification: DIFF, DIFF, INDEX of a seen
+        // color, INDEX 0 of the zero initialised index, RUN, RGB, LUMA and RGBA
+        const auto pixels = std::to_array<Color>({{255, 0, 0, 255},
+                                                  {0, 0, 0, 255},
+                                                  {255, 0, 0, 255},
+                                                  {0, 0, 0, 0},
+                                                  {0, 0, 0, 0},
+                                                  {0, 0, 0, 0},
+                                                  {10, 20, 30, 0},
+                                                  {25, 40, 52, 0},
+                                                  {25, 40, 52, 128}});
+        const auto expected = std::vector<u8>{
+            'q',  'o',  'i',  'f',  0,    0,    0,    3, 0, 0, 0, 3, 4, 0, // header
+            0x5A, 0x7A, 0x32, 0x00, 0xC1, 0xFE, 0x0A, 0x14, 0x1E, 0xB4, 0x3A, 0xFF, 0x19, 0x28,
+            0x34, 0x80, 0,    0,    0,    0,    0,    0,    0,    1};
+        const auto image = Image{pixels, {3, 3}};
+
+        auto bytes = std::vector<u8>{};
+        file::encode(file::qoi, image, bytes);
+        REQUIRE(bytes == expected);
+
+        const auto decoded = file::decode(file::qoi, expected);
+        REQUIRE(decoded);
+        REQUIRE(same_pixels(*decoded, image));
+    }
+
+    SECTION("decodes an index that was only filled by a run")
+    {
+        // a run of the initial opaque black, then a red DIFF, then INDEX 53 of opaque black
+        const auto bytes = std::vector<u8>{'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 1, 4, 0,
+                                           0xC0, 0x5A, 0x35, 0, 0, 0, 0, 0, 0, 0, 1};
+        const auto decoded = file::decode(file::qoi, bytes);
+        REQUIRE(decoded);
+        REQUIRE((*decoded)[0] == Color{0, 0, 0, 255});
+        REQUIRE((*decoded)[1] == Color{255, 0, 0, 255});
+        REQUIRE((*decoded)[2] == Color{0, 0, 0, 255});
+    }
+
+    SECTION("round trips")
+    {
+        auto rng = RandomGenerator{};
+
+        // noise, runs, small differences and opaque black, which starts out of the index
+        const auto image = Image::generate(
+            {301, 97},
+            [&](Indices pos) -> Color
+            {
+                if (pos.y % 7 == 0)
+                {
+                    return Color{0, 0, 0, static_cast<u8>(pos.x < 150 ? 255 : 0)};
+                }
+                if (pos.y % 5 == 0) { return Color{static_cast<u8>(pos.x / 64), 40, 200}; }
+                if (pos.y % 3 == 0)
+                {
+                    return Color{static_cast<u8>(pos.x), static_cast<u8>(pos.x + pos.y / 2),
+                                 static_cast<u8>(pos.x * 3)};
+                }
+                const auto value = [&] { return static_cast<u8>(rng.range<u64>({0, 255})); };
+                return Color{value(), value(), value(), value()};
+            });
+        REQUIRE(qoi_round_trip(image));
+        REQUIRE(qoi_round_trip(Image{{1, 1}, Color{0, 0, 0, 0}}));
+        REQUIRE(qoi_round_trip(Image{{100, 10}, Color{0, 0, 0, 255}}));
+    }
+
+    SECTION("round trips when the output ends near the end of the buffer")
+    {
+        // QOI_OP_RGBA for every pixel, so some width leaves the last pixel just short of the
+        // buffer's flush point, and the end marker past it
+        for (auto width : loop::start_end(u64{13'080}, u64{13'120}))
+        {
+            const auto image = Image::generate(
+                {width, 1},
+                [](Indices pos)
+                {
+                    return Color{static_cast<u8>(pos.x), static_cast<u8>(pos.x >> 8),
+                                 static_cast<u8>(pos.x * 7), static_cast<u8>(254 + pos.x % 2)};
+                });
+            REQUIRE(qoi_round_trip(image));
+        }
+    }
+}
+
+TEST_CASE("file::encode(png)")
+{
+    auto thread_pool = ThreadPool{4};
+
+    SECTION("round trips")
+    {
+        auto rng = RandomGenerator{};
+
+        // noisy enough to need dynamic Huffman blocks, and tall enough to be split into many strips
+        const auto noisy = Image::generate(
+            {523, 611},
+            [&](Indices pos)
+            {
+                if (pos.y % 9 == 0) { return Color{12, 34, 56, 78}; }
+                return Color{static_cast<u8>(pos.x ^ pos.y), static_cast<u8>(pos.x * pos.y),
+                             static_cast<u8>(rng.range<u64>({0, 255})), static_cast<u8>(pos.y)};
+            });
+
+        for (const auto& image :
+             {noisy, Image{{1, 1}, Color{1, 2, 3, 4}}, Image{{3, 70'000}, Color{9, 9, 9}}})
+        {
+            auto bytes = std::vector<u8>{};
+            file::encode(file::png, image, bytes, thread_pool);
+
+            const auto scanlines = png_scanlines(bytes, image.dims);
+            const auto pixels    = unfilter(scanlines, image.dims);
+            REQUIRE(std::equal(pixels.begin(), pixels.end(),
+                               reinterpret_cast<const u8*>(image.data())));
+        }
+    }
+
+    SECTION("empty images")
+    {
+        // still one complete zlib stream, of just a filter byte per row
+        for (const auto dims : {Dimensions{0, 0}, Dimensions{5, 0}, Dimensions{0, 7}})
+        {
+            auto bytes = std::vector<u8>{};
+            file::encode(file::png, Image{dims}, bytes, thread_pool);
+
+            const auto scanlines = png_scanlines(bytes, dims);
+            REQUIRE(scanlines.size() == dims.y);
+            REQUIRE(unfilter(scanlines, dims).empty());
+        }
+    }
+}
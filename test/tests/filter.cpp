@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2022 Jai Bellare
+ * See <https://opensource.org/licenses/MIT/> or LICENSE.md
+ * Project homepage: https://github.com/strangeQuark1041/samarium
+ */
+
+#include <algorithm> // for all_of
+#include <array>     // for to_array
+
+#include "samarium/graphics/filter.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+using namespace sm;
+
+namespace
+{
+auto is_filled_with(const Image& image, Color color)
+{
+    return std::all_of(image.begin(), image.end(), [color](Color pixel) { return pixel == color; });
+}
+} // namespace
+
+TEST_CASE("filter::box_blur")
+{
+    // a constant image stays constant at any radius, including radii where the rounded
+    // reciprocal of the window size overshoots (177 is the first)
+    for (auto color : {Color{255, 255, 255, 255}, Color{0, 0, 0, 0}, Color{254, 1, 128, 255}})
+    {
+        for (auto radius : std::to_array<u64>({1, 2, 5, 177, 195, 1000, 2999}))
+        {
+            auto image = Image{{37, 23}, color};
+            filter::box_blur(image, radius);
+            REQUIRE(is_filled_with(image, color));
+        }
+    }
+}
+
+TEST_CASE("filter::gaussian_blur")
+{
+    for (auto sigma : {0.5, 3.0, 180.0, 400.0})
+    {
+        auto image = Image{{64, 48}, Color{255, 255, 255, 255}};
+        filter::gaussian_blur(image, sigma);
+        REQUIRE(is_filled_with(image, Color{255, 255, 255, 255}));
+    }
+
+    // blurring spreads a point out, keeping its peak in place
+    auto image      = Image{{33, 33}, Color{0, 0, 0, 255}};
+    image[{16, 16}] = Color{255, 255, 255, 255};
+    filter::gaussian_blur(image, 2.0);
+    REQUIRE(image[{16, 16}].r > image[{18, 16}].r);
+    REQUIRE(image[{18, 16}].r == image[{16, 18}].r);
+    REQUIRE(image[{18, 16}].r > 0);
+}